@@ -0,0 +1,412 @@
+#include "adaptive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdint.h>
+
+#include "grid.h"
+#include "offset.h"
+#include "simplify.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// cells of the material grid across the tool's radius
+#define CELLS_PER_RADIUS (8)
+// most cells the grid may have along either side; larger regions get coarser
+// cells
+#define MAX_GRID_CELLS (4096)
+// points around the tool's edge that engagement is counted at
+#define ENGAGEMENT_SAMPLES (64)
+// headings tried across the half circle ahead of the tool
+#define HEADINGS (16)
+// bisection steps refining the heading between two of those
+#define REFINE_STEPS (6)
+// steps in a row that may cut nothing before the tool moves on
+#define IDLE_STEPS (8)
+
+typedef std::chrono::steady_clock adaptive_clock;
+
+// the bits of word w that fall within the cells [i0, i1)
+uint64_t run_mask(const uint32_t w, const uint32_t i0, const uint32_t i1) {
+    uint32_t lo = max(i0, w * 64) - w * 64, hi = min(i1, w * 64 + 64) - w * 64;
+    uint64_t below_hi = hi == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << hi) - 1;
+    return below_hi & ~(((uint64_t) 1 << lo) - 1);
+}
+
+// a region being cleared: the grid over it, the cells the tool center may be
+// at, and the material still to be cut
+class clearing : public cellgrid {
+    public:
+        clearing(const cellgrid &g)
+            : cellgrid(g), inside(nx, ny), allowed(nx, ny), material(nx, ny) {}
+
+        float r;
+        bitgrid inside, allowed, material;
+        // for every cell, the nearest cell the tool center may be at
+        vector<uint32_t> nearest_allowed;
+        // offsets from the tool center to the points engagement is counted
+        // at, in cells
+        vector<float> sample_x, sample_y;
+};
+
+// the material cells closer than r to the segment from a to b, row by row
+// along the capsule it sweeps. clears them if clear is set, otherwise stops
+// at the first one. returns how many there were.
+size_t sweep_material(
+        clearing &c, const Vector2f &a, const Vector2f &b, const bool clear) {
+    bitgrid &m = c.material;
+    float lo_y = min(a[1], b[1]) - c.r, hi_y = max(a[1], b[1]) + c.r;
+    float first_row = ceil((lo_y - c.y0) / c.cell),
+          end_row = floor((hi_y - c.y0) / c.cell) + 1;
+    first_row = max(0.f, first_row);
+    end_row = min((float) m.ny, end_row);
+    size_t count = 0;
+    for (float fj = first_row; fj < end_row; fj++) {
+        uint32_t j = (uint32_t) fj;
+        span sp;
+        if (!capsule_span(a, b, c.y0 + j * c.cell, c.r, sp)) {
+            continue;
+        }
+        float first = ceil((sp.lo - c.x0) / c.cell),
+              end = floor((sp.hi - c.x0) / c.cell) + 1;
+        first = max(0.f, first);
+        end = min((float) m.nx, end);
+        if (first >= end) {
+            continue;
+        }
+        uint32_t i0 = (uint32_t) first, i1 = (uint32_t) end;
+        uint64_t *row = &m.words[(size_t) j * m.stride];
+        for (uint32_t w = i0 / 64; w <= (i1 - 1) / 64; w++) {
+            uint64_t hit = row[w] & run_mask(w, i0, i1);
+            if (hit == 0) {
+                continue;
+            }
+            count += __builtin_popcountll(hit);
+            if (!clear) {
+                return count;
+            }
+            row[w] &= ~hit;
+        }
+    }
+    return count;
+}
+
+// the angle of the tool's edge in contact with material, with its center at
+// p and moving in direction d, counted at the sample points on its leading
+// half. the center is always somewhere the tool may be, so every sample
+// lands on the grid, and the loop over them has no branches.
+float engagement(const clearing &c, const Vector2f &p, const Vector2f &d) {
+    const bitgrid &m = c.material;
+    float fx = (p[0] - c.x0) / c.cell + .5f, fy = (p[1] - c.y0) / c.cell + .5f;
+    const float *sx = c.sample_x.data(), *sy = c.sample_y.data();
+    int hits = 0;
+    for (int k = 0; k < ENGAGEMENT_SAMPLES; k++) {
+        uint32_t i = (uint32_t) (fx + sx[k]), j = (uint32_t) (fy + sy[k]);
+        uint64_t word = m.words[(size_t) j * m.stride + i / 64];
+        int ahead = sx[k] * d[0] + sy[k] * d[1] >= 0;
+        hits += ahead & (int) (word >> (i % 64));
+    }
+    return hits * (float) (2 * M_PI / ENGAGEMENT_SAMPLES);
+}
+
+bool allowed_at(const clearing &c, const Vector2f &p) {
+    uint32_t i, j;
+    return c.cell_at(p, i, j) && c.allowed.get(i, j);
+}
+
+// finds the heading for the next step of length step from p. headings from
+// straight left of the current one to straight right are tried in turn, and
+// the first one where engagement rises to the target is refined by bisection
+// with the one before it, if refine is set. failing that, the heading with
+// the engagement closest to the target is taken. returns false if no heading
+// engages any material.
+bool pick_heading(
+        const clearing &c, const Vector2f &p, const float heading,
+        const float step, const float target, const bool refine,
+        float &out) {
+    auto try_heading = [&](const float a) {
+        Vector2f d(cos(a), sin(a));
+        Vector2f to = p + step * d;
+        return allowed_at(c, to) ? engagement(c, to, d) : -1.f;
+    };
+
+    float least = (float) (2 * M_PI / ENGAGEMENT_SAMPLES);
+    float best_error = INFINITY, prev_a = 0, prev_e = -1;
+    for (int k = 0; k <= HEADINGS; k++) {
+        float a = heading + M_PI / 2 - k * M_PI / HEADINGS;
+        float e = try_heading(a);
+        if (e >= target && prev_e >= 0 && prev_e < target) {
+            float lo = prev_a, hi = a;
+            for (int s = 0; refine && s < REFINE_STEPS; s++) {
+                float mid = (lo + hi) / 2, em = try_heading(mid);
+                if (em >= 0 && em < target) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (try_heading(hi) >= 0) {
+                out = hi;
+                return true;
+            }
+        }
+        if (e >= least && fabs(e - target) < best_error) {
+            best_error = fabs(e - target);
+            out = a;
+        }
+        prev_a = a;
+        prev_e = e;
+    }
+    return best_error < INFINITY;
+}
+
+// the material cell closest to p, skipping empty words of the grid whole
+bool nearest_material(const clearing &c, const Vector2f &p, uint32_t &out) {
+    const bitgrid &m = c.material;
+    float best = INFINITY;
+    for (uint32_t j = 0; j < m.ny; j++) {
+        float dy = c.y0 + j * c.cell - p[1];
+        if (dy * dy >= best) {
+            continue;
+        }
+        const uint64_t *row = &m.words[(size_t) j * m.stride];
+        for (uint32_t w = 0; w < m.stride; w++) {
+            for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+                uint32_t i = w * 64 + __builtin_ctzll(bits);
+                float d = (c.center(i, j) - p).squaredNorm();
+                if (d < best) {
+                    best = d;
+                    out = j * m.nx + i;
+                }
+            }
+        }
+    }
+    return best < INFINITY;
+}
+
+// true if the tool can move straight from a to b without its engagement
+// going over limit or its center leaving the cells it may be at, checked
+// every cell along the way
+bool link_clear(
+        const clearing &c, const Vector2f &a, const Vector2f &b,
+        const float limit) {
+    Vector2f d = b - a;
+    float len = d.norm();
+    if (len == 0) {
+        return true;
+    }
+    d /= len;
+    int samples = (int) ceil(len / c.cell);
+    for (int s = 1; s <= samples; s++) {
+        Vector2f p = a + (b - a) * ((float) s / samples);
+        if (!allowed_at(c, p) || engagement(c, p, d) > limit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// cuts a spiral out from p, stepover apart, to radius room, and a full circle
+// at that radius. leaves p at the end of it and heading along it.
+void spiral_entry(
+        clearing &c, const float room, const float stepover, const float step,
+        Vector2f &p, float &heading, vector<Vector2f> &pass) {
+    Vector2f center = p;
+    float theta = 0, rho = 0;
+    while (rho < room) {
+        theta += min(.5f, step / max(rho, step));
+        rho = min(room, (float) (stepover * theta / (2 * M_PI)));
+        Vector2f to = center + rho * Vector2f(cos(theta), sin(theta));
+        sweep_material(c, p, to, true);
+        pass.push_back(to);
+        p = to;
+    }
+    float dtheta = min(.5f, step / room), end = theta + 2 * M_PI;
+    while (theta < end) {
+        theta = min(end, theta + dtheta);
+        Vector2f to = center + room * Vector2f(cos(theta), sin(theta));
+        sweep_material(c, p, to, true);
+        pass.push_back(to);
+        p = to;
+    }
+    heading = theta + M_PI / 2;
+}
+
+void adaptive_region(
+        const region &reg, const float z, const float r, const float stepover,
+        const float tolerance, const float time_budget,
+        vector<vector<Vector3f>> &passes) {
+    if (stepover <= 0 || r <= 0 || reg.outer.empty()) {
+        return;
+    }
+    adaptive_clock::time_point started = adaptive_clock::now();
+
+    clearing c(cellgrid(reg, r / CELLS_PER_RADIUS, MAX_GRID_CELLS));
+    c.r = r;
+    float cell = c.cell;
+    uint32_t nx = c.nx, ny = c.ny;
+    rasterize_region(reg, c, c.inside);
+
+    // positions are rounded to cells up to half a diagonal away, and
+    // simplifying the passes afterwards can move them by another tolerance,
+    // so the tool center stays inside the region shrunk by a little more
+    // than that. the strip this leaves along the walls is taken off at the
+    // end by a pass around the region shrunk by exactly r.
+    vector<region> shrunk;
+    offset_region(reg, r + cell + tolerance, tolerance, shrunk);
+    for (auto sr = shrunk.begin(); sr != shrunk.end(); sr++) {
+        rasterize_region(*sr, c, c.allowed);
+    }
+    bitgrid forbidden(nx, ny);
+    for (uint32_t j = 0; j < ny; j++) {
+        for (uint32_t i = 0; i < nx; i++) {
+            if (!c.allowed.get(i, j)) {
+                forbidden.set(i, j);
+            }
+        }
+    }
+    vector<float> clearance, reach;
+    vector<uint32_t> nearest_forbidden;
+    distance_transform(forbidden, clearance, nearest_forbidden);
+    uint32_t entry = NO_CELL;
+    for (size_t k = 0; k < clearance.size(); k++) {
+        if (clearance[k] > 0
+                && (entry == NO_CELL || clearance[k] > clearance[entry])) {
+            entry = k;
+        }
+    }
+
+    // material no tool center can get within r of stays where it is
+    distance_transform(c.allowed, reach, c.nearest_allowed);
+    float reach_cells = r / cell;
+    for (uint32_t j = 0; j < ny; j++) {
+        for (uint32_t i = 0; i < nx; i++) {
+            size_t k = (size_t) j * nx + i;
+            if (c.inside.get(i, j) && reach[k] <= reach_cells * reach_cells) {
+                c.material.set(i, j);
+            }
+        }
+    }
+
+    float radius = r - cell / 2;
+    for (int k = 0; k < ENGAGEMENT_SAMPLES; k++) {
+        float a = 2 * M_PI * k / ENGAGEMENT_SAMPLES;
+        c.sample_x.push_back(radius * cos(a) / cell);
+        c.sample_y.push_back(radius * sin(a) / cell);
+    }
+    // a straight cut stepover wide is in contact with the material across
+    // acos(1 - stepover / r) of its edge
+    float width = min(stepover, 2 * r);
+    float target = acos(1 - width / r);
+    float step = max(cell, min(r / 4, width));
+
+    vector<vector<Vector2f>> flat;
+    Vector2f pos = reg.outer[0];
+    float heading = 0;
+    if (entry != NO_CELL) {
+        // the entry is the cell furthest from the edge of where the tool
+        // center may be
+        pos = c.center(entry);
+        float room = min(2 * r, (float) sqrt(clearance[entry]) * cell - cell);
+        flat.push_back(vector<Vector2f>(1, pos));
+        sweep_material(c, pos, pos, true);
+        if (room > step) {
+            spiral_entry(c, room, width, step, pos, heading, flat.back());
+        }
+    }
+
+    std::chrono::duration<float> budget(time_budget);
+    int idle = 0;
+    while (entry != NO_CELL) {
+        bool refine = adaptive_clock::now() - started < budget;
+        float s = refine ? step : 2 * step;
+        float next;
+        if (idle < IDLE_STEPS
+                && pick_heading(c, pos, heading, s, target, refine, next)) {
+            Vector2f to = pos + s * Vector2f(cos(next), sin(next));
+            idle = sweep_material(c, pos, to, true) > 0 ? 0 : idle + 1;
+            flat.back().push_back(to);
+            pos = to;
+            heading = next;
+            continue;
+        }
+
+        // nothing left in reach; go over to the material nearest the tool,
+        // staying down if that's no heavier a cut than the target, and start
+        // off with it on the right
+        idle = 0;
+        uint32_t left;
+        if (!nearest_material(c, pos, left)) {
+            break;
+        }
+        Vector2f start = c.center(c.nearest_allowed[left]);
+        Vector2f toward = c.center(left) - start;
+        if (!link_clear(c, pos, start, target)) {
+            flat.push_back(vector<Vector2f>());
+        }
+        flat.back().push_back(start);
+        sweep_material(c, start, start, true);
+        c.material.reset(left % nx, left / nx);
+        pos = start;
+        heading = atan2(toward[1], toward[0]) + M_PI / 2;
+    }
+
+    // the pass along the walls, in the direction that keeps them on the
+    // right, starting each loop at its point nearest the tool
+    vector<region> rings;
+    offset_region(reg, r, tolerance, rings);
+    for (auto ring = rings.begin(); ring != rings.end(); ring++) {
+        vector<const polygon *> loops(1, &ring->outer);
+        for (auto h = ring->holes.begin(); h != ring->holes.end(); h++) {
+            loops.push_back(&*h);
+        }
+        for (auto l = loops.begin(); l != loops.end(); l++) {
+            const polygon &loop = **l;
+            size_t start = 0;
+            for (size_t k = 1; k < loop.size(); k++) {
+                if ((loop[k] - pos).squaredNorm()
+                        < (loop[start] - pos).squaredNorm()) {
+                    start = k;
+                }
+            }
+            flat.push_back(vector<Vector2f>());
+            for (size_t k = 0; k <= loop.size(); k++) {
+                flat.back().push_back(loop[(start + k) % loop.size()]);
+            }
+            pos = loop[start];
+        }
+    }
+
+    vector<float> xs, ys;
+    vector<bool> keep;
+    for (auto f = flat.begin(); f != flat.end(); f++) {
+        xs.clear();
+        ys.clear();
+        for (auto p = f->begin(); p != f->end(); p++) {
+            xs.push_back((*p)[0]);
+            ys.push_back((*p)[1]);
+        }
+        douglas_peucker(xs, ys, tolerance, keep);
+        passes.push_back(vector<Vector3f>());
+        for (size_t k = 0; k < f->size(); k++) {
+            if (keep[k]) {
+                passes.back().push_back(Vector3f(xs[k], ys[k], z));
+            }
+        }
+    }
+}
+
+path adaptive_clear(
+        const vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest) {
+    return clear_layers(levelsets, td, [](
+                const region &reg, const float z, const tooldef td,
+                vector<vector<Vector3f>> &passes) {
+        adaptive_region(
+                reg, z, td.r, td.stepover * 2 * td.r, td.tolerance,
+                td.adaptive_time, passes);
+    }, rest, safe_height(levelsets, td));
+}
@@ -0,0 +1,48 @@
+#ifndef __TP_ADAPTIVE_H__
+#define __TP_ADAPTIVE_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "path.h"
+#include "polygon.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// adaptive clearing: instead of following fixed rings or scanlines, the tool
+// feels its way through the material, steering at every small step so that
+// the arc of its edge in contact with uncut material stays close to the arc
+// of a straight cut stepover wide. that keeps the load on the tool even in
+// corners, where offset and raster passes suddenly bury it.
+//
+// the material left in a region is a grid of cells with one bit each, about
+// eight cells across the tool's radius, cleared under the tool as it moves.
+// the cells the tool center may visit, and the material it can reach at all,
+// come from exact euclidean distance transforms of the grid. engagement is
+// counted at fixed points around the leading half of the tool's edge.
+//
+// the tool enters each region in a spiral at the point furthest from its
+// boundary, then keeps the material on its right: every step scans headings
+// across the half circle ahead of it for where engagement crosses the target
+// and bisects between the two headings around it. when nothing is left in
+// reach, the tool moves on to the nearest remaining material, linking
+// straight to it if that doesn't cut anything. searching stops refining
+// headings, and takes longer steps, once the region has used up
+// time_budget seconds.
+//
+// finished passes are simplified to within tolerance and appended to passes.
+void adaptive_region(
+        const region &reg, const float z, const float r, const float stepover,
+        const float tolerance, const float time_budget,
+        std::vector<std::vector<Vector3f>> &passes);
+
+// clears every region of every layer with adaptive passes, working from the
+// top layer down, with td.adaptive_time for each region. if rest is given,
+// only what's left of that stock is cut.
+path adaptive_clear(
+        const std::vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest);
+
+#endif
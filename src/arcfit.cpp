@@ -0,0 +1,260 @@
+#include "arcfit.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+using std::vector;
+
+// running state for fitting one arc that starts at points[start]. coordinates
+// are kept relative to the starting point and in double precision so the fit
+// stays well-conditioned far away from the origin.
+class arcfitter {
+    public:
+        arcfitter(
+                const vector<Vector3f> &points, const size_t start,
+                const double tolerance);
+
+        // tries to extend the arc to also cover points[end + 1]. returns false
+        // and leaves the arc untouched if the new point can't be covered.
+        bool extend();
+        // true if a straight line through the first and last point covers
+        // every point just as well as the arc does.
+        bool is_straight() const;
+
+        // index of the last point covered by the arc
+        size_t end;
+        // the circle the arc lies on, relative to points[start]. only valid
+        // once has_circle is set.
+        bool has_circle;
+        Vector2d center;
+        double radius;
+        bool ccw;
+
+    private:
+        Vector2d rel(const size_t i) const;
+        double deviation(
+                const Vector2d &p, const Vector2d &c, const double r) const;
+        double max_deviation(
+                const Vector2d &c, const double r, const size_t last) const;
+
+        const vector<Vector3f> &points;
+        const size_t start;
+        const double tolerance;
+
+        // running sums for the algebraic (Kasa) least-squares circle fit,
+        // where z = x^2 + y^2
+        double n, sx, sy, sxx, syy, sxy, sxz, syz, sz;
+        // -1 for clockwise, 1 for counterclockwise, 0 until the points turn
+        int turn;
+        // total angle turned between consecutive segments
+        double sweep;
+        // upper bound on the distance between any covered point (or segment
+        // midpoint) and the current circle
+        double bound;
+};
+
+arcfitter::arcfitter(
+        const vector<Vector3f> &points, const size_t start,
+        const double tolerance) :
+        end(start), has_circle(false), radius(0), ccw(false), points(points),
+        start(start), tolerance(tolerance), n(1), sx(0), sy(0), sxx(0),
+        syy(0), sxy(0), sxz(0), syz(0), sz(0), turn(0), sweep(0), bound(0) {}
+
+Vector2d arcfitter::rel(const size_t i) const {
+    return Vector2d(
+            (double) points[i][0] - points[start][0],
+            (double) points[i][1] - points[start][1]);
+}
+
+double arcfitter::deviation(
+        const Vector2d &p, const Vector2d &c, const double r) const {
+    return fabs((p - c).norm() - r);
+}
+
+// exact maximum distance between the circle and the points and segment
+// midpoints from start to last. a chord between two points on the circle is
+// furthest from the arc at its midpoint, so checking those catches polygons
+// whose corners happen to lie on a circle.
+double arcfitter::max_deviation(
+        const Vector2d &c, const double r, const size_t last) const {
+    double dev = 0;
+    Vector2d prev = rel(start);
+    for (size_t i = start + 1; i <= last; i++) {
+        Vector2d p = rel(i);
+        dev = max(dev, deviation(p, c, r));
+        dev = max(dev, deviation((p + prev) / 2, c, r));
+        prev = p;
+    }
+    return dev;
+}
+
+bool arcfitter::extend() {
+    size_t k = end + 1;
+    if (k >= points.size()) {
+        return false;
+    }
+    // arcs are emitted in the xy-plane only
+    if (fabs(points[k][2] - points[start][2]) > tolerance) {
+        return false;
+    }
+
+    Vector2d p = rel(k);
+    Vector2d prev = rel(end);
+    if (p == prev) {
+        return false;
+    }
+
+    // points on an arc keep turning the same way and the turns can't add up
+    // to more than the sweep of the arc
+    int new_turn = turn;
+    double new_sweep = sweep;
+    if (end > start) {
+        Vector2d d0 = prev - rel(end - 1);
+        Vector2d d1 = p - prev;
+        double cross = d0.x() * d1.y() - d0.y() * d1.x();
+        int t = cross > 0 ? 1 : (cross < 0 ? -1 : 0);
+        if (t != 0) {
+            if (new_turn == 0) {
+                new_turn = t;
+            } else if (t != new_turn) {
+                return false;
+            }
+        }
+        new_sweep += fabs(atan2(cross, d0.dot(d1)));
+        if (new_sweep > ARC_MAX_SWEEP) {
+            return false;
+        }
+    }
+
+    double pz = p.squaredNorm();
+    double nn = n + 1,
+           nsx = sx + p.x(),
+           nsy = sy + p.y(),
+           nsxx = sxx + p.x() * p.x(),
+           nsyy = syy + p.y() * p.y(),
+           nsxy = sxy + p.x() * p.y(),
+           nsxz = sxz + p.x() * pz,
+           nsyz = syz + p.y() * pz,
+           nsz = sz + pz;
+
+    Vector2d c;
+    double r = 0;
+    if (nn >= 3) {
+        Matrix3d a;
+        a << nsxx, nsxy, nsx,
+             nsxy, nsyy, nsy,
+             nsx,  nsy,  nn;
+        FullPivLU<Matrix3d> lu(a);
+        if (lu.rank() < 3) {
+            // the points are collinear
+            return false;
+        }
+        Vector3d sol = lu.solve(Vector3d(-nsxz, -nsyz, -nsz));
+        Vector2d fit(-sol[0] / 2, -sol[1] / 2);
+
+        // the least-squares center doesn't put both end points on the
+        // circle; slide it onto their perpendicular bisector so it does.
+        Vector2d mid = p / 2;
+        Vector2d u(-p.y(), p.x());
+        u.normalize();
+        c = mid + u * u.dot(fit - mid);
+        r = c.norm();
+        if (!std::isfinite(r)) {
+            return false;
+        }
+        // the turns between chords fall short of the arc's sweep by half of
+        // what the first and last chord each sweep
+        double half_first = asin(min(1.0, rel(start + 1).norm() / (2 * r))),
+               half_last = asin(min(1.0, (p - prev).norm() / (2 * r)));
+        if (new_sweep + half_first + half_last > ARC_MAX_SWEEP) {
+            return false;
+        }
+
+        // moving the circle moves every covered point's distance from it by
+        // at most the distance the circle moved, so we only rescan the whole
+        // run when that cheap bound stops being good enough.
+        double new_bound = INFINITY;
+        if (has_circle) {
+            new_bound = bound + (c - center).norm() + fabs(r - radius);
+        }
+        new_bound = max(new_bound, deviation(p, c, r));
+        new_bound = max(new_bound, deviation((p + prev) / 2, c, r));
+        if (new_bound > tolerance) {
+            new_bound = max_deviation(c, r, k);
+            if (new_bound > tolerance) {
+                return false;
+            }
+        }
+
+        bound = new_bound;
+        center = c;
+        radius = r;
+        has_circle = true;
+        ccw = new_turn > 0;
+    }
+
+    n = nn;
+    sx = nsx;
+    sy = nsy;
+    sxx = nsxx;
+    syy = nsyy;
+    sxy = nsxy;
+    sxz = nsxz;
+    syz = nsyz;
+    sz = nsz;
+    turn = new_turn;
+    sweep = new_sweep;
+    end = k;
+    return true;
+}
+
+bool arcfitter::is_straight() const {
+    Vector2d chord = rel(end);
+    double len = chord.norm();
+    if (len == 0) {
+        return false;
+    }
+    for (size_t i = start + 1; i < end; i++) {
+        Vector2d p = rel(i);
+        if (fabs(chord.x() * p.y() - chord.y() * p.x()) / len > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void fit_arcs(
+        const vector<Vector3f> &points, const float tolerance,
+        vector<move> &out) {
+    size_t start = 0;
+    while (start + 1 < points.size()) {
+        arcfitter fit(points, start, tolerance);
+        while (fit.extend());
+
+        size_t covered = fit.end - start + 1;
+        if (covered < ARC_MIN_POINTS || !fit.has_circle) {
+            out.push_back(move(MOVE_LINEAR, points[start + 1]));
+            start++;
+            continue;
+        }
+        if (fit.is_straight()) {
+            // a very flat arc; plain moves are just as good and keep huge
+            // radii out of the output.
+            for (size_t i = start + 1; i <= fit.end; i++) {
+                out.push_back(move(MOVE_LINEAR, points[i]));
+            }
+            start = fit.end;
+            continue;
+        }
+
+        move m(fit.ccw ? MOVE_ARC_CCW : MOVE_ARC_CW, points[fit.end]);
+        m.center = Vector3f(
+                points[start][0] + fit.center.x(),
+                points[start][1] + fit.center.y(),
+                points[start][2]);
+        out.push_back(m);
+        start = fit.end;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef __TP_ARCFIT_H__
+#define __TP_ARCFIT_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "path.h"
+
+using namespace Eigen;
+
+// arcs have to cover at least this many points to be worth emitting instead of
+// the linear moves they replace
+#define ARC_MIN_POINTS (4)
+// arcs may sweep at most this far around their center. full circles are
+// ambiguous in most controllers' arc syntax, so we stay well clear of them.
+#define ARC_MAX_SWEEP (1.5 * M_PI)
+
+// appends the moves tracing the polyline in points to out, replacing runs of
+// points that stay within tolerance of a circular arc in the xy-plane with a
+// single arc move. no move is emitted for points[0]; the caller is expected to
+// already be there.
+//
+// the fitter streams over the points once, maintaining a running least-squares
+// circle fit, so it runs in time linear in the number of points.
+void fit_arcs(
+        const std::vector<Vector3f> &points, const float tolerance,
+        std::vector<move> &out);
+
+#endif
@@ -0,0 +1,60 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+using std::max;
+
+// size of an arena's first block
+#define ARENA_FIRST_BLOCK (64 << 10)
+
+arena::arena() : heap_allocations(0), capacity(0), used(0) {}
+
+arena::~arena() {
+    for (auto b = blocks.begin(); b != blocks.end(); b++) {
+        free(b->data);
+    }
+}
+
+void arena::grow(const size_t size) {
+    block b;
+    b.size = max(size, blocks.empty()
+            ? (size_t) ARENA_FIRST_BLOCK : blocks.back().size * 2);
+    b.data = (char*) malloc(b.size);
+    if (b.data == NULL) {
+        throw std::bad_alloc();
+    }
+    blocks.push_back(b);
+    used = 0;
+    heap_allocations++;
+    capacity += b.size;
+}
+
+void *arena::allocate(const size_t size, const size_t align) {
+    // malloc's blocks are aligned for anything, so only the offset into the
+    // block has to be rounded up
+    size_t start = (used + align - 1) & ~(align - 1);
+    if (blocks.empty() || start + size > blocks.back().size) {
+        grow(size + align);
+        start = 0;
+    }
+    used = start + size;
+    return blocks.back().data + start;
+}
+
+void arena::reset() {
+    used = 0;
+    if (blocks.size() <= 1) {
+        return;
+    }
+    // swap all the blocks for a single one that holds as much, so the next
+    // round of the same size fits without growing
+    for (auto b = blocks.begin(); b != blocks.end(); b++) {
+        free(b->data);
+    }
+    blocks.clear();
+    size_t total = capacity;
+    capacity = 0;
+    grow(total);
+}
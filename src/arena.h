@@ -0,0 +1,81 @@
+#ifndef __TP_ARENA_H__
+#define __TP_ARENA_H__
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// a monotonic arena: allocations are handed out of big blocks by bumping a
+// pointer and never freed one at a time, only all at once by reset. after a
+// reset the arena keeps a single block as big as everything it held, so work
+// that needs about the same memory every time, like slicing one layer after
+// another, stops touching the heap after the first few rounds.
+class arena {
+    public:
+        arena();
+        ~arena();
+
+        // size bytes aligned to align, which must be a power of two
+        void *allocate(const size_t size, const size_t align);
+        // forgets everything allocated so far. anything still using the
+        // arena's memory mustn't be touched again.
+        void reset();
+
+        // how many times the arena has gone to the heap for a block, and the
+        // bytes it holds now
+        uint64_t heap_allocations;
+        size_t capacity;
+
+    private:
+        arena(const arena &other);
+        arena& operator= (const arena &other);
+
+        // adds a block of at least size bytes and makes it the current one
+        void grow(const size_t size);
+
+        struct block {
+            char *data;
+            size_t size;
+        };
+
+        std::vector<block> blocks;
+        // bytes used in the last block
+        size_t used;
+};
+
+// lets standard containers allocate from an arena. deallocating does nothing;
+// the memory comes back when the arena is reset, so a container must be gone
+// (or never used again) by then.
+template <typename T>
+class arena_allocator {
+    public:
+        typedef T value_type;
+
+        arena_allocator(arena &a) : a(&a) {}
+        template <typename U>
+        arena_allocator(const arena_allocator<U> &other) : a(other.a) {}
+
+        T* allocate(const size_t n) {
+            return (T*) a->allocate(n * sizeof(T), alignof(T));
+        }
+        void deallocate(T*, size_t) {}
+
+        arena *a;
+};
+
+template <typename T, typename U>
+bool operator== (const arena_allocator<T> &x, const arena_allocator<U> &y) {
+    return x.a == y.a;
+}
+
+template <typename T, typename U>
+bool operator!= (const arena_allocator<T> &x, const arena_allocator<U> &y) {
+    return x.a != y.a;
+}
+
+// a vector in an arena, for scratch space that only lives as long as a single
+// round of work
+template <typename T>
+using scratch_vector = std::vector<T, arena_allocator<T>>;
+
+#endif
@@ -0,0 +1,693 @@
+#include "boolean.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+typedef boolean_scratch::point fixpoint;
+typedef boolean_scratch::edge fixedge;
+typedef boolean_scratch::fragment fragment;
+
+bool operator==(const fixpoint &a, const fixpoint &b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+bool operator!=(const fixpoint &a, const fixpoint &b) {
+    return !(a == b);
+}
+
+bool operator<(const fixpoint &a, const fixpoint &b) {
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+// twice the signed area of the triangle a b c, positive if it turns left
+__int128 orient_fixed(const fixpoint &a, const fixpoint &b, const fixpoint &c) {
+    return (__int128) (b.x - a.x) * (c.y - a.y)
+        - (__int128) (b.y - a.y) * (c.x - a.x);
+}
+
+int sign_of(const __int128 v) {
+    return (v > 0) - (v < 0);
+}
+
+// num / den rounded to the nearest integer, halves rounding up
+int64_t round_div(__int128 num, __int128 den) {
+    if (den < 0) {
+        num = -num;
+        den = -den;
+    }
+    __int128 twice = 2 * num + den, q = twice / (2 * den);
+    if (twice % (2 * den) != 0 && twice < 0) {
+        q--;
+    }
+    return (int64_t) q;
+}
+
+int64_t floor_div(const int64_t a, const int64_t b) {
+    return a / b - (a % b != 0 && a < 0);
+}
+
+uint64_t fixed_cell_key(const int64_t cx, const int64_t cy) {
+    return ((uint64_t) (cx + 1) << 32) | (uint32_t) (cy + 1);
+}
+
+// calls fn with every cell the edge comes within one grid step of, so both
+// the edges it crosses and the squares around hot points it passes through
+// share a cell with it. the cells of each column are found from the edge's
+// extent in y over the column, widened by a step on every side.
+template <typename F>
+void cover_edge(const fixedge &e, const int64_t cell, F fn) {
+    int64_t x0 = min(e.a.x, e.b.x), x1 = max(e.a.x, e.b.x);
+    for (int64_t cx = floor_div(x0 - 1, cell); cx <= floor_div(x1 + 1, cell);
+            cx++) {
+        int64_t lo = max(x0, cx * cell - 1), hi = min(x1, (cx + 1) * cell + 1);
+        double ylo, yhi;
+        if (e.a.x == e.b.x) {
+            ylo = min(e.a.y, e.b.y);
+            yhi = max(e.a.y, e.b.y);
+        } else {
+            double slope = (double) (e.b.y - e.a.y) / (e.b.x - e.a.x);
+            double y_lo = e.a.y + slope * (lo - e.a.x),
+                   y_hi = e.a.y + slope * (hi - e.a.x);
+            ylo = min(y_lo, y_hi);
+            yhi = max(y_lo, y_hi);
+        }
+        int64_t cy0 = floor_div((int64_t) floor(ylo) - 1, cell),
+                cy1 = floor_div((int64_t) ceil(yhi) + 1, cell);
+        for (int64_t cy = cy0; cy <= cy1; cy++) {
+            fn(fixed_cell_key(cx, cy));
+        }
+    }
+}
+
+// the point where two edges cross, rounded to the grid. false if they don't
+// cross away from their ends; edges that touch or overlap meet at corners,
+// which are hot already.
+bool fixed_crossing(const fixedge &e, const fixedge &f, fixpoint &out) {
+    if (max(e.a.x, e.b.x) < min(f.a.x, f.b.x)
+            || max(f.a.x, f.b.x) < min(e.a.x, e.b.x)
+            || max(e.a.y, e.b.y) < min(f.a.y, f.b.y)
+            || max(f.a.y, f.b.y) < min(e.a.y, e.b.y)) {
+        return false;
+    }
+    __int128 oa = orient_fixed(f.a, f.b, e.a), ob = orient_fixed(f.a, f.b, e.b);
+    if (sign_of(oa) * sign_of(ob) >= 0) {
+        return false;
+    }
+    int sc = sign_of(orient_fixed(e.a, e.b, f.a)),
+        sd = sign_of(orient_fixed(e.a, e.b, f.b));
+    if (sc * sd >= 0) {
+        return false;
+    }
+    // the orientation against f goes linearly from oa to ob along e
+    __int128 den = oa - ob;
+    out.x = e.a.x + round_div((__int128) (e.b.x - e.a.x) * oa, den);
+    out.y = e.a.y + round_div((__int128) (e.b.y - e.a.y) * oa, den);
+    return true;
+}
+
+// whether an edge passes through the closed unit square centered on h
+bool passes_pixel(const fixedge &e, const fixpoint &h) {
+    // in doubled coordinates, where the square's corners are on the grid
+    fixpoint a = {2 * e.a.x, 2 * e.a.y}, b = {2 * e.b.x, 2 * e.b.y};
+    if (max(a.x, b.x) < 2 * h.x - 1 || min(a.x, b.x) > 2 * h.x + 1
+            || max(a.y, b.y) < 2 * h.y - 1 || min(a.y, b.y) > 2 * h.y + 1) {
+        return false;
+    }
+    int pos = 0, neg = 0;
+    for (int c = 0; c < 4; c++) {
+        fixpoint corner = {
+            2 * h.x + (c & 1 ? 1 : -1), 2 * h.y + (c & 2 ? 1 : -1)};
+        int s = sign_of(orient_fixed(a, b, corner));
+        pos += s > 0;
+        neg += s < 0;
+    }
+    return pos < 4 && neg < 4;
+}
+
+// whether a fragment is left of another, where both span the same heights
+bool fragment_left_of(const fragment &f, const fragment &g) {
+    // compare them halfway up the heights they share, at y2 / 2
+    int64_t y2 = max(f.lo.y, g.lo.y) + min(f.hi.y, g.hi.y);
+    int64_t fdy = f.hi.y - f.lo.y, gdy = g.hi.y - g.lo.y;
+    // the x of each there is num / (2 dy)
+    __int128 fnum = (__int128) 2 * f.lo.x * fdy
+        + (__int128) (f.hi.x - f.lo.x) * (y2 - 2 * f.lo.y);
+    __int128 gnum = (__int128) 2 * g.lo.x * gdy
+        + (__int128) (g.hi.x - g.lo.x) * (y2 - 2 * g.lo.y);
+    return fnum * gdy < gnum * fdy;
+}
+
+// whether a fragment is left of x2 / 2 at height y
+bool fragment_left_at(const fragment &f, const int64_t y, const int64_t x2) {
+    int64_t dy = f.hi.y - f.lo.y;
+    __int128 num = (__int128) 2 * f.lo.x * dy
+        + (__int128) 2 * (f.hi.x - f.lo.x) * (y - f.lo.y);
+    return num < (__int128) x2 * dy;
+}
+
+bool is_filled(const int winding, const int fill) {
+    switch (fill) {
+        case FILL_EVEN_ODD:
+            return winding & 1;
+        case FILL_NONZERO:
+            return winding != 0;
+        default:
+            return winding > 0;
+    }
+}
+
+bool in_result(const int winding[2], const int op, const int fill) {
+    bool s = is_filled(winding[0], fill), c = is_filled(winding[1], fill);
+    switch (op) {
+        case BOOL_UNION:
+            return s || c;
+        case BOOL_INTERSECTION:
+            return s && c;
+        case BOOL_DIFFERENCE:
+            return s && !c;
+        default:
+            return s != c;
+    }
+}
+
+// the winding on the right of the last active fragment left of x2 / 2 at
+// height y, which is the winding there
+void winding_at(
+        const vector<fragment> &fragments, const vector<uint32_t> &active,
+        const int64_t y, const int64_t x2, int out[2]) {
+    auto it = std::partition_point(active.begin(), active.end(),
+            [&](const uint32_t i) {
+        return fragment_left_at(fragments[i], y, x2);
+    });
+    out[0] = out[1] = 0;
+    if (it != active.begin()) {
+        const fragment &f = fragments[*(it - 1)];
+        for (int k = 0; k < 2; k++) {
+            out[k] = f.left[k] + f.wind[k];
+        }
+    }
+}
+
+// whether turning clockwise from r, direction u comes before direction w
+bool clockwise_before(
+        const fixpoint &r, const fixpoint &u, const fixpoint &w) {
+    fixpoint o = {0, 0};
+    auto half = [&](const fixpoint &d) {
+        __int128 c = orient_fixed(o, r, d);
+        return c < 0
+            || (c == 0 && (__int128) r.x * d.x + (__int128) r.y * d.y > 0)
+            ? 0 : 1;
+    };
+    int hu = half(u), hw = half(w);
+    if (hu != hw) {
+        return hu < hw;
+    }
+    return orient_fixed(o, u, w) < 0;
+}
+
+// whether the doubled point p is inside the polygon, by crossings of a ray
+// going right. p is never on it.
+bool inside_fixed(const fixpoint &p, const vector<fixpoint> &loop) {
+    bool inside = false;
+    for (size_t i = 0, j = loop.size() - 1; i < loop.size(); j = i++) {
+        fixpoint a = {2 * loop[j].x, 2 * loop[j].y},
+                 b = {2 * loop[i].x, 2 * loop[i].y};
+        if ((a.y > p.y) != (b.y > p.y)) {
+            __int128 o = orient_fixed(a, b, p);
+            if ((o > 0) == (b.y > a.y)) {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+__int128 fixed_area(const vector<fixpoint> &loop) {
+    __int128 area = 0;
+    for (size_t i = 0, j = loop.size() - 1; i < loop.size(); j = i++) {
+        area += (__int128) loop[j].x * loop[i].y
+            - (__int128) loop[i].x * loop[j].y;
+    }
+    return area;
+}
+
+void polygon_boolean(
+        const vector<polygon> &subject, const vector<polygon> &clip,
+        const int op, const int fill, const float resolution,
+        vector<region> &out, boolean_scratch &scratch) {
+    const vector<polygon> *operands[2] = {&subject, &clip};
+    Vector2d lo(INFINITY, INFINITY), hi(-INFINITY, -INFINITY);
+    for (int k = 0; k < 2; k++) {
+        for (auto p = operands[k]->begin(); p != operands[k]->end(); p++) {
+            for (auto pt = p->begin(); pt != p->end(); pt++) {
+                lo = lo.cwiseMin(pt->cast<double>());
+                hi = hi.cwiseMax(pt->cast<double>());
+            }
+        }
+    }
+    if (!(lo[0] <= hi[0])) {
+        return;
+    }
+    double step = max((double) resolution,
+            (hi - lo).maxCoeff() / BOOL_MAX_STEPS);
+
+    // the edges of both operands on the grid
+    vector<fixedge> &edges = scratch.edges;
+    vector<fixpoint> &hot = scratch.hot;
+    edges.clear();
+    hot.clear();
+    double total_len = 0;
+    for (int k = 0; k < 2; k++) {
+        for (auto p = operands[k]->begin(); p != operands[k]->end(); p++) {
+            size_t first = hot.size();
+            for (auto pt = p->begin(); pt != p->end(); pt++) {
+                fixpoint f = {
+                    llround(((*pt)[0] - lo[0]) / step),
+                    llround(((*pt)[1] - lo[1]) / step)};
+                if (hot.size() == first || f != hot.back()) {
+                    hot.push_back(f);
+                }
+            }
+            while (hot.size() > first + 1 && hot.back() == hot[first]) {
+                hot.pop_back();
+            }
+            if (hot.size() < first + 3) {
+                hot.resize(first);
+                continue;
+            }
+            for (size_t i = first; i < hot.size(); i++) {
+                fixedge e;
+                e.a = hot[i];
+                e.b = hot[i + 1 == hot.size() ? first : i + 1];
+                e.operand = k;
+                edges.push_back(e);
+                total_len += max(max(e.b.x - e.a.x, e.a.x - e.b.x),
+                        max(e.b.y - e.a.y, e.a.y - e.b.y));
+            }
+        }
+    }
+    if (edges.empty()) {
+        return;
+    }
+
+    // cells a few times the typical edge, so each edge only covers a handful
+    int64_t cell = max((int64_t) 8, (int64_t) (2 * total_len / edges.size()));
+    // cells are emptied rather than dropped, so their memory gets reused,
+    // unless there are far more of them left over than this call needs
+    std::unordered_map<uint64_t, vector<uint32_t>> *cells[2] = {
+        &scratch.edge_cells, &scratch.hot_cells};
+    for (int k = 0; k < 2; k++) {
+        if (cells[k]->size() > 4 * edges.size() + 1024) {
+            cells[k]->clear();
+        }
+        for (auto c = cells[k]->begin(); c != cells[k]->end(); c++) {
+            c->second.clear();
+        }
+    }
+    for (uint32_t i = 0; i < edges.size(); i++) {
+        cover_edge(edges[i], cell, [&](const uint64_t key) {
+            vector<uint32_t> &in = scratch.edge_cells[key];
+            if (in.empty() || in.back() != i) {
+                in.push_back(i);
+            }
+        });
+    }
+
+    // every corner and every crossing is hot, and every edge gets bent
+    // through the center of every hot square it passes through
+    for (auto c = scratch.edge_cells.begin(); c != scratch.edge_cells.end();
+            c++) {
+        const vector<uint32_t> &in = c->second;
+        for (size_t i = 0; i < in.size(); i++) {
+            for (size_t j = i + 1; j < in.size(); j++) {
+                fixpoint x;
+                if (fixed_crossing(edges[in[i]], edges[in[j]], x)) {
+                    hot.push_back(x);
+                }
+            }
+        }
+    }
+    std::sort(hot.begin(), hot.end());
+    hot.erase(std::unique(hot.begin(), hot.end()), hot.end());
+    // where edges are long and cross a lot, there are far more hot points
+    // than edges, so they get cells of their own, small enough to hold only a
+    // few of them if they were spread evenly
+    int64_t extent = (int64_t) ceil((hi - lo).maxCoeff() / step);
+    int64_t hot_cell = max((int64_t) 8, min(cell,
+                (int64_t) (extent / sqrt((double) hot.size()))));
+    for (uint32_t h = 0; h < hot.size(); h++) {
+        scratch.hot_cells[fixed_cell_key(
+                floor_div(hot[h].x, hot_cell), floor_div(hot[h].y, hot_cell))]
+            .push_back(h);
+    }
+
+    // the snapped pieces, each going up (or right, if it's flat), with how
+    // they change their operand's winding across them
+    vector<fragment> &fragments = scratch.fragments;
+    fragments.clear();
+    vector<std::pair<int64_t, fixpoint>> &along = scratch.along;
+    for (auto e = edges.begin(); e != edges.end(); e++) {
+        along.clear();
+        int64_t dx = e->b.x - e->a.x, dy = e->b.y - e->a.y;
+        cover_edge(*e, hot_cell, [&](const uint64_t key) {
+            auto found = scratch.hot_cells.find(key);
+            if (found == scratch.hot_cells.end()) {
+                return;
+            }
+            for (auto h = found->second.begin(); h != found->second.end();
+                    h++) {
+                const fixpoint &p = hot[*h];
+                if (p != e->a && p != e->b && passes_pixel(*e, p)) {
+                    along.push_back(std::make_pair(
+                                (p.x - e->a.x) * dx + (p.y - e->a.y) * dy, p));
+                }
+            }
+        });
+        std::sort(along.begin(), along.end(),
+                [](const std::pair<int64_t, fixpoint> &u,
+                    const std::pair<int64_t, fixpoint> &w) {
+            return u.first < w.first
+                || (u.first == w.first && u.second < w.second);
+        });
+        fixpoint from = e->a;
+        for (size_t k = 0; k <= along.size(); k++) {
+            fixpoint to = k == along.size() ? e->b : along[k].second;
+            if (to == from) {
+                continue;
+            }
+            fragment f;
+            bool forward = from < to;
+            f.lo = forward ? from : to;
+            f.hi = forward ? to : from;
+            f.wind[0] = f.wind[1] = 0;
+            // going up, the winding drops from left to right; going right,
+            // it rises from bottom to top
+            if (f.lo.y == f.hi.y) {
+                f.wind[e->operand] = forward ? 1 : -1;
+            } else {
+                f.wind[e->operand] = forward ? -1 : 1;
+            }
+            fragments.push_back(f);
+            from = to;
+        }
+    }
+
+    // pieces of edges that snapped onto each other become one
+    std::sort(fragments.begin(), fragments.end(),
+            [](const fragment &f, const fragment &g) {
+        return f.lo < g.lo || (f.lo == g.lo && f.hi < g.hi);
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < fragments.size(); i++) {
+        if (kept > 0 && fragments[kept - 1].lo == fragments[i].lo
+                && fragments[kept - 1].hi == fragments[i].hi) {
+            for (int k = 0; k < 2; k++) {
+                fragments[kept - 1].wind[k] += fragments[i].wind[k];
+            }
+        } else {
+            if (kept > 0 && fragments[kept - 1].wind[0] == 0
+                    && fragments[kept - 1].wind[1] == 0) {
+                kept--;
+            }
+            fragments[kept++] = fragments[i];
+        }
+    }
+    if (kept > 0 && fragments[kept - 1].wind[0] == 0
+            && fragments[kept - 1].wind[1] == 0) {
+        kept--;
+    }
+    fragments.resize(kept);
+
+    // sweep up the plane. between one height where fragments start or end
+    // and the next, the active ones cross it in a fixed order, and the
+    // winding on the left of each is the winding on the right of the one
+    // before it. flat fragments take the winding above and below them from
+    // the active fragments just left of their middle.
+    vector<uint32_t> &starts = scratch.starts, &ends = scratch.ends,
+        &flat = scratch.flat, &active = scratch.active;
+    starts.clear();
+    ends.clear();
+    flat.clear();
+    active.clear();
+    for (uint32_t i = 0; i < fragments.size(); i++) {
+        if (fragments[i].lo.y == fragments[i].hi.y) {
+            flat.push_back(i);
+        } else {
+            starts.push_back(i);
+            ends.push_back(i);
+        }
+    }
+    // fragments are sorted by their lower end already
+    std::sort(ends.begin(), ends.end(),
+            [&](const uint32_t i, const uint32_t j) {
+        return fragments[i].hi.y < fragments[j].hi.y;
+    });
+    vector<fixedge> &boundary = scratch.boundary;
+    boundary.clear();
+    auto emit = [&](const fragment &f, const bool forward) {
+        fixedge b;
+        b.a = forward ? f.lo : f.hi;
+        b.b = forward ? f.hi : f.lo;
+        b.operand = 0;
+        boundary.push_back(b);
+    };
+    size_t si = 0, ei = 0, fi = 0;
+    while (si < starts.size() || ei < ends.size() || fi < flat.size()) {
+        int64_t y = INT64_MAX;
+        if (si < starts.size()) {
+            y = min(y, fragments[starts[si]].lo.y);
+        }
+        if (ei < ends.size()) {
+            y = min(y, fragments[ends[ei]].hi.y);
+        }
+        if (fi < flat.size()) {
+            y = min(y, fragments[flat[fi]].lo.y);
+        }
+
+        size_t flat_end = fi;
+        while (flat_end < flat.size() && fragments[flat[flat_end]].lo.y == y) {
+            fragment &f = fragments[flat[flat_end++]];
+            winding_at(fragments, active, y, f.lo.x + f.hi.x, f.left);
+        }
+        auto left_of = [&](const uint32_t a, const uint32_t b) {
+            return fragment_left_of(fragments[a], fragments[b]);
+        };
+        for (; ei < ends.size() && fragments[ends[ei]].hi.y == y; ei++) {
+            active.erase(std::lower_bound(
+                        active.begin(), active.end(), ends[ei], left_of));
+        }
+        // the ones starting here go in from left to right, so the one before
+        // each already has its winding
+        size_t batch = si;
+        while (si < starts.size() && fragments[starts[si]].lo.y == y) {
+            si++;
+        }
+        std::sort(starts.begin() + batch, starts.begin() + si, left_of);
+        auto at = active.begin();
+        for (size_t k = batch; k < si; k++) {
+            uint32_t i = starts[k];
+            fragment &f = fragments[i];
+            at = std::lower_bound(at, active.end(), i, left_of);
+            f.left[0] = f.left[1] = 0;
+            if (at != active.begin()) {
+                const fragment &g = fragments[*(at - 1)];
+                for (int w = 0; w < 2; w++) {
+                    f.left[w] = g.left[w] + g.wind[w];
+                }
+            }
+            at = active.insert(at, i) + 1;
+            int right[2] = {f.left[0] + f.wind[0], f.left[1] + f.wind[1]};
+            bool in_left = in_result(f.left, op, fill),
+                 in_right = in_result(right, op, fill);
+            if (in_left != in_right) {
+                emit(f, in_left);
+            }
+        }
+        for (; fi < flat_end; fi++) {
+            fragment &f = fragments[flat[fi]];
+            int above[2];
+            winding_at(fragments, active, y, f.lo.x + f.hi.x, above);
+            bool in_below = in_result(f.left, op, fill),
+                 in_above = in_result(above, op, fill);
+            if (in_below != in_above) {
+                emit(f, in_above);
+            }
+        }
+    }
+
+    // stitch the boundary into loops with the result on their left. where
+    // more than one boundary piece leaves a point, the walk takes the one
+    // turning furthest left, keeping to the part of the result it's going
+    // around; a walk that comes back to a point it already passed closes a
+    // loop there.
+    // pieces leaving the same point are next to each other once they're
+    // sorted, and the first of them stands for the point
+    std::sort(boundary.begin(), boundary.end(),
+            [](const fixedge &e, const fixedge &f) {
+        return e.a < f.a;
+    });
+    auto node = [&](const fixpoint &p) {
+        return std::lower_bound(boundary.begin(), boundary.end(), p,
+                [](const fixedge &e, const fixpoint &q) {
+            return e.a < q;
+        }) - boundary.begin();
+    };
+    vector<uint32_t> &to_node = scratch.to_node;
+    to_node.resize(boundary.size());
+    for (uint32_t b = 0; b < boundary.size(); b++) {
+        to_node[b] = node(boundary[b].b);
+    }
+
+    vector<vector<fixpoint>> loops;
+    vector<bool> used(boundary.size(), false);
+    vector<int64_t> walk_pos(boundary.size(), -1);
+    vector<uint32_t> walk;
+    for (uint32_t start = 0; start < boundary.size(); start++) {
+        if (used[start]) {
+            continue;
+        }
+        walk.clear();
+        walk.push_back(node(boundary[start].a));
+        walk_pos[walk.back()] = 0;
+        uint32_t next = start;
+        while (true) {
+            used[next] = true;
+            uint32_t to = to_node[next];
+            if (walk_pos[to] == -1) {
+                walk_pos[to] = walk.size();
+                walk.push_back(to);
+            } else {
+                size_t first = walk_pos[to];
+                vector<fixpoint> loop;
+                for (size_t w = first; w < walk.size(); w++) {
+                    // points in the middle of straight runs add nothing
+                    size_t before = w == first ? walk.size() - 1 : w - 1,
+                           after = w + 1 == walk.size() ? first : w + 1;
+                    const fixpoint &p = boundary[walk[w]].a,
+                          &prev = boundary[walk[before]].a,
+                          &nxt = boundary[walk[after]].a;
+                    if (orient_fixed(prev, p, nxt) != 0) {
+                        loop.push_back(p);
+                    }
+                    if (w > first) {
+                        walk_pos[walk[w]] = -1;
+                    }
+                }
+                walk.resize(first + 1);
+                if (loop.size() >= 3) {
+                    loops.push_back(loop);
+                }
+            }
+
+            fixpoint in = {
+                boundary[next].a.x - boundary[next].b.x,
+                boundary[next].a.y - boundary[next].b.y};
+            next = boundary.size();
+            for (uint32_t l = to;
+                    l < boundary.size() && boundary[l].a == boundary[to].a;
+                    l++) {
+                if (used[l]) {
+                    continue;
+                }
+                fixpoint d = {
+                    boundary[l].b.x - boundary[l].a.x,
+                    boundary[l].b.y - boundary[l].a.y};
+                if (next == boundary.size()) {
+                    next = l;
+                    continue;
+                }
+                fixpoint best = {
+                    boundary[next].b.x - boundary[next].a.x,
+                    boundary[next].b.y - boundary[next].a.y};
+                if (clockwise_before(in, d, best)) {
+                    next = l;
+                }
+            }
+            if (next == boundary.size()) {
+                break;
+            }
+        }
+        for (auto w = walk.begin(); w != walk.end(); w++) {
+            walk_pos[*w] = -1;
+        }
+    }
+
+    // counterclockwise loops are outer boundaries, and each clockwise one is
+    // a hole in the smallest of them around it
+    vector<size_t> outers;
+    vector<__int128> areas(loops.size());
+    for (size_t l = 0; l < loops.size(); l++) {
+        areas[l] = fixed_area(loops[l]);
+        if (areas[l] > 0) {
+            outers.push_back(l);
+        }
+    }
+    std::sort(outers.begin(), outers.end(), [&](size_t a, size_t b) {
+        return areas[a] < areas[b];
+    });
+    auto to_polygon = [&](const vector<fixpoint> &loop) {
+        polygon p;
+        for (auto pt = loop.begin(); pt != loop.end(); pt++) {
+            p.push_back(Vector2f(lo[0] + pt->x * step, lo[1] + pt->y * step));
+        }
+        return p;
+    };
+    size_t first = out.size();
+    vector<std::pair<fixpoint, fixpoint>> bounds;
+    for (size_t o = 0; o < outers.size(); o++) {
+        out.push_back(region());
+        out.back().outer = to_polygon(loops[outers[o]]);
+        const vector<fixpoint> &loop = loops[outers[o]];
+        fixpoint blo = loop[0], bhi = loop[0];
+        for (auto pt = loop.begin(); pt != loop.end(); pt++) {
+            blo.x = min(blo.x, pt->x);
+            blo.y = min(blo.y, pt->y);
+            bhi.x = max(bhi.x, pt->x);
+            bhi.y = max(bhi.y, pt->y);
+        }
+        bounds.push_back(std::make_pair(blo, bhi));
+    }
+    for (size_t l = 0; l < loops.size(); l++) {
+        if (areas[l] >= 0) {
+            continue;
+        }
+        // the middle of an edge of the hole is never on another loop, since
+        // they only meet at points on the grid
+        fixpoint mid = {
+            loops[l][0].x + loops[l][1].x, loops[l][0].y + loops[l][1].y};
+        size_t o = std::partition_point(outers.begin(), outers.end(),
+                [&](const size_t i) {
+            return areas[i] < -areas[l];
+        }) - outers.begin();
+        for (; o < outers.size(); o++) {
+            const fixpoint &blo = bounds[o].first, &bhi = bounds[o].second;
+            if (mid.x > 2 * blo.x && mid.x < 2 * bhi.x
+                    && mid.y > 2 * blo.y && mid.y < 2 * bhi.y
+                    && inside_fixed(mid, loops[outers[o]])) {
+                out[first + o].holes.push_back(to_polygon(loops[l]));
+                break;
+            }
+        }
+    }
+}
+
+void batch_boolean(
+        const vector<vector<polygon>> &subjects,
+        const vector<vector<polygon>> &clips,
+        const int op, const int fill, const float resolution,
+        vector<vector<region>> &out) {
+    out.assign(subjects.size(), vector<region>());
+    vector<polygon> none;
+    parallel_for(subjects.size(), [&](size_t i) {
+        static thread_local boolean_scratch scratch;
+        polygon_boolean(
+                subjects[i], i < clips.size() ? clips[i] : none,
+                op, fill, resolution, out[i], scratch);
+    });
+}
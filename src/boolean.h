@@ -0,0 +1,84 @@
+#ifndef __TP_BOOLEAN_H__
+#define __TP_BOOLEAN_H__
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "polygon.h"
+
+// boolean operations between two sets of polygons, the subject and the clip.
+// both are rounded onto an integer grid and everything after that is exact,
+// so there's no epsilon to get wrong: crossings are snap rounded onto the
+// grid (every edge through the square around a crossing or a corner is bent
+// through its center, so nothing new can cross), and a sweep up the plane
+// works out how many times each operand winds around the faces either side of
+// every piece of edge, in the manner of Vatti's clipper.
+
+// operations
+#define BOOL_UNION (0)
+#define BOOL_INTERSECTION (1)
+#define BOOL_DIFFERENCE (2)
+#define BOOL_XOR (3)
+
+// which points a set of polygons covers, by the number of times the polygons
+// wind around them: an odd number, anything but zero, or more than zero
+#define FILL_EVEN_ODD (0)
+#define FILL_NONZERO (1)
+#define FILL_POSITIVE (2)
+
+// most grid steps across the polygons, so the predicates can't overflow
+#define BOOL_MAX_STEPS ((int64_t) 1 << 30)
+
+// buffers for polygon_boolean, kept between calls so a batch of them doesn't
+// allocate the same memory over and over
+class boolean_scratch {
+    public:
+        struct point {
+            int64_t x, y;
+        };
+        // an edge of an operand, or a piece of one once it's been snapped
+        struct edge {
+            point a, b;
+            int operand;
+        };
+        // a piece of edge going up the plane, or along it to the right if
+        // it's horizontal, with how far each operand's winding goes up across
+        // it from left to right (bottom to top if horizontal), and the
+        // winding of each on its left
+        struct fragment {
+            point lo, hi;
+            int wind[2], left[2];
+        };
+
+        std::vector<edge> edges, snapped;
+        std::vector<point> hot;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> edge_cells,
+            hot_cells;
+        std::vector<std::pair<int64_t, point>> along;
+        std::vector<fragment> fragments;
+        std::vector<uint32_t> starts, ends, flat, active;
+        std::vector<edge> boundary;
+        std::vector<uint32_t> to_node;
+};
+
+// the parts of the plane covered by subject and clip combined with op, one of
+// the BOOL_ operations, with both covering what fill says they do. the
+// polygons are rounded to a grid resolution apart, or coarser if they span
+// more than BOOL_MAX_STEPS of it, and the result is exact on that grid.
+void polygon_boolean(
+        const std::vector<polygon> &subject, const std::vector<polygon> &clip,
+        const int op, const int fill, const float resolution,
+        std::vector<region> &out, boolean_scratch &scratch);
+
+// the same operation on many pairs of polygon sets, such as the layers of a
+// part, in parallel, with scratch space for every thread. out[i] is
+// subjects[i] combined with clips[i]; clips may be empty, to just tidy up the
+// subjects.
+void batch_boolean(
+        const std::vector<std::vector<polygon>> &subjects,
+        const std::vector<std::vector<polygon>> &clips,
+        const int op, const int fill, const float resolution,
+        std::vector<std::vector<region>> &out);
+
+#endif
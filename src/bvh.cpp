@@ -0,0 +1,85 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+using std::vector;
+
+// leaves with at most this many triangles aren't split any further
+#define BVH_LEAF_SIZE (4)
+
+bvh::bvh(const mesh &m) {
+    mesh_triangles(m, triangles);
+    if (triangles.empty()) {
+        return;
+    }
+
+    vector<Vector3f> centers;
+    for (auto t = triangles.begin(); t != triangles.end(); t++) {
+        centers.push_back((t->v[0] + t->v[1] + t->v[2]) / 3);
+    }
+    vector<uint32_t> order;
+    for (uint32_t i = 0; i < triangles.size(); i++) {
+        order.push_back(i);
+    }
+
+    // nodes waiting to be filled in, with the range of order they cover
+    struct pending {
+        uint32_t node, begin, end;
+    };
+    vector<pending> todo;
+    nodes.push_back(node());
+    pending root = { 0, 0, (uint32_t) triangles.size() };
+    todo.push_back(root);
+    while (!todo.empty()) {
+        pending p = todo.back();
+        todo.pop_back();
+
+        Vector3f lo = Vector3f::Constant(INFINITY),
+                 hi = Vector3f::Constant(-INFINITY),
+                 center_lo = lo, center_hi = hi;
+        for (uint32_t i = p.begin; i < p.end; i++) {
+            const triangle &t = triangles[order[i]];
+            for (int k = 0; k < 3; k++) {
+                lo = lo.cwiseMin(t.v[k]);
+                hi = hi.cwiseMax(t.v[k]);
+            }
+            center_lo = center_lo.cwiseMin(centers[order[i]]);
+            center_hi = center_hi.cwiseMax(centers[order[i]]);
+        }
+        nodes[p.node].lo = lo;
+        nodes[p.node].hi = hi;
+
+        if (p.end - p.begin <= BVH_LEAF_SIZE) {
+            nodes[p.node].first = p.begin;
+            nodes[p.node].count = p.end - p.begin;
+            continue;
+        }
+
+        int axis;
+        (center_hi - center_lo).maxCoeff(&axis);
+        uint32_t mid = p.begin + (p.end - p.begin) / 2;
+        std::nth_element(
+                order.begin() + p.begin, order.begin() + mid,
+                order.begin() + p.end, [&](uint32_t a, uint32_t b) {
+            return centers[a][axis] < centers[b][axis];
+        });
+
+        uint32_t children = nodes.size();
+        nodes[p.node].first = children;
+        nodes[p.node].count = 0;
+        nodes.push_back(node());
+        nodes.push_back(node());
+        pending left = { children, p.begin, mid },
+                right = { children + 1, mid, p.end };
+        todo.push_back(left);
+        todo.push_back(right);
+    }
+
+    // put the triangles in leaf order, so each leaf's are next to each other
+    vector<triangle> sorted;
+    sorted.reserve(triangles.size());
+    for (auto i = order.begin(); i != order.end(); i++) {
+        sorted.push_back(triangles[*i]);
+    }
+    triangles.swap(sorted);
+}
@@ -0,0 +1,65 @@
+#ifndef __TP_BVH_H__
+#define __TP_BVH_H__
+
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Dense>
+#include <meshparse/mesh.h>
+
+#include "triangulate.h"
+
+using namespace Eigen;
+using namespace meshparse;
+
+// a bounding volume hierarchy over the triangles of a mesh, for finding the
+// triangles that might touch a tool without looking at all of them. nodes
+// are split at the median of their triangles' centers along their longest
+// axis, so the tree is balanced and builds in O(n log n).
+class bvh {
+    public:
+        bvh(const mesh &m);
+
+        // calls visit(t) for every triangle t whose bounding box overlaps the
+        // box from lo to hi.
+        template <typename F>
+        void query(const Vector3f &lo, const Vector3f &hi, F visit) const;
+
+        std::vector<triangle> triangles;
+
+    private:
+        struct node {
+            Vector3f lo, hi;
+            // leaves hold triangles [first, first + count). inner nodes have
+            // count zero and their children at first and first + 1.
+            uint32_t first, count;
+        };
+
+        std::vector<node> nodes;
+};
+
+template <typename F>
+void bvh::query(const Vector3f &lo, const Vector3f &hi, F visit) const {
+    if (nodes.empty()) {
+        return;
+    }
+    uint32_t stack[64];
+    size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const node &n = nodes[stack[--depth]];
+        if ((n.lo.array() > hi.array()).any()
+                || (n.hi.array() < lo.array()).any()) {
+            continue;
+        }
+        if (n.count > 0) {
+            for (uint32_t i = n.first; i < n.first + n.count; i++) {
+                visit(triangles[i]);
+            }
+        } else {
+            stack[depth++] = n.first;
+            stack[depth++] = n.first + 1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,396 @@
+#include "cutter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "polygon.h"
+
+using std::max;
+using std::min;
+
+// iterations of golden section and bisection searches. each one shrinks the
+// interval by at least a factor of 0.618, so this gets it down to a few
+// millionths of where it started.
+#define SEARCH_ITERATIONS (30)
+
+#define GOLDEN (0.6180339887)
+
+// finds the maximum of the concave function f over [lo, hi] with a golden
+// section search. returns the argument it's found at.
+template <typename F>
+float golden_max(float lo, float hi, F f) {
+    float x1 = hi - GOLDEN * (hi - lo), x2 = lo + GOLDEN * (hi - lo);
+    float f1 = f(x1), f2 = f(x2);
+    for (int i = 0; i < SEARCH_ITERATIONS; i++) {
+        if (f1 < f2) {
+            lo = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = lo + GOLDEN * (hi - lo);
+            f2 = f(x2);
+        } else {
+            hi = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = hi - GOLDEN * (hi - lo);
+            f1 = f(x1);
+        }
+    }
+    return f1 < f2 ? x2 : x1;
+}
+
+// true if c lies inside the triangle's projection onto the xy-plane, with
+// either winding
+bool inside_xy(const triangle &t, const Vector2f &c) {
+    bool pos = false, neg = false;
+    for (int i = 0; i < 3; i++) {
+        const Vector3f &a = t.v[i], &b = t.v[(i + 1) % 3];
+        float cross = (b[0] - a[0]) * (c[1] - a[1])
+            - (b[1] - a[1]) * (c[0] - a[0]);
+        pos |= cross > 0;
+        neg |= cross < 0;
+    }
+    return !(pos && neg);
+}
+
+template <typename S>
+inline void drop_vertex(
+        const S &shape, const Vector3f &v, const Vector2f &c, float &z) {
+    float d = (Vector2f(v[0], v[1]) - c).norm();
+    if (d <= shape.r) {
+        z = max(z, v[2] - shape.height(d));
+    }
+}
+
+// the tool rests on the plane of the facet at the point its shape gives for
+// the facet's slope. that's only a contact with the facet itself if the point
+// is inside it; otherwise an edge or vertex is hit first.
+template <typename S>
+inline void drop_facet(
+        const S &shape, const triangle &t, const Vector2f &c, float &z) {
+    Vector3f n = (t.v[1] - t.v[0]).cross(t.v[2] - t.v[0]);
+    float len = n.norm();
+    if (n[2] < 0) {
+        n = -n;
+    }
+    if (len == 0 || n[2] <= 1e-6 * len) {
+        // vertical facets are only ever touched at their edges
+        return;
+    }
+    n /= len;
+
+    Vector2f nxy(n[0], n[1]);
+    float nxy_len = nxy.norm();
+    float rho, h;
+    shape.facet_contact(nxy_len, n[2], rho, h);
+    Vector2f contact = c;
+    if (nxy_len > 0) {
+        contact -= rho * nxy / nxy_len;
+    }
+    if (!inside_xy(t, contact)) {
+        return;
+    }
+    float plane_z = t.v[0][2]
+        - (n[0] * (contact[0] - t.v[0][0])
+                + n[1] * (contact[1] - t.v[0][1])) / n[2];
+    z = max(z, plane_z - h);
+}
+
+// finds the part [t0, t1] of the edge from p to q, as fractions of its length,
+// that's within r of c in the xy-plane. returns false if there is none, or if
+// the edge is vertical; those are touched at their top vertex.
+bool edge_chord(
+        const Vector3f &p, const Vector3f &q, const Vector2f &c,
+        const float r, double &t0, double &t1) {
+    Vector2d pc(p[0] - c[0], p[1] - c[1]);
+    Vector2d d(q[0] - p[0], q[1] - p[1]);
+    double a = d.squaredNorm();
+    if (a == 0) {
+        return false;
+    }
+    double b = 2 * pc.dot(d);
+    double k = pc.squaredNorm() - (double) r * r;
+    double disc = b * b - 4 * a * k;
+    if (disc < 0) {
+        return false;
+    }
+    t0 = max(0., (-b - sqrt(disc)) / (2 * a));
+    t1 = min(1., (-b + sqrt(disc)) / (2 * a));
+    return t0 <= t1;
+}
+
+// shapes without a simple closed form here, like the bull nose, whose corner
+// is a torus, fall back to a search. the tool is convex and the edge is
+// straight, so the contact height along the edge is concave and a golden
+// section search finds its peak.
+template <typename S>
+inline void drop_edge(
+        const S &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, float &z) {
+    double t0, t1;
+    if (!edge_chord(p, q, c, shape.r, t0, t1)) {
+        return;
+    }
+    Vector3f d = q - p;
+    auto height_at = [&](float t) {
+        Vector2f e(p[0] + t * d[0] - c[0], p[1] + t * d[1] - c[1]);
+        return p[2] + t * d[2] - shape.height(e.norm());
+    };
+    float best = golden_max((float) t0, (float) t1, height_at);
+    z = max(z, height_at(best));
+}
+
+// the flat bottom touches the edge wherever it's under the tool, so the
+// highest of those points is at one end of that part
+template <>
+inline void drop_edge<flatcutter>(
+        const flatcutter &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, float &z) {
+    double t0, t1;
+    if (!edge_chord(p, q, c, shape.r, t0, t1)) {
+        return;
+    }
+    double dz = q[2] - p[2];
+    z = max(z, (float) (p[2] + max(t0 * dz, t1 * dz)));
+}
+
+// finds where a ball of radius r, lowered onto the line through p and q,
+// touches it, as a fraction t of the way from p to q, and the height of the
+// ball's bottom there. the ball's center is r away from the line; solve for
+// its height above p, then the contact is the closest point on the line to the
+// center. returns false if the ball misses the line, or if it's vertical.
+bool ball_contact(
+        const Vector3f &p, const Vector3f &q, const Vector2f &c,
+        const float r, double &t, double &bottom) {
+    Vector3d d = (q - p).cast<double>();
+    double len = d.norm();
+    if (len == 0) {
+        return false;
+    }
+    Vector3d u = d / len;
+    double horiz = 1 - u[2] * u[2];
+    if (horiz <= 0) {
+        return false;
+    }
+    double wx = c[0] - p[0], wy = c[1] - p[1];
+    double along = wx * u[0] + wy * u[1];
+    double qb = -2 * along * u[2];
+    double qc = wx * wx + wy * wy - along * along - (double) r * r;
+    double qdisc = qb * qb - 4 * horiz * qc;
+    if (qdisc < 0) {
+        return false;
+    }
+    double s = (-qb + sqrt(qdisc)) / (2 * horiz);
+    t = (along + s * u[2]) / len;
+    bottom = p[2] + s - r;
+    return true;
+}
+
+// finds where a cone whose radius grows by slope per unit of height, lowered
+// onto the line through p and q, touches it, as a fraction t of the way from p
+// to q. that's where the rise of the line and of the cone's side over the
+// distance from the axis balance out; squaring that gives a quadratic in the
+// distance along the line. returns false if the line is steeper than the
+// cone's side, in which case the contact is as far up the line as the tool
+// reaches.
+bool cone_contact(
+        const Vector3f &p, const Vector3f &q, const Vector2f &c,
+        const float slope, double &t) {
+    Vector2d e(p[0] - c[0], p[1] - c[1]);
+    Vector2d u(q[0] - p[0], q[1] - p[1]);
+    double a = u.squaredNorm(), b = e.dot(u);
+    double k = (double) slope * (q[2] - p[2]);
+    if (a <= k * k) {
+        return false;
+    }
+    // a times the squared distance from c to the line
+    double m = max(0., a * e.squaredNorm() - b * b);
+    t = (k * sqrt(m / (a - k * k)) - b) / a;
+    return true;
+}
+
+// raises z to the contact height at the fraction t along the edge, clamped to
+// the part of it that's under the tool
+template <typename S>
+inline void drop_edge_at(
+        const S &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, const double t0, const double t1, double t,
+        float &z) {
+    t = min(t1, max(t0, t));
+    Vector2f e(p[0] + t * (q[0] - p[0]) - c[0],
+            p[1] + t * (q[1] - p[1]) - c[1]);
+    z = max(z, (float) (p[2] + t * (q[2] - p[2])) - shape.height(e.norm()));
+}
+
+template <>
+inline void drop_edge<ballcutter>(
+        const ballcutter &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, float &z) {
+    double t, bottom;
+    if (ball_contact(p, q, c, shape.r, t, bottom) && t >= 0 && t <= 1) {
+        z = max(z, (float) bottom);
+    }
+}
+
+// the contact height along the edge is concave, and in each part of the
+// tool's profile it peaks where that part alone touches the line. so the
+// highest contact is at one of those points, where the parts meet, or at the
+// ends of the part of the edge under the tool.
+template <>
+inline void drop_edge<vcutter>(
+        const vcutter &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, float &z) {
+    double t0, t1;
+    if (!edge_chord(p, q, c, shape.r, t0, t1)) {
+        return;
+    }
+    drop_edge_at(shape, p, q, c, t0, t1, t0, z);
+    drop_edge_at(shape, p, q, c, t0, t1, t1, z);
+    double t, f0, f1;
+    if (cone_contact(p, q, c, shape.slope, t)) {
+        drop_edge_at(shape, p, q, c, t0, t1, t, z);
+    }
+    if (shape.tip_r > 0 && edge_chord(p, q, c, shape.tip_r, f0, f1)) {
+        drop_edge_at(shape, p, q, c, t0, t1, f0, z);
+        drop_edge_at(shape, p, q, c, t0, t1, f1, z);
+    }
+}
+
+template <>
+inline void drop_edge<taperedcutter>(
+        const taperedcutter &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c, float &z) {
+    double t0, t1;
+    if (!edge_chord(p, q, c, shape.r, t0, t1)) {
+        return;
+    }
+    drop_edge_at(shape, p, q, c, t0, t1, t0, z);
+    drop_edge_at(shape, p, q, c, t0, t1, t1, z);
+    double t, bottom, j0, j1;
+    if (ball_contact(p, q, c, shape.tip_r, t, bottom)) {
+        drop_edge_at(shape, p, q, c, t0, t1, t, z);
+    }
+    if (cone_contact(p, q, c, shape.slope, t)) {
+        drop_edge_at(shape, p, q, c, t0, t1, t, z);
+    }
+    if (edge_chord(p, q, c, shape.join_d, j0, j1)) {
+        drop_edge_at(shape, p, q, c, t0, t1, j0, z);
+        drop_edge_at(shape, p, q, c, t0, t1, j1, z);
+    }
+}
+
+template <typename S>
+float drop_triangle(const S &shape, const triangle &t, const Vector2f &c) {
+    float z = -INFINITY;
+    for (int i = 0; i < 3; i++) {
+        drop_vertex(shape, t.v[i], c, z);
+    }
+    for (int i = 0; i < 3; i++) {
+        drop_edge(shape, t.v[i], t.v[(i + 1) % 3], c, z);
+    }
+    drop_facet(shape, t, c, z);
+    return z;
+}
+
+template <typename S>
+bool push_triangle(
+        const S &shape, const triangle &t, const int axis, const float at,
+        const float z, float &lo, float &hi) {
+    // the tool is round, so a fiber along y is the same as one along x with
+    // the triangle mirrored across the diagonal
+    triangle tri = t;
+    if (axis == 1) {
+        for (int i = 0; i < 3; i++) {
+            std::swap(tri.v[i][0], tri.v[i][1]);
+        }
+    }
+
+    float min_z = INFINITY, max_z = -INFINITY;
+    for (int i = 0; i < 3; i++) {
+        min_z = min(min_z, tri.v[i][2]);
+        max_z = max(max_z, tri.v[i][2]);
+    }
+    if (max_z < z) {
+        return false;
+    }
+
+    // positions where the tool's footprint overlaps the triangle at all
+    lo = INFINITY;
+    hi = -INFINITY;
+    for (int i = 0; i < 3; i++) {
+        const Vector3f &a = tri.v[i], &b = tri.v[(i + 1) % 3];
+        span s;
+        if (capsule_span(Vector2f(a[0], a[1]), Vector2f(b[0], b[1]), at,
+                    shape.r, s)) {
+            lo = min(lo, s.lo);
+            hi = max(hi, s.hi);
+        }
+    }
+    if (lo >= hi) {
+        return false;
+    }
+    if (min_z - shape.top() >= z) {
+        // every part of the triangle under the tool is above its bottom
+        return true;
+    }
+
+    // the drop height along the fiber is concave, so the positions where it's
+    // above z form an interval around its peak
+    auto height_at = [&](float x) {
+        return drop_triangle(shape, tri, Vector2f(x, at));
+    };
+    float peak = golden_max(lo, hi, height_at);
+    if (height_at(peak) < z) {
+        return false;
+    }
+    float out = lo, in = peak;
+    if (height_at(out) < z) {
+        for (int i = 0; i < SEARCH_ITERATIONS; i++) {
+            float mid = (out + in) / 2;
+            (height_at(mid) < z ? out : in) = mid;
+        }
+        lo = out;
+    }
+    out = hi;
+    in = peak;
+    if (height_at(out) < z) {
+        for (int i = 0; i < SEARCH_ITERATIONS; i++) {
+            float mid = (out + in) / 2;
+            (height_at(mid) < z ? out : in) = mid;
+        }
+        hi = out;
+    }
+    return true;
+}
+
+// the lowest the tool gets over c is how high the segment would come up to
+// meet a tool of the same shape hanging upside down over c, so it's the same
+// as dropping onto the segment mirrored in z
+template <typename S>
+float sweep_segment(
+        const S &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c) {
+    Vector3f mp(p[0], p[1], -p[2]), mq(q[0], q[1], -q[2]);
+    float z = -INFINITY;
+    drop_vertex(shape, mp, c, z);
+    drop_vertex(shape, mq, c, z);
+    drop_edge(shape, mp, mq, c, z);
+    return -z;
+}
+
+// every shape's tests are compiled here, with its profile inlined into them
+#define INSTANTIATE_CUTTER(S) \
+    template float drop_triangle<S>( \
+            const S &shape, const triangle &t, const Vector2f &c); \
+    template bool push_triangle<S>( \
+            const S &shape, const triangle &t, const int axis, \
+            const float at, const float z, float &lo, float &hi); \
+    template float sweep_segment<S>( \
+            const S &shape, const Vector3f &p, const Vector3f &q, \
+            const Vector2f &c);
+
+INSTANTIATE_CUTTER(flatcutter)
+INSTANTIATE_CUTTER(ballcutter)
+INSTANTIATE_CUTTER(bullcutter)
+INSTANTIATE_CUTTER(vcutter)
+INSTANTIATE_CUTTER(taperedcutter)
@@ -0,0 +1,194 @@
+#ifndef __TP_CUTTER_H__
+#define __TP_CUTTER_H__
+
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Dense>
+
+#include "bvh.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// the shapes of tool, and contact tests between them and single triangles of
+// the mesh. every tool is round, convex and has an unlimited shank above its
+// cutting part. positions are given by the tool's tip: the center of the
+// bottom of the tool.
+//
+// each shape is its own class, and the contact tests are templates over them,
+// so that every shape gets its own copy of the tests with its profile inlined
+// into them. operations pick the shape once, with a switch on td.shape, and
+// run their inner loops on the specialised tests. every shape provides:
+//
+//   r: the radius of the tool's footprint.
+//   height(d): how far the bottom of the tool is above its tip at distance d
+//     from the axis, for d <= r.
+//   top(): height(r), the highest point of the cutting part.
+//   radius_at(h): the radius of the tool at height h above its tip.
+//   facet_contact(s, c, rho, h): where the tool touches a plane whose normal
+//     is tilted from the z-axis by an angle with sine s and cosine c. the
+//     contact is rho from the axis, on the uphill side, and h above the tip.
+
+// a flat end mill
+class flatcutter {
+    public:
+        flatcutter(const tooldef &td) : r(td.r) {}
+        float r;
+
+        float height(const float) const { return 0; }
+        float top() const { return 0; }
+        float radius_at(const float) const { return r; }
+        void facet_contact(
+                const float s, const float, float &rho, float &h) const {
+            rho = s > 0 ? r : 0;
+            h = 0;
+        }
+};
+
+// a ball end mill
+class ballcutter {
+    public:
+        ballcutter(const tooldef &td) : r(td.r) {}
+        float r;
+
+        float height(const float d) const {
+            return r - sqrt(std::max(0.f, r * r - d * d));
+        }
+        float top() const { return r; }
+        float radius_at(const float h) const {
+            return h >= r ? r : sqrt(h * (2 * r - h));
+        }
+        void facet_contact(
+                const float s, const float c, float &rho, float &h) const {
+            rho = r * s;
+            h = r * (1 - c);
+        }
+};
+
+// a bull nose: a flat end mill with its bottom edge rounded off with radius
+// corner_r
+class bullcutter {
+    public:
+        bullcutter(const tooldef &td)
+            : r(td.r), corner_r(td.corner_r), flat(td.r - td.corner_r) {}
+        float r, corner_r;
+        // radius of the flat part of the bottom
+        float flat;
+
+        float height(const float d) const {
+            if (d <= flat) {
+                return 0;
+            }
+            float k = d - flat;
+            return corner_r - sqrt(std::max(0.f, corner_r * corner_r - k * k));
+        }
+        float top() const { return corner_r; }
+        float radius_at(const float h) const {
+            if (h >= corner_r) {
+                return r;
+            }
+            return flat + sqrt(h * (2 * corner_r - h));
+        }
+        void facet_contact(
+                const float s, const float c, float &rho, float &h) const {
+            rho = s > 0 ? flat + corner_r * s : 0;
+            h = corner_r * (1 - c);
+        }
+};
+
+// a V-bit: a cone with its sides at angle to the axis, cut off at radius r. a
+// flat at the tip of radius tip_r makes it a chamfer mill.
+class vcutter {
+    public:
+        vcutter(const tooldef &td)
+            : r(td.r), tip_r(td.tip_r), sin_a(sin(td.angle)),
+            cos_a(cos(td.angle)), slope(tan(td.angle)) {}
+        float r, tip_r, sin_a, cos_a;
+        // how much the radius grows per unit of height
+        float slope;
+
+        float height(const float d) const {
+            return d <= tip_r ? 0 : (d - tip_r) / slope;
+        }
+        float top() const { return height(r); }
+        float radius_at(const float h) const {
+            return std::min(r, tip_r + h * slope);
+        }
+        void facet_contact(
+                const float s, const float c, float &rho, float &h) const {
+            // planes shallower than the sides touch the tip, steeper ones the
+            // rim at the top of the cone
+            if (s * sin_a <= c * cos_a) {
+                rho = s > 0 ? tip_r : 0;
+                h = 0;
+            } else {
+                rho = r;
+                h = top();
+            }
+        }
+};
+
+// a tapered ball end mill: a ball of radius tip_r at the tip of a cone with
+// its sides at angle to the axis, tangent to the ball, cut off at radius r
+class taperedcutter {
+    public:
+        taperedcutter(const tooldef &td)
+            : r(td.r), tip_r(td.tip_r), sin_a(sin(td.angle)),
+            cos_a(cos(td.angle)), slope(tan(td.angle)),
+            join_d(td.tip_r * cos(td.angle)),
+            join_h(td.tip_r * (1 - sin(td.angle))) {}
+        float r, tip_r, sin_a, cos_a, slope;
+        // where the ball meets the cone
+        float join_d, join_h;
+
+        float height(const float d) const {
+            if (d <= join_d) {
+                return tip_r - sqrt(std::max(0.f, tip_r * tip_r - d * d));
+            }
+            return join_h + (d - join_d) / slope;
+        }
+        float top() const { return height(r); }
+        float radius_at(const float h) const {
+            if (h <= join_h) {
+                return std::min(r, (float) sqrt(h * (2 * tip_r - h)));
+            }
+            return std::min(r, join_d + (h - join_h) * slope);
+        }
+        void facet_contact(
+                const float s, const float c, float &rho, float &h) const {
+            if (s * sin_a <= c * cos_a) {
+                rho = tip_r * s;
+                h = tip_r * (1 - c);
+            } else {
+                rho = r;
+                h = top();
+            }
+        }
+};
+
+// drop-cutter: the highest tip height at which the tool, centered on c in the
+// xy-plane, touches the triangle. this is where a tool lowered onto the
+// triangle from above comes to rest. returns -INFINITY if the tool's
+// footprint doesn't overlap the triangle at all.
+template <typename S>
+float drop_triangle(const S &shape, const triangle &t, const Vector2f &c);
+
+// push-cutter: finds the interval [lo, hi] of positions along a fiber at
+// which the tool, with its tip at height z, cuts into the triangle. the fiber
+// runs along the x-axis at y = at if axis is 0, and along the y-axis at x = at
+// if axis is 1. returns false if the tool can pass the triangle anywhere on
+// the fiber.
+template <typename S>
+bool push_triangle(
+        const S &shape, const triangle &t, const int axis, const float at,
+        const float z, float &lo, float &hi);
+
+// swept-cutter: the lowest height the bottom of the tool reaches above c
+// while its tip moves in a straight line from p to q. returns INFINITY if the
+// tool never passes over c.
+template <typename S>
+float sweep_segment(
+        const S &shape, const Vector3f &p, const Vector3f &q,
+        const Vector2f &c);
+
+#endif
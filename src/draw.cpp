@@ -135,12 +135,21 @@ void on_draw() {
                 draw_mesh(global_mesh, opts);
             } else {
                 levelset ls = levelsets[layer];
-                if (ls.perimeters.size() > 0) {
-                    draw_perimeters(ls.verteces, ls.perimeters, opts);
-                } else if (ls.lines.size() > 0) {
-                    draw_linesegs(ls.lines, opts);
+                if (ls.perimeter_count() > 0) {
+                    vector<Vector3f> verteces;
+                    for (uint32_t v = 0; v < ls.vertex_count(); v++) {
+                        verteces.push_back(ls.vertex(v));
+                    }
+                    vector<vector<uint32_t>> perimeters;
+                    for (size_t p = 0; p < ls.perimeter_count(); p++) {
+                        layerlist<uint32_t> perim = ls.perimeter(p);
+                        perimeters.push_back(
+                                vector<uint32_t>(perim.begin(), perim.end()));
+                    }
+                    draw_perimeters(verteces, perimeters, opts);
                 } else {
-                    draw_faces(ls.faces, opts);
+                    draw_faces(vector<face*>(ls.faces.begin(), ls.faces.end()),
+                            opts);
                     draw_xy_plane(ls.z, mesh_bounds, opts);
                 }
             }
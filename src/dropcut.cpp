@@ -0,0 +1,225 @@
+#include "dropcut.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cutter.h"
+#include "parallel.h"
+#include "simplify.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// how many times a segment of a finishing pass is halved looking for where
+// the surface under it rises
+#define DROP_REFINE_DEPTH (16)
+// how many equal parts a move is split into to check the tool's height at
+// the points between them
+#define DROP_REFINE_CHECKS (8)
+
+// a triangle that might be under the tool somewhere along a line
+struct candidate {
+    float min_x, max_x, max_z;
+    const triangle *t;
+};
+
+template <typename S>
+void drop_line_with(
+        const bvh &tree, const S &shape, const float y, const float x0,
+        const float step, const size_t count, const float floor_z,
+        vector<float> &z) {
+    z.assign(count, floor_z);
+    if (count == 0) {
+        return;
+    }
+    float x1 = x0 + (count - 1) * step;
+    float r = shape.r;
+
+    vector<candidate> candidates;
+    tree.query(
+            Vector3f(x0 - r, y - r, -INFINITY),
+            Vector3f(x1 + r, y + r, INFINITY),
+            [&](const triangle &t) {
+        candidate c;
+        c.min_x = min(t.v[0][0], min(t.v[1][0], t.v[2][0]));
+        c.max_x = max(t.v[0][0], max(t.v[1][0], t.v[2][0]));
+        c.max_z = max(t.v[0][2], max(t.v[1][2], t.v[2][2]));
+        c.t = &t;
+        candidates.push_back(c);
+    });
+    std::sort(candidates.begin(), candidates.end(),
+            [](const candidate &a, const candidate &b) {
+        return a.min_x < b.min_x;
+    });
+
+    // the triangles whose x-range overlaps the current footprint. triangles
+    // join once the footprint reaches their smallest x and leave once it's
+    // past their largest.
+    vector<candidate> active;
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        float x = x0 + i * step;
+        while (next < candidates.size() && candidates[next].min_x <= x + r) {
+            active.push_back(candidates[next++]);
+        }
+        size_t kept = 0;
+        for (size_t k = 0; k < active.size(); k++) {
+            if (active[k].max_x >= x - r) {
+                active[kept++] = active[k];
+            }
+        }
+        active.resize(kept);
+
+        // a triangle can't lift the tool above its highest point, so the
+        // ones that are lower than the height so far can be skipped
+        float best = floor_z;
+        Vector2f c(x, y);
+        for (auto a = active.begin(); a != active.end(); a++) {
+            if (a->max_z > best) {
+                best = max(best, drop_triangle(shape, *a->t, c));
+            }
+        }
+        z[i] = best;
+    }
+}
+
+void drop_line(
+        const bvh &tree, const tooldef &td, const float y, const float x0,
+        const float step, const size_t count, const float floor_z,
+        vector<float> &z) {
+    switch (td.shape) {
+        case TOOL_BALL:
+            drop_line_with(
+                    tree, ballcutter(td), y, x0, step, count, floor_z, z);
+            break;
+        case TOOL_BULL:
+            drop_line_with(
+                    tree, bullcutter(td), y, x0, step, count, floor_z, z);
+            break;
+        case TOOL_VBIT:
+            drop_line_with(tree, vcutter(td), y, x0, step, count, floor_z, z);
+            break;
+        case TOOL_TAPERED_BALL:
+            drop_line_with(
+                    tree, taperedcutter(td), y, x0, step, count, floor_z, z);
+            break;
+        default:
+            drop_line_with(
+                    tree, flatcutter(td), y, x0, step, count, floor_z, z);
+            break;
+    }
+}
+
+// the height the tool comes to rest at when dropped at x on the line at y
+float drop_at(
+        const bvh &tree, const tooldef &td, const float x, const float y,
+        const float floor_z) {
+    vector<float> z;
+    drop_line(tree, td, y, x, 0, 1, floor_z, z);
+    return z[0];
+}
+
+// adds the points needed between a and b on a pass so that the tool, dropped
+// at DROP_REFINE_CHECKS points along any of its moves, lands within tolerance
+// of it. a move the surface strays from either way is split in half, since a
+// surface that falls away below one part of a move can still rise above it
+// further along, and checking more than the middle catches the steps of a
+// terraced surface that a straight move only meets in the middle. a rise too
+// steep to pin down within depth halvings is climbed straight up before
+// moving across, and a drop only taken once past it.
+void refine_drop(
+        const bvh &tree, const tooldef &td, const Vector3f &a,
+        const Vector3f &b, const float floor_z, const float tolerance,
+        const int depth, vector<Vector3f> &out) {
+    bool straight = true;
+    float mid_z = 0, top = max(a[2], b[2]);
+    for (int q = 1; q < DROP_REFINE_CHECKS; q++) {
+        float t = (float) q / DROP_REFINE_CHECKS;
+        float z = drop_at(
+                tree, td, a[0] + (b[0] - a[0]) * t, a[1], floor_z);
+        straight = straight
+            && fabs(z - (a[2] + (b[2] - a[2]) * t)) <= tolerance;
+        if (2 * q == DROP_REFINE_CHECKS) {
+            mid_z = z;
+        }
+        top = max(top, z);
+    }
+    if (straight) {
+        return;
+    }
+    Vector3f mid((a[0] + b[0]) / 2, a[1], mid_z);
+    if (depth == 0) {
+        if (a[2] < top) {
+            out.push_back(Vector3f(a[0], a[1], top));
+        }
+        if (b[2] < top) {
+            out.push_back(Vector3f(b[0], b[1], top));
+        }
+        return;
+    }
+    refine_drop(tree, td, a, mid, floor_z, tolerance, depth - 1, out);
+    out.push_back(mid);
+    refine_drop(tree, td, mid, b, floor_z, tolerance, depth - 1, out);
+}
+
+path drop_finish(const mesh &m, const tooldef td) {
+    path p;
+    bvh tree(m);
+    bounds b = m.get_bounds();
+    if (tree.triangles.empty()) {
+        return p;
+    }
+
+    // samples along each line are spaced like the waterline fibers, close
+    // enough that the tool's path over a sharp edge, an arc of radius r, is
+    // followed to within tolerance
+    float step = min(td.r, (float) sqrt(8 * td.r * td.tolerance));
+    float margin = td.r + step;
+    float x0 = b.min_x - margin, y0 = b.min_y - margin;
+    size_t count = (size_t) ceil((b.max_x + margin - x0) / step) + 1;
+    float line_step = td.stepover * 2 * td.r;
+    size_t lines = (size_t) ceil((b.max_y + margin - y0) / line_step) + 1;
+
+    vector<vector<Vector3f>> passes(lines);
+    parallel_for(lines, [&](size_t l) {
+        float y = y0 + l * line_step;
+        vector<float> z;
+        drop_line(tree, td, y, x0, step, count, b.min_z, z);
+
+        // simplify in the plane of the line, then make sure the straight
+        // moves left don't cut into anything between the samples. each gets
+        // half the tolerance, so together they stay within it.
+        vector<float> xs(count);
+        for (size_t i = 0; i < count; i++) {
+            xs[i] = x0 + i * step;
+        }
+        vector<bool> keep;
+        douglas_peucker(xs, z, td.tolerance / 2, keep);
+        for (size_t i = 0; i < count; i++) {
+            if (!keep[i]) {
+                continue;
+            }
+            Vector3f pt(xs[i], y, z[i]);
+            if (!passes[l].empty()) {
+                Vector3f last = passes[l].back();
+                refine_drop(
+                        tree, td, last, pt, b.min_z, td.tolerance / 2,
+                        DROP_REFINE_DEPTH, passes[l]);
+            }
+            passes[l].push_back(pt);
+        }
+        if (l % 2 == 1) {
+            std::reverse(passes[l].begin(), passes[l].end());
+        }
+    });
+
+    // every line starts and ends beyond the mesh, where the tool is down at
+    // the floor and nothing is in the way, so they link up directly
+    vector<Vector3f> zigzag;
+    for (auto pass = passes.begin(); pass != passes.end(); pass++) {
+        zigzag.insert(zigzag.end(), pass->begin(), pass->end());
+    }
+    append_polyline(p, zigzag, b.max_z + td.z_accuracy);
+    return p;
+}
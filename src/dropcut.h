@@ -0,0 +1,39 @@
+#ifndef __TP_DROPCUT_H__
+#define __TP_DROPCUT_H__
+
+#include <vector>
+#include <meshparse/mesh.h>
+
+#include "bvh.h"
+#include "path.h"
+#include "tooldef.h"
+
+using namespace meshparse;
+
+// drops the tool onto the mesh at count points along the line at height y,
+// starting at x0 and spaced step apart, and stores the height of the tool's
+// tip at each of them in z. points where the tool doesn't touch the mesh at
+// all are set to floor_z.
+//
+// the bvh is only queried once for the whole line. its triangles are swept
+// in order of their smallest x, so each point only tests the triangles its
+// footprint overlaps, and skips those that are too low to lift the tool any
+// higher than it already is.
+void drop_line(
+        const bvh &tree, const tooldef &td, const float y, const float x0,
+        const float step, const size_t count, const float floor_z,
+        std::vector<float> &z);
+
+// finishes the surface of the mesh with parallel passes along x, spaced by
+// the stepover, following the heights the tool comes to rest at when dropped
+// onto the mesh. passes extend past the mesh by the tool radius on both
+// sides and are linked into a single zigzag, simplified to within
+// td.tolerance in the plane of each pass. the tool is dropped at
+// DROP_REFINE_CHECKS points along every move between samples, and a move it
+// doesn't land within half of td.tolerance of at all of them is split in
+// half, up to DROP_REFINE_DEPTH times, and raised to the highest of them
+// where it can't be split any further, so passes don't cut through steep
+// walls between samples. lines are computed in parallel.
+path drop_finish(const mesh &m, const tooldef td);
+
+#endif
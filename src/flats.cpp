@@ -0,0 +1,124 @@
+#include "flats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+
+using std::max;
+using std::min;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+
+// the hash key of the areas at height bucket and facing up or down
+int64_t flat_key(const int64_t bucket, const bool up) {
+    return (bucket << 1) | (up ? 1 : 0);
+}
+
+void find_flat_areas(
+        const halfedges &m, const float tolerance, vector<flatarea> &out) {
+    out.clear();
+    unordered_map<int64_t, vector<size_t>> areas;
+    // the height of the first face of every area, which every other face of
+    // it is within tolerance of
+    vector<float> first_z;
+    // the area every face is in, or SIZE_MAX for none
+    vector<size_t> area_of(m.face_count(), SIZE_MAX);
+    float min_normal_z = cos(FLAT_MAX_TILT);
+    for (uint32_t f = 0; f < m.face_count(); f++) {
+        float min_z = INFINITY, max_z = -INFINITY;
+        uint32_t e = 3 * f;
+        do {
+            uint32_t a = m.vert[e];
+            min_z = min(min_z, m.z[a]);
+            max_z = max(max_z, m.z[a]);
+            e = m.next[e];
+        } while (e != 3 * f);
+        Vector3f a = m.position(m.vert[e]),
+                 b = m.position(m.vert[m.next[e]]),
+                 c = m.position(m.vert[m.next[m.next[e]]]);
+        Vector3f normal = (b - a).cross(c - a);
+        float len = normal.norm();
+        if (max_z - min_z > tolerance || len == 0
+                || fabs(normal[2]) < min_normal_z * len) {
+            continue;
+        }
+
+        bool up = normal[2] > 0;
+        float z = up ? max_z : min_z;
+        int64_t bucket = (int64_t) floor(z / tolerance);
+        size_t index = SIZE_MAX;
+        float closest = INFINITY;
+        for (int64_t near = bucket - 1; near <= bucket + 1; near++) {
+            auto found = areas.find(flat_key(near, up));
+            if (found == areas.end()) {
+                continue;
+            }
+            for (auto i = found->second.begin();
+                    i != found->second.end(); i++) {
+                float d = fabs(first_z[*i] - z);
+                if (d <= tolerance && d < closest) {
+                    index = *i;
+                    closest = d;
+                }
+            }
+        }
+        if (index == SIZE_MAX) {
+            index = out.size();
+            areas[flat_key(bucket, up)].push_back(index);
+            first_z.push_back(z);
+            out.push_back(flatarea());
+            out.back().z = z;
+            out.back().up = up;
+        } else {
+            flatarea &area = out[index];
+            area.z = up ? max(area.z, z) : min(area.z, z);
+        }
+        out[index].faces.push_back(f);
+        area_of[f] = index;
+    }
+
+    for (size_t i = 0; i < out.size(); i++) {
+        flatarea &area = out[i];
+        auto outside = [&](const uint32_t e) {
+            return m.twin[e] == NO_EDGE || area_of[m.face_of[m.twin[e]]] != i;
+        };
+
+        unordered_set<uint32_t> outline;
+        for (auto f = area.faces.begin(); f != area.faces.end(); f++) {
+            uint32_t e = 3 * *f;
+            do {
+                if (outside(e)) {
+                    outline.insert(e);
+                }
+                e = m.next[e];
+            } while (e != 3 * *f);
+        }
+
+        vector<polygon> loops;
+        while (!outline.empty()) {
+            polygon loop;
+            uint32_t e = *outline.begin();
+            while (outline.erase(e) > 0) {
+                loop.push_back(Vector2f(m.x[m.vert[e]], m.y[m.vert[e]]));
+                // the outline carries on from the end of e along the first
+                // outline half-edge turning around that vertex through the
+                // area's faces, which stays on e's side of a vertex the area
+                // only touches itself at
+                e = m.next[e];
+                while (!outside(e)) {
+                    e = m.next[m.twin[e]];
+                }
+            }
+            if (loop.size() >= 3) {
+                loops.push_back(loop);
+            }
+        }
+        find_regions(loops, area.regions);
+    }
+
+    std::sort(out.begin(), out.end(),
+            [](const flatarea &a, const flatarea &b) { return a.z < b.z; });
+}
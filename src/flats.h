@@ -0,0 +1,46 @@
+#ifndef __TP_FLATS_H__
+#define __TP_FLATS_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "halfedge.h"
+#include "polygon.h"
+
+// faces tilted further than this from horizontal, in radians, aren't flat,
+// however small they are
+#define FLAT_MAX_TILT (M_PI / 180)
+
+// a horizontal area of the mesh: faces that all lie flat at the same height
+// and face the same way.
+class flatarea {
+    public:
+        // height of the area. for areas that are only flat to within the
+        // tolerance, this is the highest point of a floor and the lowest point
+        // of a ceiling.
+        float z;
+        // true for floors, which face up, and false for ceilings
+        bool up;
+        // the faces of the mesh's halfedges making up the area
+        std::vector<uint32_t> faces;
+        // the area's outline, grouped into regions. faces at the same height
+        // that don't touch end up in separate regions.
+        std::vector<region> regions;
+};
+
+// finds every horizontal area of the mesh in a single pass over its faces. a
+// face counts as horizontal if its normal is within FLAT_MAX_TILT of straight
+// up or down and its verteces are all within tolerance of each other in z.
+// faces are grouped by which way their normal points and their height,
+// quantised to the tolerance, with a hash table keyed on both; a face joins
+// an area in its own bucket or either neighbouring one if the area's first
+// face is within tolerance of it, so floors either side of a bucket boundary
+// aren't split. the outline of each area is made of the half-edges of its
+// faces whose twin isn't in the same area, chained by walking around the
+// vertex at the end of each, so areas touching at a single vertex come out as
+// separate loops. areas are sorted from the bottom up.
+void find_flat_areas(
+        const halfedges &m, const float tolerance,
+        std::vector<flatarea> &out);
+
+#endif
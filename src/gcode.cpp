@@ -0,0 +1,42 @@
+#include "gcode.h"
+
+#include <iomanip>
+
+using std::endl;
+using std::ostream;
+
+void write_gcode(ostream &out, const path &p, const float feed) {
+    // controllers don't take exponents, and a tenth of a micron is finer
+    // than any of them moves
+    out << std::fixed << std::setprecision(GCODE_DECIMALS);
+    // millimeters, arcs in the xy-plane, absolute coordinates
+    out << "G21 G17 G90" << endl;
+
+    Vector3f last(0, 0, 0);
+    bool fed = false;
+    for (auto m = p.moves.begin(); m != p.moves.end(); m++) {
+        if (m->type == MOVE_RAPID) {
+            out << "G0";
+        } else if (m->type == MOVE_LINEAR) {
+            out << "G1";
+        } else if (m->type == MOVE_ARC_CW) {
+            out << "G2";
+        } else {
+            out << "G3";
+        }
+        out << " X" << m->end[0] << " Y" << m->end[1] << " Z" << m->end[2];
+        if (m->type == MOVE_ARC_CW || m->type == MOVE_ARC_CCW) {
+            out << " I" << m->center[0] - last[0]
+                << " J" << m->center[1] - last[1];
+        }
+        if (m->type != MOVE_RAPID && !fed) {
+            // the feed rate is modal, so once is enough
+            out << " F" << feed;
+            fed = true;
+        }
+        out << endl;
+        last = m->end;
+    }
+
+    out << "M2" << endl;
+}
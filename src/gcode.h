@@ -0,0 +1,17 @@
+#ifndef __TP_GCODE_H__
+#define __TP_GCODE_H__
+
+#include <ostream>
+
+#include "path.h"
+
+// digits written after the decimal point
+#define GCODE_DECIMALS (4)
+
+// writes the moves of the path out as a G-code program in millimeters.
+// rapids become G0, linear moves G1 and arcs G2/G3 with the center given
+// relative to the arc's start. the first cutting move sets the feed rate, in
+// millimeters per minute.
+void write_gcode(std::ostream &out, const path &p, const float feed);
+
+#endif
@@ -0,0 +1,129 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+using std::vector;
+
+cellgrid::cellgrid(
+        const region &reg, const float cell, const uint32_t max_cells) {
+    Vector2f lo(0, 0), hi(0, 0);
+    if (!reg.outer.empty()) {
+        lo = hi = reg.outer[0];
+    }
+    for (auto p = reg.outer.begin(); p != reg.outer.end(); p++) {
+        lo = lo.cwiseMin(*p);
+        hi = hi.cwiseMax(*p);
+    }
+    float extent = max(hi[0] - lo[0], hi[1] - lo[1]);
+    this->cell = max(cell, extent / (max_cells - 3));
+    x0 = lo[0] - this->cell;
+    y0 = lo[1] - this->cell;
+    nx = (uint32_t) ceil((hi[0] - lo[0]) / this->cell) + 3;
+    ny = (uint32_t) ceil((hi[1] - lo[1]) / this->cell) + 3;
+}
+
+void rasterize_region(const region &reg, const cellgrid &g, bitgrid &out) {
+    vector<const polygon *> loops(1, &reg.outer);
+    for (auto h = reg.holes.begin(); h != reg.holes.end(); h++) {
+        loops.push_back(&*h);
+    }
+    vector<float> xs;
+    for (uint32_t j = 0; j < out.ny; j++) {
+        float y = g.y0 + j * g.cell;
+        xs.clear();
+        for (auto l = loops.begin(); l != loops.end(); l++) {
+            const polygon &p = **l;
+            for (size_t i = 0, k = p.size() - 1; i < p.size(); k = i++) {
+                const Vector2f &a = p[k], &b = p[i];
+                if ((a[1] > y) != (b[1] > y)) {
+                    xs.push_back(
+                            a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]));
+                }
+            }
+        }
+        std::sort(xs.begin(), xs.end());
+        for (size_t k = 0; k + 1 < xs.size(); k += 2) {
+            float first = ceil((xs[k] - g.x0) / g.cell),
+                  end = floor((xs[k + 1] - g.x0) / g.cell) + 1;
+            first = max(0.f, first);
+            end = min((float) out.nx, end);
+            for (float i = first; i < end; i++) {
+                out.set((uint32_t) i, j);
+            }
+        }
+    }
+}
+
+void distance_transform(
+        const bitgrid &sites, vector<float> &d2, vector<uint32_t> &nearest) {
+    uint32_t nx = sites.nx, ny = sites.ny;
+    vector<uint32_t> col_site((size_t) nx * ny, NO_CELL);
+    for (uint32_t i = 0; i < nx; i++) {
+        uint32_t last = NO_CELL;
+        for (uint32_t j = 0; j < ny; j++) {
+            if (sites.get(i, j)) {
+                last = j;
+            }
+            col_site[(size_t) j * nx + i] = last;
+        }
+        last = NO_CELL;
+        for (uint32_t j = ny; j-- > 0;) {
+            if (sites.get(i, j)) {
+                last = j;
+            }
+            uint32_t &s = col_site[(size_t) j * nx + i];
+            if (last != NO_CELL && (s == NO_CELL || last - j < j - s)) {
+                s = last;
+            }
+        }
+    }
+
+    d2.assign((size_t) nx * ny, INFINITY);
+    nearest.assign((size_t) nx * ny, NO_CELL);
+    vector<double> f(nx), bound(nx + 1);
+    vector<uint32_t> v(nx);
+    for (uint32_t j = 0; j < ny; j++) {
+        const uint32_t *row = &col_site[(size_t) j * nx];
+        for (uint32_t i = 0; i < nx; i++) {
+            double dj = (double) row[i] - j;
+            f[i] = row[i] == NO_CELL ? INFINITY : dj * dj;
+        }
+        // v[0..k] are the cells whose parabolas make up the envelope, and
+        // bound[k] is where the parabola of v[k] takes over
+        long k = -1;
+        for (uint32_t q = 0; q < nx; q++) {
+            if (f[q] == INFINITY) {
+                continue;
+            }
+            double s = -INFINITY;
+            while (k >= 0) {
+                double p = v[k];
+                s = ((f[q] + (double) q * q) - (f[v[k]] + p * p))
+                    / (2.0 * q - 2.0 * p);
+                if (s > bound[k]) {
+                    break;
+                }
+                k--;
+            }
+            k++;
+            v[k] = q;
+            bound[k] = k == 0 ? -INFINITY : s;
+            bound[k + 1] = INFINITY;
+        }
+        if (k < 0) {
+            continue;
+        }
+        k = 0;
+        for (uint32_t q = 0; q < nx; q++) {
+            while (bound[k + 1] < q) {
+                k++;
+            }
+            double dq = (double) q - v[k];
+            d2[(size_t) j * nx + q] = dq * dq + f[v[k]];
+            nearest[(size_t) j * nx + q] = row[v[k]] * nx + v[k];
+        }
+    }
+}
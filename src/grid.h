@@ -0,0 +1,84 @@
+#ifndef __TP_GRID_H__
+#define __TP_GRID_H__
+
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "polygon.h"
+
+using namespace Eigen;
+
+// square grids of cells over a region, for operations that work on a raster
+// of the layer rather than its polygons
+
+#define NO_CELL (UINT32_MAX)
+
+// the layout of a grid over a region: cell i, j is centered on
+// (x0 + i cell, y0 + j cell), and there's a row and column of cells beyond
+// the region's bounding box on every side
+class cellgrid {
+    public:
+        // cells of the given size, grown if the grid would otherwise have more
+        // than max_cells along either side
+        cellgrid(const region &reg, const float cell, const uint32_t max_cells);
+
+        Vector2f center(const uint32_t i, const uint32_t j) const {
+            return Vector2f(x0 + i * cell, y0 + j * cell);
+        }
+        Vector2f center(const uint32_t k) const {
+            return center(k % nx, k / nx);
+        }
+        // the cell nearest to p; false if that's off the grid
+        bool cell_at(const Vector2f &p, uint32_t &i, uint32_t &j) const {
+            float fi = round((p[0] - x0) / cell),
+                  fj = round((p[1] - y0) / cell);
+            if (fi < 0 || fj < 0 || fi >= nx || fj >= ny) {
+                return false;
+            }
+            i = (uint32_t) fi;
+            j = (uint32_t) fj;
+            return true;
+        }
+
+        float x0, y0, cell;
+        uint32_t nx, ny;
+};
+
+// one bit for every cell of a grid, row by row, 64 cells to a word
+class bitgrid {
+    public:
+        bitgrid(const uint32_t nx, const uint32_t ny)
+            : nx(nx), ny(ny), stride((nx + 63) / 64),
+            words((size_t) stride * ny, 0) {}
+
+        bool get(const uint32_t i, const uint32_t j) const {
+            return (words[(size_t) j * stride + i / 64] >> (i % 64)) & 1;
+        }
+        void set(const uint32_t i, const uint32_t j) {
+            words[(size_t) j * stride + i / 64] |= (uint64_t) 1 << (i % 64);
+        }
+        void reset(const uint32_t i, const uint32_t j) {
+            words[(size_t) j * stride + i / 64] &= ~((uint64_t) 1 << (i % 64));
+        }
+
+        uint32_t nx, ny, stride;
+        std::vector<uint64_t> words;
+};
+
+// sets the cells of out whose centers are inside the region, filling the
+// spans between crossings of every row with the region's edges
+void rasterize_region(const region &reg, const cellgrid &g, bitgrid &out);
+
+// squared distance, in cells, from every cell to the nearest set cell of
+// sites, and the index of that cell, or INFINITY and NO_CELL if there are
+// none. every column is scanned both ways for its nearest site, then every
+// row takes the lower envelope of the parabolas rising from its cells'
+// distances along their columns (Felzenszwalb and Huttenlocher), so the
+// distances are exact and the whole grid takes linear time.
+void distance_transform(
+        const bitgrid &sites, std::vector<float> &d2,
+        std::vector<uint32_t> &nearest);
+
+#endif
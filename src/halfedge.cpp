@@ -0,0 +1,230 @@
+#include "halfedge.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "parallel.h"
+#include "triangulate.h"
+
+using std::min;
+using std::unordered_map;
+using std::vector;
+
+// half-edges each thread takes on at a time while building
+#define HALFEDGE_CHUNK (1 << 14)
+// most buckets half-edges are hashed into to find their twins, which bounds
+// the table of bucket sizes at this squared
+#define HALFEDGE_MAX_BUCKETS (256)
+
+halfedges::halfedges(
+        const vector<Vector3f> &positions, const vector<uint32_t> &indices) {
+    for (auto p = positions.begin(); p != positions.end(); p++) {
+        x.push_back((*p)[0]);
+        y.push_back((*p)[1]);
+        z.push_back((*p)[2]);
+    }
+    build(indices);
+}
+
+halfedges::halfedges(const mesh &m) {
+    unordered_map<const vertex*, uint32_t> index;
+    for (auto v = m.verteces.begin(); v != m.verteces.end(); v++) {
+        index[*v] = x.size();
+        x.push_back((*v)->loc[0]);
+        y.push_back((*v)->loc[1]);
+        z.push_back((*v)->loc[2]);
+    }
+
+    vector<uint32_t> indices, ids, corners;
+    vector<Vector3f> loc;
+    for (auto f = m.faces.begin(); f != m.faces.end(); f++) {
+        ids.clear();
+        loc.clear();
+        corners.clear();
+        edge *e = (*f)->e;
+        do {
+            ids.push_back(index[e->vert]);
+            loc.push_back(e->vert->loc);
+            e = e->next;
+        } while (e != (*f)->e);
+        split_polygon(loc, corners);
+        for (auto c = corners.begin(); c != corners.end(); c++) {
+            indices.push_back(ids[*c]);
+        }
+    }
+    build(indices);
+}
+
+// hash of the edge between verteces a and b, the same whichever way it's
+// walked
+uint64_t undirected_key(const uint32_t a, const uint32_t b) {
+    uint64_t key = ((uint64_t) min(a, b) << 32) | std::max(a, b);
+    return key * 0x9e3779b97f4a7c15ull;
+}
+
+void halfedges::build(const vector<uint32_t> &indices) {
+    size_t n = indices.size() - indices.size() % 3;
+    vert.assign(indices.begin(), indices.begin() + n);
+    next.resize(n);
+    twin.assign(n, NO_EDGE);
+    face_of.resize(n);
+
+    size_t chunks = (n + HALFEDGE_CHUNK - 1) / HALFEDGE_CHUNK;
+    parallel_for(chunks, [&](size_t c) {
+        uint32_t end = min(n, (c + 1) * HALFEDGE_CHUNK);
+        for (uint32_t h = c * HALFEDGE_CHUNK; h < end; h++) {
+            next[h] = h % 3 == 2 ? h - 2 : h + 1;
+            face_of[h] = h / 3;
+        }
+    });
+
+    // the twin of a half-edge from a to b is the one from b to a. half-edges
+    // are hashed by the edge they lie on into buckets, each chunk counting
+    // how many it has for every bucket so they can all be sorted into place
+    // at once; then every bucket matches up its own half-edges on its own.
+    size_t buckets = min(chunks, (size_t) HALFEDGE_MAX_BUCKETS);
+    vector<uint32_t> bucket(n), start(chunks * buckets + 1, 0);
+    parallel_for(chunks, [&](size_t c) {
+        uint32_t end = min(n, (c + 1) * HALFEDGE_CHUNK);
+        for (uint32_t h = c * HALFEDGE_CHUNK; h < end; h++) {
+            bucket[h] = undirected_key(vert[h], vert[next[h]]) % buckets;
+            start[bucket[h] * chunks + c + 1]++;
+        }
+    });
+    for (size_t i = 1; i < start.size(); i++) {
+        start[i] += start[i - 1];
+    }
+    vector<uint32_t> sorted(n);
+    parallel_for(chunks, [&](size_t c) {
+        uint32_t end = min(n, (c + 1) * HALFEDGE_CHUNK);
+        for (uint32_t h = c * HALFEDGE_CHUNK; h < end; h++) {
+            sorted[start[bucket[h] * chunks + c]++] = h;
+        }
+    });
+    // each chunk's start has moved up to the next one's, so bucket k now
+    // starts where the last chunk ended up for bucket k - 1
+    parallel_for(buckets, [&](size_t k) {
+        uint32_t first = k == 0 ? 0 : start[k * chunks - 1],
+                 last = start[(k + 1) * chunks - 1];
+        // half-edges still waiting for a twin, keyed by their ends
+        unordered_map<uint64_t, uint32_t> waiting;
+        for (uint32_t i = first; i < last; i++) {
+            uint32_t h = sorted[i], a = vert[h], b = vert[next[h]];
+            auto found = waiting.find(((uint64_t) b << 32) | a);
+            if (found != waiting.end()) {
+                twin[h] = found->second;
+                twin[found->second] = h;
+                waiting.erase(found);
+            } else {
+                // a second half-edge the same way along an edge, where the
+                // mesh isn't manifold, is left on the boundary
+                waiting.insert(
+                        std::make_pair(((uint64_t) a << 32) | b, h));
+            }
+        }
+    });
+
+    vert_edge.assign(x.size(), NO_EDGE);
+    for (uint32_t h = 0; h < n; h++) {
+        if (vert_edge[vert[h]] == NO_EDGE || twin[h] == NO_EDGE) {
+            vert_edge[vert[h]] = h;
+        }
+    }
+}
+
+void halfedges::reorder(const int order) {
+    if (order == MESH_ORDER_FILE || face_count() == 0) {
+        return;
+    }
+    vector<uint32_t> faces;
+    for (uint32_t f = 0; f < face_count(); f++) {
+        faces.push_back(f);
+    }
+    if (order == MESH_ORDER_Z) {
+        vector<float> low(face_count());
+        for (uint32_t f = 0; f < face_count(); f++) {
+            low[f] = min(z[vert[3 * f]],
+                    min(z[vert[3 * f + 1]], z[vert[3 * f + 2]]));
+        }
+        std::stable_sort(faces.begin(), faces.end(),
+                [&](const uint32_t a, const uint32_t b) {
+                    return low[a] < low[b];
+                });
+    } else {
+        Vector3f lo = position(vert[0]), hi = lo;
+        for (uint32_t h = 0; h < edge_count(); h++) {
+            lo = lo.cwiseMin(position(vert[h]));
+            hi = hi.cwiseMax(position(vert[h]));
+        }
+        vector<uint64_t> code(face_count());
+        for (uint32_t f = 0; f < face_count(); f++) {
+            code[f] = morton_code((position(vert[3 * f])
+                        + position(vert[3 * f + 1])
+                        + position(vert[3 * f + 2])) / 3, lo, hi);
+        }
+        std::stable_sort(faces.begin(), faces.end(),
+                [&](const uint32_t a, const uint32_t b) {
+                    return code[a] < code[b];
+                });
+    }
+
+    // where every half-edge and vertex moves to. verteces no face uses go
+    // last.
+    vector<uint32_t> edge_to(edge_count()), vert_to(vertex_count(), NO_EDGE);
+    vector<uint32_t> verts;
+    for (uint32_t i = 0; i < faces.size(); i++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t h = 3 * faces[i] + k;
+            edge_to[h] = 3 * i + k;
+            if (vert_to[vert[h]] == NO_EDGE) {
+                vert_to[vert[h]] = verts.size();
+                verts.push_back(vert[h]);
+            }
+        }
+    }
+    for (uint32_t v = 0; v < vertex_count(); v++) {
+        if (vert_to[v] == NO_EDGE) {
+            vert_to[v] = verts.size();
+            verts.push_back(v);
+        }
+    }
+
+    vector<uint32_t> new_twin(edge_count()), new_vert(edge_count());
+    for (uint32_t h = 0; h < edge_count(); h++) {
+        new_twin[edge_to[h]] = twin[h] == NO_EDGE ? NO_EDGE : edge_to[twin[h]];
+        new_vert[edge_to[h]] = vert_to[vert[h]];
+    }
+    twin.swap(new_twin);
+    vert.swap(new_vert);
+
+    vector<float> new_x, new_y, new_z;
+    vector<uint32_t> new_edge;
+    for (auto v = verts.begin(); v != verts.end(); v++) {
+        new_x.push_back(x[*v]);
+        new_y.push_back(y[*v]);
+        new_z.push_back(z[*v]);
+        new_edge.push_back(
+                vert_edge[*v] == NO_EDGE ? NO_EDGE : edge_to[vert_edge[*v]]);
+    }
+    x.swap(new_x);
+    y.swap(new_y);
+    z.swap(new_z);
+    vert_edge.swap(new_edge);
+    // next and face_of only depend on where a half-edge is, so they stay
+}
+
+size_t halfedges::vertex_count() const {
+    return x.size();
+}
+
+size_t halfedges::face_count() const {
+    return next.size() / 3;
+}
+
+size_t halfedges::edge_count() const {
+    return next.size();
+}
+
+Vector3f halfedges::position(const uint32_t v) const {
+    return Vector3f(x[v], y[v], z[v]);
+}
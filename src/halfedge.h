@@ -0,0 +1,61 @@
+#ifndef __TP_HALFEDGE_H__
+#define __TP_HALFEDGE_H__
+
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+#include <meshparse/mesh.h>
+
+#include "tooldef.h"
+
+using namespace Eigen;
+using namespace meshparse;
+
+// the twin of a half-edge on the boundary of the mesh, or the edge of a vertex
+// no face uses
+#define NO_EDGE (UINT32_MAX)
+
+// a triangle mesh as half-edges, with every vertex, half-edge and face named
+// by a 32-bit index into flat arrays instead of being a separate object on
+// the heap linked by pointers. walking the topology touches a handful of
+// dense arrays, and the whole mesh takes well under half the memory of
+// meshparse's. the half-edges of face f are 3f, 3f + 1 and 3f + 2.
+class halfedges {
+    public:
+        // builds the mesh from an indexed triangle list: triangle t has
+        // corners indices[3t], indices[3t + 1] and indices[3t + 2], which are
+        // indeces into positions
+        halfedges(
+                const std::vector<Vector3f> &positions,
+                const std::vector<uint32_t> &indices);
+        // builds the mesh from meshparse's, with faces of more than three
+        // sides split into triangles by split_polygon
+        halfedges(const mesh &m);
+
+        size_t vertex_count() const;
+        size_t face_count() const;
+        size_t edge_count() const;
+        Vector3f position(const uint32_t v) const;
+
+        // renumbers the faces into one of the MESH_ORDER_ orders, by their
+        // lowest point or the Morton code of their centers, and the verteces
+        // in the order the faces first use them, so the faces and verteces
+        // near each other in space are near each other in memory too
+        void reorder(const int order);
+
+        // positions of the verteces, a coordinate at a time
+        std::vector<float> x, y, z;
+        // for every half-edge, the next one around its face, the one going
+        // the other way along the same edge (NO_EDGE on a boundary), the
+        // vertex it starts at and the face it belongs to
+        std::vector<uint32_t> next, twin, vert, face_of;
+        // one half-edge starting at every vertex, one on the boundary if
+        // there is one, so walking around the vertex from it sees every face
+        std::vector<uint32_t> vert_edge;
+
+    private:
+        // fills in everything but the positions from the triangle list
+        void build(const std::vector<uint32_t> &indices);
+};
+
+#endif
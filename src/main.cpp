@@ -1,30 +1,196 @@
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <meshparse/mesh.h>
 
+#include "adaptive.h"
 #include "draw.h"
+#include "dropcut.h"
+#include "gcode.h"
 #include "path.h"
+#include "pocket.h"
+#include "raster.h"
+#include "rough.h"
+#include "scheduler.h"
 #include "slice.h"
+#include "stock.h"
 #include "tooldef.h"
+#include "trochoid.h"
+#include "vcarve.h"
+#include "waterline.h"
 
 using namespace meshparse;
 
 using std::ifstream;
+using std::ofstream;
 using std::cout;
 using std::endl;
 using std::vector;
 
+void usage(char *name) {
+    cout << "Usage: " << name
+        << " [-p operation] [-r operation] [-t tool] [-g resolution]"
+        << " [-m order] [-j threads] [-a] [-o gcode file] [-v] [obj file]"
+        << endl;
+    cout << "operations: perimeter (default), raster, pocket, adaptive, slot, "
+        << "vcarve, rough, waterline, drop" << endl;
+    cout << "tools: flat (default), ball, bull, vbit, taper" << endl;
+    cout << "-r cuts only what the given operation, run with a tool twice the "
+        << "size, leaves behind; for raster, pocket, adaptive and rough"
+        << endl;
+    cout << "-g stores the layers' perimeters on an integer grid that many "
+        << "model units apart" << endl;
+    cout << "-m lays the mesh out in memory in file (default), z or morton "
+        << "order while working on it" << endl;
+    cout << "-j runs parallel work on that many threads (default one per "
+        << "hardware thread), and -a pins each to a core of its own" << endl;
+    cout << "-v simulates the toolpath and prints how far the result is from "
+        << "the model, without opening a window" << endl;
+}
+
+// the shapes of tool that can be picked with -t, and the names they go by
+struct toolname {
+    const char *name;
+    int shape;
+};
+
+static const toolname tools[] = {
+    { "flat", TOOL_FLAT },
+    { "ball", TOOL_BALL },
+    { "bull", TOOL_BULL },
+    { "vbit", TOOL_VBIT },
+    { "taper", TOOL_TAPERED_BALL },
+};
+
+// the orders the mesh can be kept in with -m, and their names
+struct ordername {
+    const char *name;
+    int order;
+};
+
+static const ordername orders[] = {
+    { "file", MESH_ORDER_FILE },
+    { "z", MESH_ORDER_Z },
+    { "morton", MESH_ORDER_MORTON },
+};
+
+// generates the toolpath for the named operation. rest is the stock left by
+// an earlier operation, if there was one; only the clearing operations can
+// limit themselves to it. returns false if the operation can't be run.
+bool run_operation(
+        const char *operation, const mesh &m,
+        const vector<levelset> &levelsets, const tooldef &td,
+        slicestats &stats, const zmap *rest, path &p) {
+    if (strcmp(operation, "raster") == 0) {
+        p = raster_clear(levelsets, td, rest);
+    } else if (strcmp(operation, "pocket") == 0) {
+        p = pocket_clear(levelsets, td, rest);
+    } else if (strcmp(operation, "adaptive") == 0) {
+        p = adaptive_clear(levelsets, td, rest);
+    } else if (strcmp(operation, "rough") == 0) {
+        p = rough(m, td, stats, rest);
+    } else if (rest != NULL) {
+        cout << "can't rest machine with " << operation << endl;
+        return false;
+    } else if (strcmp(operation, "perimeter") == 0) {
+        p = generate_toolpath(levelsets, td);
+    } else if (strcmp(operation, "slot") == 0) {
+        p = slot_clear(levelsets, td);
+    } else if (strcmp(operation, "vcarve") == 0) {
+        if (td.shape != TOOL_VBIT) {
+            cout << "can't V-carve without a vbit" << endl;
+            return false;
+        }
+        p = vcarve(m, levelsets, td, stats);
+    } else if (strcmp(operation, "waterline") == 0) {
+        p = waterline(m, levelsets, td);
+    } else if (strcmp(operation, "drop") == 0) {
+        p = drop_finish(m, td);
+    } else {
+        cout << "unknown operation " << operation << endl;
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " [obj file]" << endl;
+    const char *operation = "perimeter";
+    const char *gcode_file = NULL;
+    int shape = -1;
+    const char *previous = NULL;
+    bool verify = false;
+    float resolution = 0;
+    int order = -1;
+    int threads = 0;
+    bool pin = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:r:t:g:m:j:ao:v")) != -1) {
+        if (opt == 'p') {
+            operation = optarg;
+        } else if (opt == 'r') {
+            previous = optarg;
+        } else if (opt == 't') {
+            for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++) {
+                if (strcmp(optarg, tools[i].name) == 0) {
+                    shape = tools[i].shape;
+                }
+            }
+            if (shape < 0) {
+                cout << "unknown tool " << optarg << endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (opt == 'g') {
+            resolution = atof(optarg);
+            if (!(resolution > 0)) {
+                cout << "resolution has to be more than 0" << endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (opt == 'm') {
+            for (size_t i = 0; i < sizeof(orders) / sizeof(orders[0]); i++) {
+                if (strcmp(optarg, orders[i].name) == 0) {
+                    order = orders[i].order;
+                }
+            }
+            if (order < 0) {
+                cout << "unknown order " << optarg << endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (opt == 'j') {
+            threads = atoi(optarg);
+            if (threads < 1) {
+                cout << "threads have to be at least 1" << endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (opt == 'a') {
+            pin = true;
+        } else if (opt == 'o') {
+            gcode_file = optarg;
+        } else if (opt == 'v') {
+            verify = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
         return 1;
     }
+    const char *mesh_file = argv[optind];
+    scheduler::configure(threads, pin);
 
     mesh m;
-    ifstream in(argv[1]);
-    if (!load_mesh(argv[1], in, m)) {
+    ifstream in(mesh_file);
+    if (!load_mesh(mesh_file, in, m)) {
         cout << "Mesh loader couldn't read file." << endl;
         in.close();
         return 3;
@@ -32,14 +198,82 @@ int main(int argc, char *argv[]) {
     in.close();
 
     tooldef td;
+    td.shape = shape < 0 ? TOOL_FLAT : shape;
     td.r = .2;
+    td.corner_r = .05;
+    // a 90 degree V-bit, or a tapered ball with a 10 degree taper
+    td.angle = td.shape == TOOL_VBIT ? M_PI / 4 : M_PI / 18;
+    td.tip_r = td.shape == TOOL_VBIT ? 0 : .05;
     td.z_accuracy = .5;
+    td.stepdown = 2;
+    td.stock = .05;
+    td.tolerance = .01;
+    td.gap = .1;
+    td.resolution = resolution;
+    td.mesh_order = order < 0 ? MESH_ORDER_FILE : order;
+    td.stepover = .4;
+    td.feed = 500;
+    td.adaptive_time = 1;
 
     vector<levelset> levelsets;
-    slice(td, m, levelsets);
+    slicestats stats;
+    slice(td, m, levelsets, stats);
     cout << "finished slicing, got " << levelsets.size() << " levelsets" << endl;
+    cout << stats << endl;
 
-    path p = generate_toolpath(levelsets, td);
+    // columns of simulated stock, fine enough to resolve the tolerance but no
+    // more than a few thousand across
+    bounds b = m.get_bounds();
+    float step = std::max(
+            td.tolerance,
+            std::max(b.max_x - b.min_x, b.max_y - b.min_y) / 2000);
+
+    zmap stock;
+    const zmap *rest = NULL;
+    if (previous != NULL) {
+        // the earlier operation is run with a tool twice the size, and
+        // simulated to find what it left behind
+        tooldef big = td;
+        big.r *= 2;
+        big.corner_r *= 2;
+        big.tip_r *= 2;
+        path before;
+        if (!run_operation(previous, m, levelsets, big, stats, NULL, before)) {
+            usage(argv[0]);
+            return 1;
+        }
+        stock = zmap(b, big.r + step, step);
+        cut_path(before, big, stock);
+        rest = &stock;
+    }
+
+    // trouble the operation itself works around, such as rough's own layers
+    // or V-carving's medial axes
+    path p;
+    slicestats op_stats;
+    if (!run_operation(operation, m, levelsets, td, op_stats, rest, p)) {
+        usage(argv[0]);
+        return 1;
+    }
+    cout << "generated " << p.moves.size() << " moves for "
+        << p.points.size() << " points" << endl;
+    cout << op_stats.diag << endl;
+
+    if (gcode_file != NULL) {
+        ofstream gcode(gcode_file);
+        write_gcode(gcode, p, td.feed);
+        gcode.close();
+    }
+
+    if (verify) {
+        deviation d;
+        verify_path(p, m, td, step, d);
+        cout << d << endl;
+    }
+    cout << scheduler::get().stats() << endl;
+    if (verify) {
+        return 0;
+    }
 
     start_draw(argc, argv, m, levelsets, p);
 }
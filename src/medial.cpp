@@ -0,0 +1,834 @@
+#include "medial.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include "parallel.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// the boundary is rounded onto a grid this many times finer than the spacing
+// of its samples
+#define GRID_PER_SPACING (1024)
+// most grid steps across a region, so the predicates can't overflow
+#define MAX_GRID_STEPS ((int64_t) 1 << 28)
+// samples fewer than this many spacings apart don't make a branch
+#define MIN_SEPARATION (3)
+// most rounds of splitting boundary edges missing from the triangulation
+#define CONFORM_ROUNDS (8)
+
+#define NO_EDGE (UINT32_MAX)
+
+// a point on the grid
+struct ipoint {
+    int64_t x, y;
+};
+
+bool operator<(const ipoint &a, const ipoint &b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+bool operator==(const ipoint &a, const ipoint &b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+// a sample of the boundary: the segment it's on, and the segment before that
+// if it's at the corner between them, or the same segment again if it isn't
+struct sample {
+    ipoint at;
+    uint32_t seg, prev;
+};
+
+// c is to the left of the line from a to b
+bool ccw(const ipoint &a, const ipoint &b, const ipoint &c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0;
+}
+
+// d is inside the circle through a, b and c, which go round it
+// counterclockwise. with coordinates under 2^29 every term fits in 128 bits.
+bool in_circle(
+        const ipoint &a, const ipoint &b, const ipoint &c, const ipoint &d) {
+    int64_t adx = a.x - d.x, ady = a.y - d.y,
+            bdx = b.x - d.x, bdy = b.y - d.y,
+            cdx = c.x - d.x, cdy = c.y - d.y;
+    __int128 det =
+        (__int128) (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy)
+        + (__int128) (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy)
+        + (__int128) (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+    return det > 0;
+}
+
+// Guibas and Stolfi's quad-edge structure over a triangulation and its dual.
+// every edge has four records, one for each direction of it and of its dual;
+// records are numbered so the four of an edge are 4q to 4q + 3, and only the
+// records of the edge itself (4q and 4q + 2) have an origin.
+class quadedges {
+    public:
+        quadedges(const vector<ipoint> &pts) : pts(pts) {}
+
+        uint32_t rot(const uint32_t e) const {
+            return (e & ~3u) | ((e + 1) & 3);
+        }
+        uint32_t rot_inv(const uint32_t e) const {
+            return (e & ~3u) | ((e + 3) & 3);
+        }
+        uint32_t sym(const uint32_t e) const {
+            return e ^ 2;
+        }
+        uint32_t onext(const uint32_t e) const {
+            return next[e];
+        }
+        uint32_t oprev(const uint32_t e) const {
+            return rot(next[rot(e)]);
+        }
+        uint32_t lnext(const uint32_t e) const {
+            return rot(next[rot_inv(e)]);
+        }
+        uint32_t rprev(const uint32_t e) const {
+            return next[sym(e)];
+        }
+        uint32_t org(const uint32_t e) const {
+            return origin[e];
+        }
+        uint32_t dest(const uint32_t e) const {
+            return origin[sym(e)];
+        }
+
+        uint32_t make_edge(const uint32_t a, const uint32_t b) {
+            uint32_t e = (uint32_t) next.size();
+            next.push_back(e);
+            next.push_back(e + 3);
+            next.push_back(e + 2);
+            next.push_back(e + 1);
+            origin.push_back(a);
+            origin.push_back(NO_EDGE);
+            origin.push_back(b);
+            origin.push_back(NO_EDGE);
+            dead.push_back(0);
+            return e;
+        }
+        void splice(const uint32_t a, const uint32_t b) {
+            uint32_t alpha = rot(next[a]), beta = rot(next[b]);
+            std::swap(next[a], next[b]);
+            std::swap(next[alpha], next[beta]);
+        }
+        // a new edge from the end of a to the start of b, with the face to
+        // the left of both
+        uint32_t connect(const uint32_t a, const uint32_t b) {
+            uint32_t e = make_edge(dest(a), org(b));
+            splice(e, lnext(a));
+            splice(sym(e), b);
+            return e;
+        }
+        void remove(const uint32_t e) {
+            splice(e, oprev(e));
+            splice(sym(e), oprev(sym(e)));
+            dead[e / 4] = 1;
+        }
+
+        bool left_of(const uint32_t p, const uint32_t e) const {
+            return ccw(pts[p], pts[org(e)], pts[dest(e)]);
+        }
+        bool right_of(const uint32_t p, const uint32_t e) const {
+            return ccw(pts[p], pts[dest(e)], pts[org(e)]);
+        }
+
+        // delaunay triangulates the sorted, distinct points lo to hi. le is
+        // the counterclockwise hull edge out of the leftmost point and re the
+        // clockwise one out of the rightmost.
+        void triangulate(
+                const uint32_t lo, const uint32_t hi, uint32_t &le,
+                uint32_t &re);
+
+        const vector<ipoint> &pts;
+        vector<uint32_t> next, origin;
+        vector<uint8_t> dead;
+};
+
+void quadedges::triangulate(
+        const uint32_t lo, const uint32_t hi, uint32_t &le, uint32_t &re) {
+    uint32_t n = hi - lo;
+    if (n == 2) {
+        le = make_edge(lo, lo + 1);
+        re = sym(le);
+        return;
+    }
+    if (n == 3) {
+        uint32_t a = make_edge(lo, lo + 1), b = make_edge(lo + 1, lo + 2);
+        splice(sym(a), b);
+        if (ccw(pts[lo], pts[lo + 1], pts[lo + 2])) {
+            connect(b, a);
+            le = a;
+            re = sym(b);
+        } else if (ccw(pts[lo], pts[lo + 2], pts[lo + 1])) {
+            uint32_t c = connect(b, a);
+            le = sym(c);
+            re = c;
+        } else {
+            le = a;
+            re = sym(b);
+        }
+        return;
+    }
+
+    uint32_t ldo, ldi, rdi, rdo;
+    uint32_t mid = lo + n / 2;
+    triangulate(lo, mid, ldo, ldi);
+    triangulate(mid, hi, rdi, rdo);
+
+    // the lower common tangent of the two halves
+    while (true) {
+        if (left_of(org(rdi), ldi)) {
+            ldi = lnext(ldi);
+        } else if (right_of(org(ldi), rdi)) {
+            rdi = rprev(rdi);
+        } else {
+            break;
+        }
+    }
+    uint32_t basel = connect(sym(rdi), ldi);
+    if (org(ldi) == org(ldo)) {
+        ldo = sym(basel);
+    }
+    if (org(rdi) == org(rdo)) {
+        rdo = basel;
+    }
+
+    // zips the halves together from the bottom up, deleting the edges of
+    // either half whose triangles the new ones make no longer delaunay
+    auto valid = [&](const uint32_t e) {
+        return right_of(dest(e), basel);
+    };
+    while (true) {
+        uint32_t lcand = onext(sym(basel));
+        if (valid(lcand)) {
+            while (in_circle(pts[dest(basel)], pts[org(basel)],
+                        pts[dest(lcand)], pts[dest(onext(lcand))])) {
+                uint32_t t = onext(lcand);
+                remove(lcand);
+                lcand = t;
+            }
+        }
+        uint32_t rcand = oprev(basel);
+        if (valid(rcand)) {
+            while (in_circle(pts[dest(basel)], pts[org(basel)],
+                        pts[dest(rcand)], pts[dest(oprev(rcand))])) {
+                uint32_t t = oprev(rcand);
+                remove(rcand);
+                rcand = t;
+            }
+        }
+        bool lvalid = valid(lcand), rvalid = valid(rcand);
+        if (!lvalid && !rvalid) {
+            break;
+        }
+        if (!lvalid || (rvalid && in_circle(pts[dest(lcand)], pts[org(lcand)],
+                        pts[org(rcand)], pts[dest(rcand)]))) {
+            basel = connect(rcand, sym(basel));
+        } else {
+            basel = connect(sym(basel), sym(lcand));
+        }
+    }
+    le = ldo;
+    re = rdo;
+}
+
+// the edges of the region's loops in order, each loop's edges following on
+// from one another
+class boundary {
+    public:
+        vector<Vector2f> a, b;
+        vector<uint32_t> next, prev;
+
+        // the corner at the end of segment s, if the segment after it turns
+        // left there
+        bool convex_after(const uint32_t s) const {
+            Vector2f d = b[s] - a[s], e = b[next[s]] - a[next[s]];
+            return d[0] * e[1] - d[1] * e[0] > 0;
+        }
+};
+
+// a branch of the axis while it's being traced, and the triangles at its
+// ends
+struct axis_branch {
+    medial_branch br;
+    uint32_t ends[2];
+};
+
+// how far the circles along a branch reach beyond the circle at one of its
+// points
+float excess(const medial_branch &br, const size_t root) {
+    float most = 0;
+    for (size_t k = 0; k < br.points.size(); k++) {
+        most = max(most, (br.points[k] - br.points[root]).norm()
+                + br.clearance[k] - br.clearance[root]);
+    }
+    return most;
+}
+
+// joins branches end to end at every triangle where only two of them meet
+void join_branches(
+        vector<axis_branch> &branches, const vector<uint32_t> &degree) {
+    vector<std::pair<uint32_t, uint32_t>> at;
+    for (uint32_t b = 0; b < branches.size(); b++) {
+        for (int e = 0; e < 2; e++) {
+            uint32_t node = branches[b].ends[e];
+            if (!branches[b].br.points.empty() && degree[node] == 2) {
+                at.push_back(std::make_pair(node, b));
+            }
+        }
+    }
+    std::sort(at.begin(), at.end());
+    // where every branch that's been joined onto another one went
+    vector<uint32_t> into(branches.size());
+    for (uint32_t b = 0; b < into.size(); b++) {
+        into[b] = b;
+    }
+    auto find = [&](uint32_t b) {
+        while (into[b] != b) {
+            b = into[b];
+        }
+        return b;
+    };
+    for (size_t k = 0; k + 1 < at.size(); k++) {
+        if (at[k].first != at[k + 1].first) {
+            continue;
+        }
+        uint32_t node = at[k].first;
+        uint32_t a = find(at[k].second), b = find(at[k + 1].second);
+        k++;
+        if (a == b) {
+            // a loop now
+            continue;
+        }
+        axis_branch &x = branches[a], &y = branches[b];
+        if (x.ends[1] != node) {
+            std::reverse(x.br.points.begin(), x.br.points.end());
+            std::reverse(x.br.clearance.begin(), x.br.clearance.end());
+            std::swap(x.ends[0], x.ends[1]);
+        }
+        if (y.ends[0] != node) {
+            std::reverse(y.br.points.begin(), y.br.points.end());
+            std::reverse(y.br.clearance.begin(), y.br.clearance.end());
+            std::swap(y.ends[0], y.ends[1]);
+        }
+        x.br.points.insert(
+                x.br.points.end(), y.br.points.begin() + 1, y.br.points.end());
+        x.br.clearance.insert(x.br.clearance.end(),
+                y.br.clearance.begin() + 1, y.br.clearance.end());
+        x.ends[1] = y.ends[1];
+        y.br.points.clear();
+        y.br.clearance.clear();
+        into[b] = a;
+    }
+}
+
+// drops the branches out to dead ends whose circles reach less than eps
+// beyond the circle where they leave the rest of the axis: they're the
+// corners of the samples, or of a finely divided curve, not of the region.
+// what's left of an axis with nothing but such branches is its widest point.
+void prune_branches(
+        vector<axis_branch> &branches, const uint32_t nodes,
+        const float eps) {
+    // the centers of triangles with their corners on one circle are all the
+    // same point, so branches that don't go anywhere join the triangles at
+    // their ends into one
+    vector<uint32_t> same(nodes);
+    for (uint32_t t = 0; t < nodes; t++) {
+        same[t] = t;
+    }
+    auto find = [&](uint32_t t) {
+        while (same[t] != t) {
+            t = same[t] = same[same[t]];
+        }
+        return t;
+    };
+    for (auto ab = branches.begin(); ab != branches.end(); ab++) {
+        medial_branch &br = ab->br;
+        float length = 0;
+        for (size_t k = 1; k < br.points.size(); k++) {
+            length += (br.points[k] - br.points[k - 1]).norm();
+        }
+        if (length < eps / 16) {
+            same[find(ab->ends[0])] = find(ab->ends[1]);
+            br.points.clear();
+            br.clearance.clear();
+        }
+    }
+
+    vector<uint32_t> degree(nodes, 0);
+    for (auto ab = branches.begin(); ab != branches.end(); ab++) {
+        if (ab->br.points.empty()) {
+            continue;
+        }
+        ab->ends[0] = find(ab->ends[0]);
+        ab->ends[1] = find(ab->ends[1]);
+        degree[ab->ends[0]]++;
+        degree[ab->ends[1]]++;
+    }
+    join_branches(branches, degree);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto ab = branches.begin(); ab != branches.end(); ab++) {
+            medial_branch &br = ab->br;
+            if (br.points.empty()) {
+                continue;
+            }
+            for (int e = 0; e < 2; e++) {
+                uint32_t leaf = ab->ends[e], root = ab->ends[1 - e];
+                if (degree[leaf] != 1 || degree[root] == 1) {
+                    continue;
+                }
+                if (excess(br, e == 0 ? br.points.size() - 1 : 0) < eps) {
+                    degree[leaf]--;
+                    degree[root]--;
+                    br.points.clear();
+                    br.clearance.clear();
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        if (changed) {
+            join_branches(branches, degree);
+        }
+    }
+
+    for (auto ab = branches.begin(); ab != branches.end(); ab++) {
+        medial_branch &br = ab->br;
+        if (br.points.empty() || degree[ab->ends[0]] != 1
+                || degree[ab->ends[1]] != 1) {
+            continue;
+        }
+        size_t widest = std::max_element(
+                br.clearance.begin(), br.clearance.end())
+            - br.clearance.begin();
+        if (excess(br, widest) < eps) {
+            br.points.assign(1, br.points[widest]);
+            br.clearance.assign(1, br.clearance[widest]);
+        }
+    }
+}
+
+size_t medial_axis(
+        const region &reg, const float spacing, vector<medial_branch> &out) {
+    if (reg.outer.size() < 3 || spacing <= 0) {
+        return 0;
+    }
+    vector<const polygon *> loops(1, &reg.outer);
+    for (auto h = reg.holes.begin(); h != reg.holes.end(); h++) {
+        if (h->size() >= 3) {
+            loops.push_back(&*h);
+        }
+    }
+    boundary bd;
+    for (auto l = loops.begin(); l != loops.end(); l++) {
+        const polygon &poly = **l;
+        uint32_t first = (uint32_t) bd.a.size(), n = (uint32_t) poly.size();
+        for (uint32_t i = 0; i < n; i++) {
+            bd.a.push_back(poly[i]);
+            bd.b.push_back(poly[(i + 1) % n]);
+            bd.next.push_back(first + (i + 1) % n);
+            bd.prev.push_back(first + (i + n - 1) % n);
+        }
+    }
+
+    Vector2f lo = reg.outer[0], hi = reg.outer[0];
+    for (auto p = reg.outer.begin(); p != reg.outer.end(); p++) {
+        lo = lo.cwiseMin(*p);
+        hi = hi.cwiseMax(*p);
+    }
+    float extent = (hi - lo).maxCoeff();
+    float step = max(spacing / GRID_PER_SPACING, extent / MAX_GRID_STEPS);
+    auto to_grid = [&](const Vector2f &p) {
+        ipoint q;
+        q.x = (int64_t) llround((p[0] - lo[0]) / step);
+        q.y = (int64_t) llround((p[1] - lo[1]) / step);
+        return q;
+    };
+
+    // samples every spacing along each segment, starting with its first
+    // corner. pairs holds the samples next to each other along the boundary;
+    // every loop's samples are together, in order.
+    vector<sample> samples;
+    vector<std::pair<uint32_t, uint32_t>> pairs;
+    uint32_t first = 0;
+    for (uint32_t s = 0; s < bd.a.size(); s++) {
+        Vector2f d = bd.b[s] - bd.a[s];
+        int pieces = max(1, (int) ceil(d.norm() / spacing));
+        for (int k = 0; k < pieces; k++) {
+            sample sm;
+            sm.at = to_grid(bd.a[s] + d * ((float) k / pieces));
+            sm.seg = s;
+            sm.prev = k == 0 ? bd.prev[s] : s;
+            samples.push_back(sm);
+        }
+        if (bd.next[s] <= s) {
+            uint32_t last = (uint32_t) samples.size() - 1;
+            for (uint32_t i = first; i < last; i++) {
+                pairs.push_back(std::make_pair(i, i + 1));
+            }
+            pairs.push_back(std::make_pair(last, first));
+            first = last + 1;
+        }
+    }
+
+    vector<ipoint> pts;
+    vector<uint32_t> order, point_of, sample_at;
+    vector<uint32_t> edge_of;
+    vector<uint8_t> on_boundary;
+    quadedges q(pts);
+    // boundary edges the last round's triangulation was still missing and
+    // couldn't be split any further
+    size_t unconformed = 0;
+    for (int round = 0; ; round++) {
+        // the distinct points among the samples, sorted for the
+        // triangulation, and the first sample at each of them
+        order.resize(samples.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t i, uint32_t j) {
+            return samples[i].at < samples[j].at
+                || (samples[i].at == samples[j].at && i < j);
+        });
+        pts.clear();
+        sample_at.clear();
+        point_of.resize(samples.size());
+        for (auto i = order.begin(); i != order.end(); i++) {
+            if (pts.empty() || !(pts.back() == samples[*i].at)) {
+                pts.push_back(samples[*i].at);
+                sample_at.push_back(*i);
+            }
+            point_of[*i] = (uint32_t) pts.size() - 1;
+        }
+        if (pts.size() < 3) {
+            return 0;
+        }
+        q.next.clear();
+        q.origin.clear();
+        q.dead.clear();
+        uint32_t le, re;
+        q.triangulate(0, (uint32_t) pts.size(), le, re);
+
+        edge_of.assign(pts.size(), NO_EDGE);
+        for (uint32_t e = 0; e < q.next.size(); e += 2) {
+            if (!q.dead[e / 4]) {
+                edge_of[q.org(e)] = e;
+            }
+        }
+        on_boundary.assign(q.dead.size(), 0);
+
+        // boundary edges the triangulation doesn't have are split in half
+        // until it does
+        vector<std::pair<uint32_t, uint32_t>> split;
+        bool missing = false;
+        unconformed = 0;
+        for (auto pr = pairs.begin(); pr != pairs.end(); pr++) {
+            uint32_t a = point_of[pr->first], b = point_of[pr->second];
+            if (a == b) {
+                continue;
+            }
+            uint32_t e = edge_of[a], found = NO_EDGE;
+            if (e != NO_EDGE) {
+                uint32_t f = e;
+                do {
+                    if (q.dest(f) == b) {
+                        found = f;
+                        break;
+                    }
+                    f = q.onext(f);
+                } while (f != e);
+            }
+            if (found != NO_EDGE) {
+                on_boundary[found / 4] = 1;
+                split.push_back(*pr);
+                continue;
+            }
+            const ipoint &pa = pts[a], &pb = pts[b];
+            ipoint m;
+            m.x = (pa.x + pb.x) / 2;
+            m.y = (pa.y + pb.y) / 2;
+            if (m == pa || m == pb || round == CONFORM_ROUNDS) {
+                split.push_back(*pr);
+                unconformed++;
+                continue;
+            }
+            sample sm;
+            sm.at = m;
+            sm.seg = sm.prev = samples[pr->first].seg;
+            samples.push_back(sm);
+            uint32_t k = (uint32_t) samples.size() - 1;
+            split.push_back(std::make_pair(pr->first, k));
+            split.push_back(std::make_pair(k, pr->second));
+            missing = true;
+        }
+        pairs.swap(split);
+        if (!missing) {
+            break;
+        }
+    }
+
+    // the triangles are the faces left of three edges going round them
+    // counterclockwise; the face outside the hull goes round clockwise
+    vector<uint32_t> tri_of(q.next.size(), NO_EDGE), tri_edges;
+    for (uint32_t e = 0; e < q.next.size(); e += 2) {
+        if (q.dead[e / 4] || tri_of[e] != NO_EDGE) {
+            continue;
+        }
+        uint32_t e1 = q.lnext(e), e2 = q.lnext(e1);
+        if (q.lnext(e2) != e
+                || !ccw(pts[q.org(e)], pts[q.org(e1)], pts[q.org(e2)])) {
+            continue;
+        }
+        uint32_t t = (uint32_t) tri_edges.size() / 3;
+        tri_of[e] = tri_of[e1] = tri_of[e2] = t;
+        tri_edges.push_back(e);
+        tri_edges.push_back(e1);
+        tri_edges.push_back(e2);
+    }
+    uint32_t tris = (uint32_t) tri_edges.size() / 3;
+
+    // a triangle is inside if it's across an odd number of boundary edges
+    // from the outside of the hull
+    vector<uint8_t> inside(tris, 0), seen(tris, 0);
+    vector<uint32_t> queue;
+    for (uint32_t e = 0; e < q.next.size(); e += 2) {
+        uint32_t t = tri_of[q.sym(e)];
+        if (q.dead[e / 4] || tri_of[e] != NO_EDGE || t == NO_EDGE || seen[t]) {
+            continue;
+        }
+        inside[t] = on_boundary[e / 4];
+        seen[t] = 1;
+        queue.push_back(t);
+    }
+    for (size_t k = 0; k < queue.size(); k++) {
+        uint32_t t = queue[k];
+        for (int i = 0; i < 3; i++) {
+            uint32_t e = tri_edges[3 * t + i], u = tri_of[q.sym(e)];
+            if (u != NO_EDGE && !seen[u]) {
+                inside[u] = inside[t] ^ on_boundary[e / 4];
+                seen[u] = 1;
+                queue.push_back(u);
+            }
+        }
+    }
+    // with a boundary edge missing, the flood crosses the boundary without
+    // counting it and turns everything past it inside out, so every triangle
+    // is placed by its centroid instead
+    if (unconformed > 0) {
+        for (uint32_t t = 0; t < tris; t++) {
+            const ipoint &a = pts[q.org(tri_edges[3 * t])],
+                  &b = pts[q.org(tri_edges[3 * t + 1])],
+                  &c = pts[q.org(tri_edges[3 * t + 2])];
+            Vector2f at(
+                    lo[0] + (float) ((a.x + b.x + c.x) * (double) step / 3),
+                    lo[1] + (float) ((a.y + b.y + c.y) * (double) step / 3));
+            bool in = point_in_polygon(at, reg.outer);
+            for (auto h = reg.holes.begin();
+                    in && h != reg.holes.end(); h++) {
+                in = !point_in_polygon(at, *h);
+            }
+            inside[t] = in;
+        }
+    }
+
+    // the voronoi vertex of every triangle inside, and its clearance from
+    // the segments its samples are on
+    vector<Vector2f> center(tris);
+    vector<float> clear(tris, 0);
+    for (uint32_t t = 0; t < tris; t++) {
+        if (!inside[t]) {
+            continue;
+        }
+        const ipoint &a = pts[q.org(tri_edges[3 * t])],
+              &b = pts[q.org(tri_edges[3 * t + 1])],
+              &c = pts[q.org(tri_edges[3 * t + 2])];
+        double bx = b.x - a.x, by = b.y - a.y, cx = c.x - a.x, cy = c.y - a.y;
+        double d = 2 * (bx * cy - by * cx);
+        double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+        double ux = (cy * b2 - by * c2) / d, uy = (bx * c2 - cx * b2) / d;
+        center[t] = Vector2f(lo[0] + (float) ((a.x + ux) * step),
+                lo[1] + (float) ((a.y + uy) * step));
+        float best = INFINITY;
+        for (int i = 0; i < 3; i++) {
+            const sample &sm = samples[sample_at[q.org(tri_edges[3 * t + i])]];
+            best = min(best, point_segment_distance2(
+                        center[t], bd.a[sm.seg], bd.b[sm.seg]));
+            best = min(best, point_segment_distance2(
+                        center[t], bd.a[sm.prev], bd.b[sm.prev]));
+        }
+        clear[t] = sqrt(best);
+    }
+
+    // the medial axis as a graph on the triangles: link[3 t + i] is the
+    // triangle across edge i of t, if the edge is far enough across
+    float separation = MIN_SEPARATION * spacing / step;
+    vector<uint32_t> link(3 * tris, NO_EDGE);
+    vector<uint8_t> degree(tris, 0);
+    for (uint32_t t = 0; t < tris; t++) {
+        if (!inside[t]) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            uint32_t e = tri_edges[3 * t + i], u = tri_of[q.sym(e)];
+            if (u == NO_EDGE || !inside[u] || on_boundary[e / 4]) {
+                continue;
+            }
+            const ipoint &a = pts[q.org(e)], &b = pts[q.dest(e)];
+            double dx = a.x - b.x, dy = a.y - b.y;
+            if (dx * dx + dy * dy > (double) separation * separation) {
+                link[3 * t + i] = u;
+                degree[t]++;
+            }
+        }
+    }
+
+    // a dead end where the two samples across the last edge are either side
+    // of a convex corner leads into the corner
+    auto corner = [&](const uint32_t t, Vector2f &at) {
+        for (int i = 0; i < 3; i++) {
+            if (link[3 * t + i] == NO_EDGE) {
+                continue;
+            }
+            uint32_t e = tri_edges[3 * t + i];
+            const sample &a = samples[sample_at[q.org(e)]],
+                  &b = samples[sample_at[q.dest(e)]];
+            uint32_t as[2] = { a.seg, a.prev }, bs[2] = { b.seg, b.prev };
+            for (int j = 0; j < 4; j++) {
+                uint32_t s = as[j / 2], u = bs[j % 2];
+                if (bd.next[u] == s) {
+                    std::swap(s, u);
+                }
+                if (bd.next[s] == u && s != u && bd.convex_after(s)) {
+                    at = bd.b[s];
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // the distance from p to the segments of the samples either side of e
+    auto edge_clearance = [&](const uint32_t e, const Vector2f &p) {
+        const sample &a = samples[sample_at[q.org(e)]],
+              &b = samples[sample_at[q.dest(e)]];
+        uint32_t segs[4] = { a.seg, a.prev, b.seg, b.prev };
+        float best = INFINITY;
+        for (int k = 0; k < 4; k++) {
+            best = min(best,
+                    point_segment_distance2(p, bd.a[segs[k]], bd.b[segs[k]]));
+        }
+        return (float) sqrt(best);
+    };
+
+    vector<uint8_t> used(3 * tris, 0);
+    vector<axis_branch> branches;
+    auto add_point = [&](medial_branch &br, const Vector2f &p, float c) {
+        if (br.points.empty() || br.points.back() != p) {
+            br.points.push_back(p);
+            br.clearance.push_back(c);
+        }
+    };
+    // follows the axis out of t across edge i until it gets to a triangle
+    // where it doesn't just carry on, or back to where it started
+    auto trace = [&](uint32_t t, int i) {
+        axis_branch ab;
+        medial_branch &br = ab.br;
+        Vector2f at;
+        if (degree[t] == 1 && corner(t, at)) {
+            add_point(br, at, 0);
+        }
+        add_point(br, center[t], clear[t]);
+        uint32_t start = t;
+        while (true) {
+            uint32_t u = link[3 * t + i];
+            used[3 * t + i] = 1;
+            for (int j = 0; j < 3; j++) {
+                if (link[3 * u + j] == t) {
+                    used[3 * u + j] = 1;
+                }
+            }
+            // clearance isn't linear along the edges between a corner and a
+            // segment, so ones that bend away from it are filled in
+            uint32_t e = tri_edges[3 * t + i];
+            Vector2f from = center[t], to = center[u];
+            int pieces = (int) ((to - from).norm() / spacing);
+            if (pieces > 1 && fabs(edge_clearance(e, (from + to) / 2)
+                        - (clear[t] + clear[u]) / 2) < spacing / 16) {
+                pieces = 1;
+            }
+            for (int k = 1; k < pieces; k++) {
+                Vector2f p = from + (to - from) * ((float) k / pieces);
+                add_point(br, p, edge_clearance(e, p));
+            }
+            add_point(br, center[u], clear[u]);
+            if (degree[u] != 2 || u == start) {
+                if (degree[u] == 1 && corner(u, at)) {
+                    add_point(br, at, 0);
+                }
+                t = u;
+                break;
+            }
+            int next = -1;
+            for (int j = 0; j < 3; j++) {
+                if (link[3 * u + j] != NO_EDGE && !used[3 * u + j]) {
+                    next = j;
+                }
+            }
+            t = u;
+            if (next < 0) {
+                break;
+            }
+            i = next;
+        }
+        ab.ends[0] = start;
+        ab.ends[1] = t;
+        branches.push_back(ab);
+    };
+    for (int pass = 0; pass < 2; pass++) {
+        // branches out of junctions and dead ends first, then loops
+        for (uint32_t t = 0; t < tris; t++) {
+            if (degree[t] == 0 || (pass == 0 && degree[t] == 2)) {
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                if (link[3 * t + i] != NO_EDGE && !used[3 * t + i]) {
+                    trace(t, i);
+                }
+            }
+        }
+    }
+    prune_branches(branches, tris, spacing);
+    for (auto ab = branches.begin(); ab != branches.end(); ab++) {
+        if (!ab->br.points.empty()) {
+            out.push_back(ab->br);
+        }
+    }
+    return unconformed;
+}
+
+size_t layer_medial_axes(
+        const vector<levelset> &levelsets, const float spacing,
+        vector<vector<medial_branch>> &out) {
+    out.assign(levelsets.size(), vector<medial_branch>());
+    vector<size_t> unconformed(levelsets.size(), 0);
+    parallel_for(levelsets.size(), [&](size_t i) {
+        vector<polygon> loops;
+        vector<region> regions;
+        perimeter_polygons(levelsets[i], loops);
+        find_regions(loops, regions);
+        for (auto reg = regions.begin(); reg != regions.end(); reg++) {
+            unconformed[i] += medial_axis(*reg, spacing, out[i]);
+        }
+    });
+    size_t total = 0;
+    for (auto u = unconformed.begin(); u != unconformed.end(); u++) {
+        total += *u;
+    }
+    return total;
+}
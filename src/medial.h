@@ -0,0 +1,55 @@
+#ifndef __TP_MEDIAL_H__
+#define __TP_MEDIAL_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "polygon.h"
+#include "slice.h"
+
+using namespace Eigen;
+
+// the medial axis of a region: the points with two or more nearest points on
+// the region's boundary, where the largest circle that fits in the region
+// around them touches the boundary in more than one place. it runs down the
+// middle of every part of the region, into every sharp corner, and the radius
+// of those circles says how wide the region is there.
+
+// a branch of the medial axis, running between junctions, corners and dead
+// ends, or round a loop: its points, and the clearance around each of them,
+// the distance to the nearest point on the region's boundary. closed loops
+// end on the point they start from, and the axis of a region with no corners
+// worth the name, like a circle, is a single point.
+class medial_branch {
+    public:
+        std::vector<Vector2f> points;
+        std::vector<float> clearance;
+};
+
+// finds the medial axis of a region. the boundary is sampled every spacing
+// and rounded onto an integer grid much finer than that, and the samples are
+// triangulated with exact integer predicates (Guibas and Stolfi's divide and
+// conquer, in O(n log n)), splitting boundary edges until the triangulation
+// has every one of them. the centers of the triangles inside the region are
+// points of the voronoi diagram of the samples, and its edges between samples
+// further apart than a few spacings are the medial axis; the ones between
+// samples close together only run out to the boundary between them. clearance
+// is measured exactly against the region's edges. branches out to dead ends
+// are dropped if their circles reach less than spacing beyond the rest of the
+// axis, and the ones that end near a convex corner are carried on into it,
+// where clearance falls to zero. returns the number of boundary edges the
+// triangulation still didn't have once they'd been split as far as they go;
+// if there are any, triangles are told to be inside the region or not by
+// their centroids rather than by the edges between them.
+size_t medial_axis(
+        const region &reg, const float spacing,
+        std::vector<medial_branch> &out);
+
+// the medial axes of every region of every layer, one layer to a thread;
+// out[i] holds the branches of levelsets[i]. returns the number of boundary
+// edges left out of the triangulations, as medial_axis does.
+size_t layer_medial_axes(
+        const std::vector<levelset> &levelsets, const float spacing,
+        std::vector<std::vector<medial_branch>> &out);
+
+#endif
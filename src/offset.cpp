@@ -0,0 +1,394 @@
+#include "offset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "spatial.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// a segment of the raw offset, between two entries of the point table
+struct rawseg {
+    uint32_t a, b;
+};
+
+// a point where a raw segment is crossed by another one, t of the way along
+struct rawcut {
+    double t;
+    uint32_t point;
+    // the segment doing the crossing
+    uint32_t other;
+};
+
+Vector2f left_normal(const Vector2f &a, const Vector2f &b) {
+    Vector2f d = b - a;
+    return Vector2f(-d[1], d[0]) / d.norm();
+}
+
+// adds a point to the table unless it's the same as the last one, so raw
+// loops never contain zero-length segments
+void push_point(vector<Vector2f> &points, const uint32_t first, Vector2f p) {
+    if (points.size() > first && points.back() == p) {
+        return;
+    }
+    points.push_back(p);
+}
+
+// appends the raw offset of a single loop to the point table and the segment
+// list. the region is on the left of the loop, so the offset moves left.
+void raw_offset_loop(
+        const polygon &loop, const float d, const float tolerance,
+        vector<Vector2f> &points, vector<rawseg> &segs) {
+    polygon p;
+    for (auto pt = loop.begin(); pt != loop.end(); pt++) {
+        if (p.empty() || *pt != p.back()) {
+            p.push_back(*pt);
+        }
+    }
+    if (p.size() > 1 && p.front() == p.back()) {
+        p.pop_back();
+    }
+    size_t n = p.size();
+    if (n < 3) {
+        return;
+    }
+
+    // angle covered by each chord of a rounded corner so that the chords
+    // stay within tolerance / 2 of the arc
+    float step = M_PI / 4;
+    if (tolerance < 4 * d) {
+        step = min(step, (float) (2 * acos(1 - tolerance / (2 * d))));
+    }
+
+    uint32_t first = points.size();
+    for (size_t i = 0; i < n; i++) {
+        const Vector2f &prev = p[(i + n - 1) % n],
+                       &cur = p[i],
+                       &next = p[(i + 1) % n];
+        Vector2f n0 = left_normal(prev, cur), n1 = left_normal(cur, next);
+        Vector2f d0 = cur - prev, d1 = next - cur;
+        float turn = d0[0] * d1[1] - d0[1] * d1[0];
+
+        // how far the loop turns clockwise here. the sweep comes from the
+        // edges themselves so that it always agrees with the sign of the
+        // turn, however close to straight it is.
+        float sweep = atan2(-turn, d0.dot(d1));
+
+        if (sweep > step) {
+            // reflex corner; the offset is an arc around it, turning
+            // clockwise from one edge's normal to the next one's
+            float a0 = atan2(n0[1], n0[0]);
+            int steps = (int) ceil(sweep / step);
+            push_point(points, first, cur + d * n0);
+            for (int s = 1; s < steps; s++) {
+                float a = a0 - sweep * s / steps;
+                push_point(points, first, cur + d * Vector2f(cos(a), sin(a)));
+            }
+            push_point(points, first, cur + d * n1);
+        } else if (turn <= 0 || d * (n1 - n0).norm() < tolerance / 4
+                || d * turn / (d0.norm() * d1.norm() + d0.dot(d1))
+                    <= min(d0.norm(), d1.norm()) / 2) {
+            // a reflex corner that a single chord would cover, or a convex
+            // corner that's either nearly straight or has long enough edges
+            // on both sides that extending them to where they meet can't turn
+            // either of them around. the two offset edges meet where both of
+            // them are d away from the corner. this keeps the point count
+            // from growing when offsetting an offset, and keeps swallowtails
+            // out of the raw loop on densely sampled curves, where they'd be
+            // too thin for a float to resolve.
+            push_point(points, first, cur + d * (n0 + n1) / (1 + n0.dot(n1)));
+        } else {
+            // convex corner; the offset edges overlap here. going through the
+            // corner itself in between makes the overlap wind around
+            // negatively, so it cancels out of the result even where it
+            // reaches past other parts of the offset.
+            push_point(points, first, cur + d * n0);
+            push_point(points, first, cur);
+            push_point(points, first, cur + d * n1);
+        }
+    }
+    if (points.size() > first + 1 && points.back() == points[first]) {
+        points.pop_back();
+    }
+
+    uint32_t last = points.size();
+    if (last - first < 3) {
+        points.resize(first);
+        return;
+    }
+    for (uint32_t i = first; i < last; i++) {
+        rawseg s;
+        s.a = i;
+        s.b = i + 1 == last ? first : i + 1;
+        segs.push_back(s);
+    }
+}
+
+void sort_cuts(vector<rawcut> &cuts) {
+    std::sort(cuts.begin(), cuts.end(), [](const rawcut &x, const rawcut &y) {
+        return x.t < y.t;
+    });
+}
+
+// 1 if segment j crosses segment i from right to left, -1 the other way
+// around. moving along i past the crossing changes the winding number on
+// i's right by minus this.
+int crossing_sign(
+        const vector<Vector2f> &points, const vector<rawseg> &segs,
+        const uint32_t i, const uint32_t j) {
+    Vector2d di = (points[segs[i].b] - points[segs[i].a]).cast<double>(),
+             dj = (points[segs[j].b] - points[segs[j].a]).cast<double>();
+    return di[0] * dj[1] - di[1] * dj[0] > 0 ? 1 : -1;
+}
+
+void offset_region(
+        const region &reg, const float d, const float tolerance,
+        vector<region> &out) {
+    vector<Vector2f> points;
+    vector<rawseg> segs;
+    // each raw loop's segments are contiguous; this holds where each starts
+    vector<uint32_t> loop_start;
+    for (size_t l = 0; l <= reg.holes.size(); l++) {
+        size_t before = segs.size();
+        raw_offset_loop(
+                l == 0 ? reg.outer : reg.holes[l - 1], d, tolerance,
+                points, segs);
+        if (segs.size() > before) {
+            loop_start.push_back(before);
+        }
+    }
+    if (segs.empty()) {
+        return;
+    }
+
+    // cells about as large as the typical segment, so each one only passes
+    // through a handful of them
+    double total_len = 0;
+    for (auto s = segs.begin(); s != segs.end(); s++) {
+        total_len += (points[s->b] - points[s->a]).norm();
+    }
+    float cell = total_len / segs.size();
+
+    // find every crossing between raw segments
+    segmentgrid raw_grid(cell);
+    for (uint32_t i = 0; i < segs.size(); i++) {
+        raw_grid.insert(points[segs[i].a], points[segs[i].b], i);
+    }
+    vector<vector<rawcut>> cuts(segs.size());
+    vector<uint32_t> near;
+    for (uint32_t i = 0; i < segs.size(); i++) {
+        Vector2f a = points[segs[i].a], b = points[segs[i].b];
+        near.clear();
+        raw_grid.query(a, b, near);
+        for (auto j = near.begin(); j != near.end(); j++) {
+            if (*j <= i) {
+                continue;
+            }
+            const rawseg &o = segs[*j];
+            if (o.a == segs[i].a || o.a == segs[i].b
+                    || o.b == segs[i].a || o.b == segs[i].b) {
+                // neighbours only meet at their shared point
+                continue;
+            }
+            Vector2d p = a.cast<double>(), r = (b - a).cast<double>();
+            Vector2d q = points[o.a].cast<double>(),
+                     s = (points[o.b] - points[o.a]).cast<double>();
+            double denom = r[0] * s[1] - r[1] * s[0];
+            if (denom == 0) {
+                continue;
+            }
+            Vector2d qp = q - p;
+            double t = (qp[0] * s[1] - qp[1] * s[0]) / denom;
+            double u = (qp[0] * r[1] - qp[1] * r[0]) / denom;
+            if (t <= 0 || t >= 1 || u <= 0 || u >= 1) {
+                continue;
+            }
+            rawcut c;
+            c.point = points.size();
+            points.push_back((p + t * r).cast<float>());
+            c.t = t;
+            c.other = *j;
+            cuts[i].push_back(c);
+            c.t = u;
+            c.other = i;
+            cuts[*j].push_back(c);
+        }
+    }
+
+    // the offset region is where the raw loops wind around positively; a
+    // piece of a raw segment is on its boundary if the winding number just to
+    // its right is zero, which makes it one just to its left. swallowtails at
+    // corners and loops where the region pinches off all wind zero or less,
+    // so they fall away.
+    //
+    // casting a ray from every piece goes wrong wherever pieces are tiny or
+    // nearly parallel to the ray, which is everywhere on a densely sampled
+    // curve. instead, each raw loop gets one ray, cast sideways from the
+    // middle of its longest segment, and the winding is carried along the
+    // loop from there: it only changes where another segment crosses.
+    vector<int> winding(segs.size());
+    for (size_t l = 0; l < loop_start.size(); l++) {
+        uint32_t lo = loop_start[l],
+                 hi = l + 1 < loop_start.size()
+                     ? loop_start[l + 1] : segs.size();
+        uint32_t ref = lo;
+        float ref_len = 0;
+        for (uint32_t i = lo; i < hi; i++) {
+            float len = (points[segs[i].b] - points[segs[i].a]).norm();
+            if (len > ref_len) {
+                ref = i;
+                ref_len = len;
+            }
+        }
+        sort_cuts(cuts[ref]);
+        double t_mid = 0.5;
+        if (!cuts[ref].empty()) {
+            // the longest stretch between crossings, so the ray starts well
+            // clear of them
+            double best = 0, prev_t = 0;
+            for (size_t k = 0; k <= cuts[ref].size(); k++) {
+                double t = k == cuts[ref].size() ? 1 : cuts[ref][k].t;
+                if (t - prev_t > best) {
+                    best = t - prev_t;
+                    t_mid = (t + prev_t) / 2;
+                }
+                prev_t = t;
+            }
+        }
+
+        // work in a frame where the ray runs along +x from the origin
+        Vector2d a = points[segs[ref].a].cast<double>(),
+                 b = points[segs[ref].b].cast<double>();
+        Vector2d m = a + t_mid * (b - a);
+        Vector2d dir = (b - a).normalized();
+        Vector2d ray(dir[1], -dir[0]), side(dir[0], dir[1]);
+        int w = 0;
+        for (uint32_t o = 0; o < segs.size(); o++) {
+            if (o == ref) {
+                continue;
+            }
+            Vector2d p = points[segs[o].a].cast<double>() - m,
+                     q = points[segs[o].b].cast<double>() - m;
+            double py = p.dot(side), qy = q.dot(side);
+            if ((py > 0) != (qy > 0)) {
+                double px = p.dot(ray), qx = q.dot(ray);
+                if (px + (0 - py) * (qx - px) / (qy - py) > 0) {
+                    w += qy > py ? 1 : -1;
+                }
+            }
+        }
+
+        // walk back to the start of the reference segment, undoing the
+        // crossings in front of the ray, then once around the loop
+        for (size_t k = 0; k < cuts[ref].size() && cuts[ref][k].t < t_mid;
+                k++) {
+            w += crossing_sign(points, segs, ref, cuts[ref][k].other);
+        }
+        for (uint32_t n = 0; n < hi - lo; n++) {
+            uint32_t i = lo + (ref - lo + n) % (hi - lo);
+            winding[i] = w;
+            sort_cuts(cuts[i]);
+            for (auto c = cuts[i].begin(); c != cuts[i].end(); c++) {
+                w -= crossing_sign(points, segs, i, c->other);
+            }
+        }
+    }
+
+    // crossings can round to the same point as each other or as a segment's
+    // end, so pieces refer to points by the first index with their
+    // coordinates. otherwise a piece that rounds away to nothing would leave a
+    // gap in the loop it belongs to.
+    vector<uint32_t> same(points.size());
+    std::unordered_map<uint64_t, uint32_t> first_at;
+    for (uint32_t p = 0; p < points.size(); p++) {
+        uint32_t x, y;
+        memcpy(&x, &points[p][0], sizeof(x));
+        memcpy(&y, &points[p][1], sizeof(y));
+        auto found = first_at.emplace(((uint64_t) x << 32) | y, p);
+        same[p] = found.first->second;
+    }
+
+    // cut the raw segments at their crossings and keep the boundary pieces
+    vector<rawseg> pieces;
+    vector<vector<uint32_t>> leaving(points.size());
+    for (uint32_t i = 0; i < segs.size(); i++) {
+        int w = winding[i];
+        uint32_t from = same[segs[i].a];
+        for (size_t k = 0; k <= cuts[i].size(); k++) {
+            uint32_t to = same[
+                k == cuts[i].size() ? segs[i].b : cuts[i][k].point];
+            if (w == 0 && from != to) {
+                rawseg piece;
+                piece.a = from;
+                piece.b = to;
+                leaving[from].push_back(pieces.size());
+                pieces.push_back(piece);
+            }
+            if (k < cuts[i].size()) {
+                w -= crossing_sign(points, segs, i, cuts[i][k].other);
+            }
+            from = to;
+        }
+    }
+
+    // stitch the pieces back into closed loops. a walk that comes back to a
+    // point it already passed closes a loop there, so stray pieces from
+    // near-tangent crossings can't take the loops around them down too; walks
+    // that run into a dead end are dropped.
+    vector<polygon> loops;
+    vector<bool> used(pieces.size(), false);
+    vector<int64_t> walk_pos(points.size(), -1);
+    vector<uint32_t> walk;
+    for (size_t k = 0; k < pieces.size(); k++) {
+        if (used[k]) {
+            continue;
+        }
+        walk.clear();
+        walk.push_back(pieces[k].a);
+        walk_pos[pieces[k].a] = 0;
+        while (true) {
+            uint32_t at = walk.back();
+            size_t next = pieces.size();
+            for (auto l = leaving[at].begin(); l != leaving[at].end(); l++) {
+                if (!used[*l]) {
+                    next = *l;
+                    break;
+                }
+            }
+            if (next == pieces.size()) {
+                break;
+            }
+            used[next] = true;
+
+            uint32_t to = pieces[next].b;
+            if (walk_pos[to] == -1) {
+                walk_pos[to] = walk.size();
+                walk.push_back(to);
+                continue;
+            }
+            size_t start = walk_pos[to];
+            polygon loop;
+            for (size_t w = start; w < walk.size(); w++) {
+                loop.push_back(points[walk[w]]);
+                if (w > start) {
+                    walk_pos[walk[w]] = -1;
+                }
+            }
+            walk.resize(start + 1);
+            if (loop.size() >= 3
+                    && fabs(signed_area(loop)) > tolerance * tolerance) {
+                loops.push_back(loop);
+            }
+        }
+        for (auto w = walk.begin(); w != walk.end(); w++) {
+            walk_pos[*w] = -1;
+        }
+    }
+
+    find_regions(loops, out);
+}
@@ -0,0 +1,21 @@
+#ifndef __TP_OFFSET_H__
+#define __TP_OFFSET_H__
+
+#include <vector>
+
+#include "polygon.h"
+
+// shrinks a region by d: the result is every point of the region that is at
+// least d away from its boundary, which can be any number of regions (or
+// none). reflex corners round off into arcs, which are approximated with
+// chords deviating from the true arc by at most tolerance / 2.
+//
+// each boundary is first offset edge by edge into a raw loop that can cross
+// itself and the other loops. the crossings are found with a uniform grid,
+// the raw loops are cut at them, and the pieces bounding the area the raw
+// loops wind around positively are stitched back together into the result.
+void offset_region(
+        const region &reg, const float d, const float tolerance,
+        std::vector<region> &out);
+
+#endif
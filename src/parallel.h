@@ -0,0 +1,52 @@
+#ifndef __TP_PARALLEL_H__
+#define __TP_PARALLEL_H__
+
+#include <algorithm>
+#include <functional>
+
+#include "scheduler.h"
+
+// the smallest piece parallel_for splits its range into is about this many
+// times smaller than an even share of it per thread
+#define PARALLEL_GRAIN_SPLITS (32)
+
+// calls fn(i) for every i in [0, n), spreading the calls across the shared
+// scheduler's threads. the range is split in halves lazily: a thread only
+// splits off the top half of what it has left when its own deque is empty,
+// so uneven work (some layers are much busier than others) still balances
+// by being stolen, while even work isn't chopped up more than it needs. fn
+// must be safe to call concurrently for distinct values of i. a thread
+// waiting for the calls to finish runs other tasks meanwhile, so fn mustn't
+// hold thread-local scratch across a nested parallel_for.
+template <typename F>
+void parallel_for(const size_t n, F fn) {
+    scheduler &s = scheduler::get();
+    if (s.threads() <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    size_t grain = std::max(
+            (size_t) 1, n / (s.threads() * PARALLEL_GRAIN_SPLITS));
+    task_group g;
+    std::function<void(size_t, size_t)> range = [&](size_t lo, size_t hi) {
+        while (lo < hi && !g.cancelled()) {
+            if (hi - lo > grain && !s.local_work()) {
+                size_t mid = lo + (hi - lo) / 2;
+                g.run([&range, mid, hi]() { range(mid, hi); });
+                hi = mid;
+                continue;
+            }
+            size_t end = std::min(hi, lo + grain);
+            for (; lo < end; lo++) {
+                fn(lo);
+            }
+        }
+    };
+    g.run([&range, n]() { range(0, n); });
+    g.wait();
+}
+
+#endif
@@ -1,16 +1,179 @@
 #include "path.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "arcfit.h"
+#include "parallel.h"
+#include "rest.h"
+
 using std::vector;
 
 path generate_toolpath(const vector<levelset> &levelsets, const tooldef td) {
     path p;
-    for (auto ls = levelsets.begin(); ls != levelsets.end(); ls++) {
-        auto perims = ls->perimeters;
-        for (auto perim = perims.begin(); perim != perims.end(); perim++) {
-            for (auto v = perim->begin(); v != perim->end(); v++) {
-                p.points.push_back(Vector3f(ls->verteces[*v]));
+    if (levelsets.empty()) {
+        return p;
+    }
+
+    // arc fitting only looks at one perimeter at a time, so every layer can be
+    // fitted independently and the results stitched together in layer order.
+    vector<vector<vector<move>>> layer_moves(levelsets.size());
+    parallel_for(levelsets.size(), [&](size_t i) {
+        const levelset &ls = levelsets[i];
+        vector<Vector3f> perim_points;
+        for (size_t p = 0; p < ls.perimeter_count(); p++) {
+            layerlist<uint32_t> perim = ls.perimeter(p);
+            if (perim.empty()) {
+                continue;
+            }
+            perim_points.clear();
+            for (auto v = perim.begin(); v != perim.end(); v++) {
+                perim_points.push_back(ls.vertex(*v));
             }
+            layer_moves[i].push_back(vector<move>());
+            vector<move> &moves = layer_moves[i].back();
+            moves.push_back(move(MOVE_LINEAR, perim_points[0]));
+            // slicing simplified the perimeters to within the other half
+            fit_arcs(perim_points, td.tolerance / 2, moves);
+        }
+    });
+
+    // every perimeter is plunged into from above the model, so the tool never
+    // feeds through it between perimeters or layers
+    float safe_z = safe_height(levelsets, td);
+    for (auto lm = layer_moves.begin(); lm != layer_moves.end(); lm++) {
+        for (auto moves = lm->begin(); moves != lm->end(); moves++) {
+            append_moves(p, *moves, safe_z);
         }
     }
     return p;
 }
+
+float safe_height(const vector<levelset> &levelsets, const tooldef td) {
+    return levelsets.empty() ? 0 : levelsets.back().z + td.z_accuracy;
+}
+
+path clear_layers(
+        const vector<levelset> &levelsets, const tooldef td,
+        region_clearer clear, const zmap *rest, const float safe_z) {
+    path p;
+    if (levelsets.empty()) {
+        return p;
+    }
+    zmap reach;
+    if (rest != NULL) {
+        stock_reach(*rest, td.r, reach);
+    }
+
+    vector<vector<region>> layer_regions(levelsets.size());
+    parallel_for(levelsets.size(), [&](size_t i) {
+        vector<polygon> loops;
+        perimeter_polygons(levelsets[i], loops);
+        find_regions(loops, layer_regions[i]);
+    });
+
+    // every region is a job of its own, so one busy region doesn't hold up
+    // the rest of its layer. first_job[i] is the first job of layer i.
+    vector<size_t> first_job(levelsets.size() + 1, 0);
+    for (size_t i = 0; i < levelsets.size(); i++) {
+        first_job[i + 1] = first_job[i] + layer_regions[i].size();
+    }
+    vector<vector<vector<Vector3f>>> job_passes(first_job.back());
+    parallel_for(first_job.back(), [&](size_t job) {
+        size_t i = std::upper_bound(first_job.begin(), first_job.end(), job)
+            - first_job.begin() - 1;
+        const region &reg = layer_regions[i][job - first_job[i]];
+        float z = levelsets[i].z;
+        if (rest == NULL) {
+            clear(reg, z, td, job_passes[job]);
+            return;
+        }
+        if (!region_has_rest(reach, reg, z, td.tolerance)) {
+            return;
+        }
+        vector<vector<Vector3f>> passes;
+        clear(reg, z, td, passes);
+        for (auto pass = passes.begin(); pass != passes.end(); pass++) {
+            trim_pass(reach, td.tolerance, *pass, job_passes[job]);
+        }
+    });
+
+    for (size_t i = levelsets.size(); i-- > 0;) {
+        for (size_t job = first_job[i]; job < first_job[i + 1]; job++) {
+            for (auto pass = job_passes[job].begin();
+                    pass != job_passes[job].end(); pass++) {
+                append_polyline(p, *pass, safe_z);
+            }
+        }
+    }
+    return p;
+}
+
+// retracts from wherever the path ends and travels over to above to. a path
+// with no moves yet starts above to, since wherever the machine was before
+// is unknown.
+void retract_to(path &p, const Vector3f &to, const float safe_z) {
+    Vector3f above = to;
+    above[2] = safe_z;
+    if (p.moves.empty()) {
+        p.moves.push_back(move(MOVE_RAPID, above));
+        p.points.push_back(above);
+        return;
+    }
+    Vector3f last = p.moves.back().end;
+    last[2] = safe_z;
+    p.moves.push_back(move(MOVE_RAPID, last));
+    p.moves.push_back(move(MOVE_RAPID, above));
+    p.points.push_back(last);
+    p.points.push_back(above);
+}
+
+void append_polyline(
+        path &p, const vector<Vector3f> &points, const float safe_z) {
+    if (points.empty()) {
+        return;
+    }
+    retract_to(p, points[0], safe_z);
+    for (auto pt = points.begin(); pt != points.end(); pt++) {
+        p.moves.push_back(move(MOVE_LINEAR, *pt));
+        p.points.push_back(*pt);
+    }
+}
+
+void append_moves(path &p, const vector<move> &moves, const float safe_z) {
+    if (moves.empty()) {
+        return;
+    }
+    retract_to(p, moves[0].end, safe_z);
+    for (auto m = moves.begin(); m != moves.end(); m++) {
+        if (m->type == MOVE_ARC_CW || m->type == MOVE_ARC_CCW) {
+            Vector3f from = p.points.back() - m->center;
+            Vector3f to = m->end - m->center;
+            float start = atan2(from[1], from[0]);
+            float angle = atan2(to[1], to[0]) - start;
+            if (m->type == MOVE_ARC_CCW) {
+                while (angle <= 0) {
+                    angle += 2 * M_PI;
+                }
+            } else {
+                while (angle >= 0) {
+                    angle -= 2 * M_PI;
+                }
+            }
+            float radius = Vector2f(from[0], from[1]).norm();
+            int chords = (int) ceil(fabs(angle) / M_PI * ARC_DRAW_CHORDS);
+            for (int k = 1; k < chords; k++) {
+                float a = start + angle * k / chords;
+                p.points.push_back(Vector3f(
+                        m->center[0] + radius * cos(a),
+                        m->center[1] + radius * sin(a), m->end[2]));
+            }
+        }
+        p.moves.push_back(*m);
+        p.points.push_back(m->end);
+    }
+}
+
+move::move() : type(MOVE_LINEAR) {}
+
+move::move(const int type, const Vector3f &end) : type(type), end(end) {}
@@ -4,16 +4,75 @@
 #include <vector>
 #include <Eigen/Dense>
 
+#include "polygon.h"
 #include "slice.h"
 #include "tooldef.h"
 
 using namespace Eigen;
 
+class zmap;
+
+#define MOVE_LINEAR (0)
+#define MOVE_ARC_CW (1)
+#define MOVE_ARC_CCW (2)
+#define MOVE_RAPID (3)
+
+#define ARC_DRAW_CHORDS (8)
+
+// a single machine move. the move starts wherever the previous move ended.
+class move {
+    public:
+        move();
+        move(const int type, const Vector3f &end);
+
+        // one of MOVE_LINEAR, MOVE_ARC_CW, MOVE_ARC_CCW or MOVE_RAPID. arcs
+        // always lie in the xy-plane.
+        int type;
+        // where the move ends
+        Vector3f end;
+        // center of the arc; unused for linear moves
+        Vector3f center;
+};
+
 class path {
     public:
+        // every point the tool passes through, for drawing
         std::vector<Vector3f> points;
+        // the same path as a sequence of linear and arc moves, for output
+        std::vector<move> moves;
 };
 
+// generates the passes clearing a single region of a layer at height z, for
+// the tool center
+typedef void (*region_clearer)(
+        const region &reg, const float z, const tooldef td,
+        std::vector<std::vector<Vector3f>> &passes);
+
 path generate_toolpath(const std::vector<levelset> &levelsets, const tooldef);
+// the height to retract to over layers from slice, whose last layer is at the
+// top of the model: a layer's height above it, or 0 if there are no layers
+float safe_height(const std::vector<levelset> &levelsets, const tooldef td);
+// clears every region of every layer with the given strategy. regions are
+// worked on in parallel, each on its own, and machined a layer at a time from
+// the top down, retracting to safe_z between passes. safe_z has to clear the
+// top of the stock, which may be well above the highest layer.
+//
+// if rest is given, it's the stock an earlier operation left behind, and only
+// what's left of it is cut: regions with no material above them are skipped,
+// and passes are trimmed to the runs where the tool takes off more than
+// td.tolerance.
+path clear_layers(
+        const std::vector<levelset> &levelsets, const tooldef td,
+        region_clearer clear, const zmap *rest, const float safe_z);
+// appends a polyline to the path. the tool retracts to safe_z and travels
+// over to the start of the polyline first, or for the path's first moves
+// starts out there.
+void append_polyline(
+        path &p, const std::vector<Vector3f> &points, const float safe_z);
+// appends moves to the path the same way, retracting or starting out above
+// the first move first. the first move is where the tool plunges in. arcs are
+// drawn as ARC_DRAW_CHORDS chords per half turn.
+void append_moves(
+        path &p, const std::vector<move> &moves, const float safe_z);
 
 #endif
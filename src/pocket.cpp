@@ -0,0 +1,181 @@
+#include "pocket.h"
+
+#include <cmath>
+#include <stdint.h>
+
+#include "offset.h"
+#include "spatial.h"
+
+using std::vector;
+
+#define NO_NODE (SIZE_MAX)
+
+// one region of tool centers, along with the regions it shrinks into
+struct ringnode {
+    region reg;
+    size_t parent;
+    // children that haven't been cut yet
+    size_t pending;
+    // holes of the region that haven't been cut yet
+    size_t pending_holes;
+};
+
+// a single loop of a ringnode's region: its outer boundary if loop is zero,
+// the hole loop - 1 otherwise
+struct ring {
+    size_t node;
+    size_t loop;
+    bool done;
+};
+
+const polygon &ring_loop(const vector<ringnode> &nodes, const ring &r) {
+    const region &reg = nodes[r.node].reg;
+    return r.loop == 0 ? reg.outer : reg.holes[r.loop - 1];
+}
+
+// appends a closed loop to the passes, starting at its point closest to pos.
+// if that's close enough to pos the loop continues the current pass,
+// otherwise it starts a new one.
+void cut_loop(
+        const polygon &loop, const float z, const float link_dist,
+        bool &has_pos, Vector2f &pos, vector<vector<Vector3f>> &passes) {
+    size_t start = 0;
+    float best = INFINITY;
+    for (size_t i = 0; i < loop.size(); i++) {
+        float dist = (loop[i] - pos).squaredNorm();
+        if (dist < best) {
+            best = dist;
+            start = i;
+        }
+    }
+    if (!has_pos || best > link_dist * link_dist) {
+        passes.push_back(vector<Vector3f>());
+    }
+    vector<Vector3f> &pass = passes.back();
+    for (size_t i = 0; i <= loop.size(); i++) {
+        const Vector2f &p = loop[(start + i) % loop.size()];
+        pass.push_back(Vector3f(p[0], p[1], z));
+    }
+    pos = loop[start];
+    has_pos = true;
+}
+
+void pocket_region(
+        const region &reg, const float z, const float r, const float stepover,
+        const float tolerance, vector<vector<Vector3f>> &passes) {
+    if (stepover <= 0) {
+        return;
+    }
+
+    // shrink level by level, each from the level before it
+    vector<ringnode> nodes;
+    vector<region> shrunk;
+    offset_region(reg, r, tolerance, shrunk);
+    size_t level_start = 0;
+    for (auto s = shrunk.begin(); s != shrunk.end(); s++) {
+        ringnode n;
+        n.reg = *s;
+        n.parent = NO_NODE;
+        n.pending = 0;
+        n.pending_holes = 0;
+        nodes.push_back(n);
+    }
+    while (level_start < nodes.size()) {
+        size_t level_end = nodes.size();
+        for (size_t i = level_start; i < level_end; i++) {
+            shrunk.clear();
+            offset_region(nodes[i].reg, stepover, tolerance, shrunk);
+            for (auto s = shrunk.begin(); s != shrunk.end(); s++) {
+                ringnode n;
+                n.reg.outer.swap(s->outer);
+                n.reg.holes.swap(s->holes);
+                n.parent = i;
+                n.pending = 0;
+                n.pending_holes = 0;
+                nodes.push_back(n);
+            }
+        }
+        level_start = level_end;
+    }
+    if (nodes.empty()) {
+        return;
+    }
+
+    size_t roots = 0;
+    vector<ring> rings;
+    pointgrid grid(stepover);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        ringnode &n = nodes[i];
+        n.pending_holes = n.reg.holes.size();
+        if (n.parent == NO_NODE) {
+            roots++;
+        } else {
+            nodes[n.parent].pending++;
+        }
+        for (size_t l = 0; l <= n.reg.holes.size(); l++) {
+            ring rg;
+            rg.node = i;
+            rg.loop = l;
+            rg.done = false;
+            const polygon &loop = ring_loop(nodes, rg);
+            for (auto p = loop.begin(); p != loop.end(); p++) {
+                grid.insert(*p, rings.size());
+            }
+            rings.push_back(rg);
+        }
+    }
+
+    // walk the tree from the outside in, always moving on to the nearest ring
+    // we're allowed to cut next: first the holes of the region we're in, then
+    // the regions inside it. once a region has nothing left inside it, we
+    // back out to its parent.
+    const float link_dist = 1.5 * stepover;
+    Vector2f pos = nodes[0].reg.outer[0];
+    bool has_pos = false;
+    size_t at = NO_NODE;
+    while (true) {
+        size_t &pending = at == NO_NODE ? roots : nodes[at].pending;
+        if (pending == 0) {
+            if (at == NO_NODE) {
+                break;
+            }
+            at = nodes[at].parent;
+            continue;
+        }
+
+        uint32_t next = 0;
+        grid.nearest(pos, INFINITY, [&](uint32_t id) {
+            return !rings[id].done && rings[id].loop == 0
+                && nodes[rings[id].node].parent == at;
+        }, next);
+        pending--;
+        at = rings[next].node;
+        rings[next].done = true;
+        cut_loop(
+                ring_loop(nodes, rings[next]), z, link_dist, has_pos, pos,
+                passes);
+
+        while (nodes[at].pending_holes > 0) {
+            uint32_t hole = 0;
+            grid.nearest(pos, INFINITY, [&](uint32_t id) {
+                return !rings[id].done && rings[id].node == at;
+            }, hole);
+            nodes[at].pending_holes--;
+            rings[hole].done = true;
+            cut_loop(
+                    ring_loop(nodes, rings[hole]), z, link_dist, has_pos, pos,
+                    passes);
+        }
+    }
+}
+
+path pocket_clear(
+        const vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest) {
+    return clear_layers(levelsets, td, [](
+                const region &reg, const float z, const tooldef td,
+                vector<vector<Vector3f>> &passes) {
+        pocket_region(
+                reg, z, td.r, td.stepover * 2 * td.r, td.tolerance, passes);
+    }, rest, safe_height(levelsets, td));
+}
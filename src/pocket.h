@@ -0,0 +1,36 @@
+#ifndef __TP_POCKET_H__
+#define __TP_POCKET_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "path.h"
+#include "polygon.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// computes contour-parallel passes that clear a region at height z with a tool
+// of radius r. the region is shrunk by r for the first ring of tool centers,
+// and every further ring is the previous one shrunk by stepover, until nothing
+// is left. each offset starts from the previous ring rather than from the
+// region, so every level only costs one offset of a boundary that's already
+// been cleaned up.
+//
+// rings are cut from the outside in. after each ring, the tool moves on to the
+// nearest ring inside it, found with a grid over the rings' points; rings
+// close enough to step over to directly are linked into one pass, and
+// finished passes are appended to passes.
+void pocket_region(
+        const region &reg, const float z, const float r, const float stepover,
+        const float tolerance, std::vector<std::vector<Vector3f>> &passes);
+
+// clears every region of every layer with contour-parallel passes, working
+// from the top layer down. if rest is given, only what's left of that stock
+// is cut.
+path pocket_clear(
+        const std::vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest);
+
+#endif
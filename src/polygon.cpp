@@ -0,0 +1,187 @@
+#include "polygon.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "predicates.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+float signed_area(const polygon &p) {
+    double area = 0;
+    for (size_t i = 0, j = p.size() - 1; i < p.size(); j = i++) {
+        area += (double) p[j][0] * p[i][1] - (double) p[i][0] * p[j][1];
+    }
+    return area / 2;
+}
+
+bool point_in_polygon(const Vector2f &pt, const polygon &p) {
+    bool inside = false;
+    for (size_t i = 0, j = p.size() - 1; i < p.size(); j = i++) {
+        const Vector2f &a = p[j], &b = p[i];
+        // the ray going right from pt crosses the edge if pt is on the
+        // edge's left going up, or on its right going down
+        if ((a[1] > pt[1]) != (b[1] > pt[1])
+                && orient2d(a, b, pt) == (b[1] > a[1] ? 1 : -1)) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+float point_segment_distance2(
+        const Vector2f &p, const Vector2f &a, const Vector2f &b) {
+    Vector2f d = b - a;
+    float len2 = d.squaredNorm();
+    float t = len2 > 0 ? (p - a).dot(d) / len2 : 0;
+    t = max(0.f, min(1.f, t));
+    return (a + t * d - p).squaredNorm();
+}
+
+// squared distance between the segments p-q and a-b
+float segment_distance2(
+        const Vector2f &p, const Vector2f &q,
+        const Vector2f &a, const Vector2f &b) {
+    Vector2f pq = q - p, ab = b - a;
+    float d1 = pq[0] * (a[1] - p[1]) - pq[1] * (a[0] - p[0]);
+    float d2 = pq[0] * (b[1] - p[1]) - pq[1] * (b[0] - p[0]);
+    float d3 = ab[0] * (p[1] - a[1]) - ab[1] * (p[0] - a[0]);
+    float d4 = ab[0] * (q[1] - a[1]) - ab[1] * (q[0] - a[0]);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0))
+            && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+        return 0;
+    }
+    return min(
+            min(point_segment_distance2(p, a, b),
+                point_segment_distance2(q, a, b)),
+            min(point_segment_distance2(a, p, q),
+                point_segment_distance2(b, p, q)));
+}
+
+// narrows the interval (lo, hi) to the values of x for which
+// min_v < k * x + c < max_v. returns false if the result is empty.
+bool clip_linear(
+        const float k, const float c, const float min_v, const float max_v,
+        float &lo, float &hi) {
+    if (k == 0) {
+        return min_v < c && c < max_v;
+    }
+    float x0 = (min_v - c) / k, x1 = (max_v - c) / k;
+    if (k < 0) {
+        std::swap(x0, x1);
+    }
+    lo = max(lo, x0);
+    hi = min(hi, x1);
+    return lo < hi;
+}
+
+bool capsule_span(
+        const Vector2f &a, const Vector2f &b, const float y, const float r,
+        span &out) {
+    bool found = false;
+    out.lo = INFINITY;
+    out.hi = -INFINITY;
+
+    // the discs around both end points
+    const Vector2f *ends[2] = { &a, &b };
+    for (int i = 0; i < 2; i++) {
+        float dy = y - (*ends[i])[1];
+        if (fabs(dy) < r) {
+            float w = sqrt(r * r - dy * dy);
+            out.lo = min(out.lo, (*ends[i])[0] - w);
+            out.hi = max(out.hi, (*ends[i])[0] + w);
+            found = true;
+        }
+    }
+
+    // the band along the segment: points that project onto the segment and
+    // are closer than r to the line through it
+    Vector2f d = b - a;
+    float len2 = d.squaredNorm();
+    if (len2 > 0) {
+        float lo = -INFINITY, hi = INFINITY;
+        float reach = r * sqrt(len2);
+        if (clip_linear(
+                    d[0], d[1] * (y - a[1]) - d[0] * a[0], 0, len2, lo, hi)
+                && clip_linear(
+                    -d[1], d[0] * (y - a[1]) + d[1] * a[0], -reach, reach,
+                    lo, hi)) {
+            out.lo = min(out.lo, lo);
+            out.hi = max(out.hi, hi);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void perimeter_polygons(const levelset &ls, vector<polygon> &out) {
+    for (size_t i = 0; i < ls.perimeter_count(); i++) {
+        layerlist<uint32_t> perim = ls.perimeter(i);
+        if (perim.size() < 4 || perim.front() != perim.back()) {
+            continue;
+        }
+        polygon p;
+        for (auto v = perim.begin(); v + 1 != perim.end(); v++) {
+            p.push_back(ls.point(*v));
+        }
+        out.push_back(p);
+    }
+}
+
+void find_regions(const vector<polygon> &loops, vector<region> &out) {
+    vector<float> areas;
+    vector<size_t> order;
+    for (size_t i = 0; i < loops.size(); i++) {
+        // a loop with a point that isn't a number has no area to speak of,
+        // and comparing it would throw the sort off
+        float area = fabs(signed_area(loops[i]));
+        areas.push_back(area > 0 ? area : 0);
+        order.push_back(i);
+    }
+    // a loop can only be inside loops larger than itself, so walking them
+    // from largest to smallest means every parent is placed before its
+    // children.
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return areas[a] > areas[b];
+    });
+
+    vector<int> depth(loops.size(), 0);
+    vector<int> region_of(loops.size(), -1);
+    // loops with no area enclose nothing, so they're left out, and can't be
+    // anyone's parent either
+    vector<bool> skipped(loops.size(), false);
+    for (size_t oi = 0; oi < order.size(); oi++) {
+        size_t i = order[oi];
+        if (loops[i].empty() || areas[i] == 0) {
+            skipped[i] = true;
+            continue;
+        }
+        // the smallest loop containing this one is its parent
+        int parent = -1;
+        for (size_t oj = 0; oj < oi; oj++) {
+            size_t j = order[oj];
+            if (!skipped[j] && point_in_polygon(loops[i][0], loops[j])) {
+                parent = j;
+            }
+        }
+        depth[i] = parent == -1 ? 0 : depth[parent] + 1;
+
+        polygon p = loops[i];
+        bool ccw = signed_area(p) > 0;
+        if (depth[i] % 2 == 0) {
+            if (!ccw) {
+                std::reverse(p.begin(), p.end());
+            }
+            region_of[i] = out.size();
+            out.push_back(region());
+            out.back().outer.swap(p);
+        } else {
+            if (ccw) {
+                std::reverse(p.begin(), p.end());
+            }
+            out[region_of[parent]].holes.push_back(p);
+        }
+    }
+}
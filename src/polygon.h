@@ -0,0 +1,52 @@
+#ifndef __TP_POLYGON_H__
+#define __TP_POLYGON_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "slice.h"
+
+using namespace Eigen;
+
+// a closed loop in the xy-plane. the last point connects back to the first
+// one; it isn't repeated.
+typedef std::vector<Vector2f> polygon;
+
+// a connected area of a layer: an outer boundary and the holes inside it.
+class region {
+    public:
+        // counterclockwise outer boundary
+        polygon outer;
+        // clockwise boundaries of the holes in the region
+        std::vector<polygon> holes;
+};
+
+// a span of x on a single horizontal line
+struct span {
+    float lo, hi;
+};
+
+// positive for counterclockwise polygons, negative for clockwise ones
+float signed_area(const polygon &p);
+// even-odd point in polygon test, exact for points off the polygon's edges
+bool point_in_polygon(const Vector2f &pt, const polygon &p);
+// squared distance between the point p and the segment from a to b
+float point_segment_distance2(
+        const Vector2f &p, const Vector2f &a, const Vector2f &b);
+// squared distance between the segments p-q and a-b
+float segment_distance2(
+        const Vector2f &p, const Vector2f &q,
+        const Vector2f &a, const Vector2f &b);
+// finds the open interval of x on the line at height y where points are closer
+// than r to the segment between a and b. returns false if there are none.
+bool capsule_span(
+        const Vector2f &a, const Vector2f &b, const float y, const float r,
+        span &out);
+// the closed perimeters of a levelset as polygons. open perimeters are skipped.
+void perimeter_polygons(const levelset &ls, std::vector<polygon> &out);
+// groups loops into regions by how deeply they nest: loops inside an even
+// number of other loops are outer boundaries, and the loops directly inside
+// those are their holes. loops are reoriented to match the region convention.
+void find_regions(const std::vector<polygon> &loops, std::vector<region> &out);
+
+#endif
@@ -0,0 +1,64 @@
+#include "predicates.h"
+
+#include <cfloat>
+#include <cmath>
+
+// relative error of the double precision orientation, from Shewchuk's
+// "adaptive precision floating-point arithmetic and fast robust geometric
+// predicates": (3 + 16 eps) eps, with eps half a unit in the last place
+#define ORIENT_ERROR_BOUND ((3 + 8 * DBL_EPSILON) * DBL_EPSILON / 2)
+
+// a + b as hi + lo exactly, where hi is a + b rounded
+void two_sum(const double a, const double b, double &hi, double &lo) {
+    hi = a + b;
+    double b_virtual = hi - a, a_virtual = hi - b_virtual;
+    lo = (a - a_virtual) + (b - b_virtual);
+}
+
+// adds a double to an expansion, keeping its parts non-overlapping and in
+// increasing order of magnitude and dropping the ones that come out zero.
+// returns the new length, which is at most one more than the old one.
+int grow_expansion(double *e, const int n, const double b) {
+    int kept = 0;
+    double q = b;
+    for (int i = 0; i < n; i++) {
+        double hi, lo;
+        two_sum(q, e[i], hi, lo);
+        if (lo != 0) {
+            e[kept++] = lo;
+        }
+        q = hi;
+    }
+    if (q != 0) {
+        e[kept++] = q;
+    }
+    return kept;
+}
+
+int orient2d(const Vector2f &a, const Vector2f &b, const Vector2f &c) {
+    double left = ((double) a[0] - c[0]) * ((double) b[1] - c[1]),
+           right = ((double) a[1] - c[1]) * ((double) b[0] - c[0]),
+           det = left - right;
+    // if the two products have different signs, their difference can't
+    // change sign however they're rounded
+    if ((left > 0 && right <= 0) || (left < 0 && right >= 0)) {
+        return (det > 0) - (det < 0);
+    }
+    if (fabs(det) > ORIENT_ERROR_BOUND * fabs(left + right)) {
+        return (det > 0) - (det < 0);
+    }
+
+    // the product of two floats fits exactly in a double, so the determinant
+    // expanded into its six products is a sum the expansion gets exactly
+    double terms[6] = {
+        (double) a[0] * b[1], -(double) a[0] * c[1],
+        (double) b[0] * c[1], -(double) b[0] * a[1],
+        (double) c[0] * a[1], -(double) c[0] * b[1]};
+    double e[7];
+    int n = 0;
+    for (int i = 0; i < 6; i++) {
+        n = grow_expansion(e, n, terms[i]);
+    }
+    // the largest part decides the sign
+    return n == 0 ? 0 : e[n - 1] > 0 ? 1 : -1;
+}
@@ -0,0 +1,35 @@
+#ifndef __TP_PREDICATES_H__
+#define __TP_PREDICATES_H__
+
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+// exact geometric predicates on float coordinates. the answers are worked out
+// in double precision first, and only when the rounding error in that could
+// have flipped the sign (which Shewchuk's static error bound tells us) are
+// they recomputed exactly, as a sum of doubles kept as an expansion: a list of
+// non-overlapping parts that add up to the exact value.
+
+// which way the triangle a b c turns: 1 if it's counterclockwise, -1 if it's
+// clockwise, and 0 only if the points are exactly collinear
+int orient2d(const Vector2f &a, const Vector2f &b, const Vector2f &c);
+
+// which side of the horizontal plane at height z a point at height h is on:
+// 1 above, -1 below. points exactly on the plane are treated as below it, as
+// if the plane were an infinitesimal distance higher (a simulation of
+// simplicity), so nothing is ever in it: every face either misses the plane
+// or crosses it along exactly two of its edges, all the faces around a vertex
+// on the plane agree on which side it's on, and a layer is the cross-section
+// of the mesh just above its height.
+inline int layer_side(const float h, const float z) {
+    return h > z ? 1 : -1;
+}
+
+// whether a point at height h is exactly on the plane at height z: one of
+// the points layer_side puts below the plane that isn't any further down
+inline bool on_layer_plane(const float h, const float z) {
+    return layer_side(h, z) < 0 && !(h < z);
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "raster.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+using std::vector;
+
+// an edge of the region boundary as seen by the scanline sweep
+struct scanedge {
+    Vector2f a, b;
+    float ymin, ymax;
+};
+
+// a zigzag pass that is still being extended by the sweep
+struct rasterchain {
+    vector<Vector3f> points;
+    // extent of the segment on the last scanline the chain covered
+    float lo, hi;
+    // whether that segment was traversed in the direction of increasing x
+    bool rightward;
+};
+
+void raster_region(
+        const region &reg, const float z, const float r, const float stepover,
+        vector<vector<Vector3f>> &passes) {
+    if (reg.outer.size() < 3 || stepover <= 0) {
+        return;
+    }
+
+    vector<scanedge> edges;
+    float ymin = INFINITY, ymax = -INFINITY;
+    for (size_t l = 0; l <= reg.holes.size(); l++) {
+        const polygon &loop = l == 0 ? reg.outer : reg.holes[l - 1];
+        for (size_t i = 0, j = loop.size() - 1; i < loop.size(); j = i++) {
+            scanedge e;
+            e.a = loop[j];
+            e.b = loop[i];
+            e.ymin = min(e.a[1], e.b[1]);
+            e.ymax = max(e.a[1], e.b[1]);
+            edges.push_back(e);
+            ymin = min(ymin, e.ymin);
+            ymax = max(ymax, e.ymax);
+        }
+    }
+
+    // edges enter the active table once the scanline comes within r of them
+    vector<size_t> by_start;
+    for (size_t i = 0; i < edges.size(); i++) {
+        by_start.push_back(i);
+    }
+    std::sort(by_start.begin(), by_start.end(), [&](size_t a, size_t b) {
+        return edges[a].ymin < edges[b].ymin;
+    });
+
+    // the first and last scanlines sit exactly r inside the region, nudged
+    // slightly inwards so they aren't lost to rounding
+    const float eps = 1e-4 * r;
+    const float y_first = ymin + r + eps, y_last = ymax - r - eps;
+    if (y_first > y_last) {
+        return;
+    }
+    size_t lines = (size_t) floor((y_last - y_first) / stepover) + 1;
+    if (y_first + (lines - 1) * stepover < y_last - eps) {
+        lines++;
+    }
+
+    vector<size_t> active;
+    size_t next_edge = 0;
+    vector<float> crossings;
+    vector<span> forbidden, segments;
+    vector<rasterchain> open, still_open;
+
+    for (size_t line = 0; line < lines; line++) {
+        float y = min(y_first + line * stepover, y_last);
+
+        while (next_edge < by_start.size()
+                && edges[by_start[next_edge]].ymin - r <= y) {
+            active.push_back(by_start[next_edge++]);
+        }
+
+        // where the scanline is inside the region, by even-odd crossings
+        crossings.clear();
+        forbidden.clear();
+        for (auto ei = active.begin(); ei != active.end(); ei++) {
+            const scanedge &e = edges[*ei];
+            if (e.ymin <= y && y < e.ymax) {
+                crossings.push_back(e.a[0] + (y - e.a[1])
+                        * (e.b[0] - e.a[0]) / (e.b[1] - e.a[1]));
+            }
+            span s;
+            if (capsule_span(e.a, e.b, y, r, s)) {
+                forbidden.push_back(s);
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        std::sort(forbidden.begin(), forbidden.end(),
+                [](const span &a, const span &b) { return a.lo < b.lo; });
+
+        // the tool center can go wherever the scanline is inside the region
+        // and not within r of an edge
+        segments.clear();
+        size_t f = 0;
+        for (size_t c = 0; c + 1 < crossings.size(); c += 2) {
+            float cur = crossings[c], end = crossings[c + 1];
+            while (f < forbidden.size() && forbidden[f].hi <= cur) {
+                f++;
+            }
+            for (size_t g = f; g < forbidden.size() && cur < end; g++) {
+                if (forbidden[g].lo >= end) {
+                    break;
+                }
+                if (forbidden[g].lo > cur) {
+                    span s = { cur, forbidden[g].lo };
+                    segments.push_back(s);
+                }
+                cur = max(cur, forbidden[g].hi);
+            }
+            if (cur < end) {
+                span s = { cur, end };
+                segments.push_back(s);
+            }
+        }
+
+        // link each segment to the chain from the previous scanline that
+        // overlaps it, if the tool can step over without touching an edge.
+        // both lists are in increasing x, so a single merge pass does it.
+        still_open.clear();
+        size_t ci = 0;
+        for (auto s = segments.begin(); s != segments.end(); s++) {
+            if (s->hi - s->lo <= eps) {
+                continue;
+            }
+            while (ci < open.size() && open[ci].hi < s->lo) {
+                passes.push_back(vector<Vector3f>());
+                passes.back().swap(open[ci++].points);
+            }
+
+            bool linked = false;
+            if (ci < open.size() && open[ci].lo <= s->hi) {
+                rasterchain &c = open[ci++];
+                const Vector3f &last = c.points.back();
+                Vector2f from(last[0], last[1]);
+                Vector2f to(c.rightward ? s->hi : s->lo, y);
+                float clear2 = (r - eps) * (r - eps);
+                linked = true;
+                for (auto ei = active.begin(); ei != active.end(); ei++) {
+                    const scanedge &e = edges[*ei];
+                    if (segment_distance2(from, to, e.a, e.b) < clear2) {
+                        linked = false;
+                        break;
+                    }
+                }
+                if (linked) {
+                    c.rightward = !c.rightward;
+                    c.points.push_back(Vector3f(to[0], y, z));
+                    c.points.push_back(Vector3f(
+                                c.rightward ? s->hi : s->lo, y, z));
+                    c.lo = s->lo;
+                    c.hi = s->hi;
+                    still_open.push_back(rasterchain());
+                    still_open.back().points.swap(c.points);
+                    still_open.back().lo = c.lo;
+                    still_open.back().hi = c.hi;
+                    still_open.back().rightward = c.rightward;
+                } else {
+                    passes.push_back(vector<Vector3f>());
+                    passes.back().swap(c.points);
+                }
+            }
+            if (!linked) {
+                rasterchain c;
+                c.lo = s->lo;
+                c.hi = s->hi;
+                c.rightward = true;
+                c.points.push_back(Vector3f(s->lo, y, z));
+                c.points.push_back(Vector3f(s->hi, y, z));
+                still_open.push_back(c);
+            }
+        }
+        for (; ci < open.size(); ci++) {
+            passes.push_back(vector<Vector3f>());
+            passes.back().swap(open[ci].points);
+        }
+        open.swap(still_open);
+
+        // edges further than r below this scanline can't affect it or the
+        // links up to the next one
+        size_t kept = 0;
+        for (size_t i = 0; i < active.size(); i++) {
+            if (edges[active[i]].ymax + r >= y) {
+                active[kept++] = active[i];
+            }
+        }
+        active.resize(kept);
+    }
+
+    for (auto c = open.begin(); c != open.end(); c++) {
+        passes.push_back(vector<Vector3f>());
+        passes.back().swap(c->points);
+    }
+}
+
+path raster_clear(
+        const vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest) {
+    return clear_layers(levelsets, td, [](
+                const region &reg, const float z, const tooldef td,
+                vector<vector<Vector3f>> &passes) {
+        raster_region(reg, z, td.r, td.stepover * 2 * td.r, passes);
+    }, rest, safe_height(levelsets, td));
+}
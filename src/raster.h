@@ -0,0 +1,31 @@
+#ifndef __TP_RASTER_H__
+#define __TP_RASTER_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "path.h"
+#include "polygon.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// computes zigzag passes that clear a region at height z with a tool of radius
+// r, with passes stepover apart. the passes are for the tool center, so they
+// keep a distance of r from every boundary of the region. scanlines are cut
+// into segments with an active edge table over the region's edges sorted by
+// height, and segments on neighbouring scanlines are linked into
+// back-and-forth passes wherever the tool can move between them without
+// touching the boundary. finished passes are appended to passes.
+void raster_region(
+        const region &reg, const float z, const float r, const float stepover,
+        std::vector<std::vector<Vector3f>> &passes);
+
+// clears every region of every layer with zigzag passes, working from the top
+// layer down. if rest is given, only what's left of that stock is cut.
+path raster_clear(
+        const std::vector<levelset> &levelsets, const tooldef td,
+        const zmap *rest);
+
+#endif
@@ -0,0 +1,151 @@
+#include "rest.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+void stock_reach(const zmap &stock, const float r, zmap &out) {
+    out = stock;
+    int k = (int) floor(r / stock.step);
+    parallel_for(stock.ny, [&](size_t j) {
+        float *dst = &out.z[j * stock.nx];
+        std::fill(dst, dst + stock.nx, -INFINITY);
+        vector<float> padded, g, h;
+        for (int dy = -k; dy <= k; dy++) {
+            long sj = (long) j + dy;
+            if (sj < 0 || sj >= (long) stock.ny) {
+                continue;
+            }
+            float off = dy * stock.step;
+            size_t w = (size_t) floor(sqrt(max(0.f, r * r - off * off))
+                    / stock.step);
+            size_t width = 2 * w + 1, n = stock.nx + 2 * w;
+
+            // the row with w columns of nothing on either side, so every
+            // window is exactly width long
+            const float *src = &stock.z[sj * stock.nx];
+            padded.assign(n, -INFINITY);
+            std::copy(src, src + stock.nx, padded.begin() + w);
+
+            // running maxima forwards and backwards within blocks of width;
+            // every window spans the end of one block and the start of the
+            // next
+            g.resize(n);
+            h.resize(n);
+            for (size_t start = 0; start < n; start += width) {
+                size_t end = min(n, start + width);
+                g[start] = padded[start];
+                for (size_t i = start + 1; i < end; i++) {
+                    g[i] = max(g[i - 1], padded[i]);
+                }
+                h[end - 1] = padded[end - 1];
+                for (size_t i = end - 1; i-- > start;) {
+                    h[i] = max(h[i + 1], padded[i]);
+                }
+            }
+            for (size_t i = 0; i < stock.nx; i++) {
+                dst[i] = max(dst[i], max(h[i], g[i + 2 * w]));
+            }
+        }
+    });
+}
+
+// the reach at the columns around p, or -INFINITY off the z-map
+float reach_at(const zmap &reach, const Vector3f &p) {
+    float fx = (p[0] - reach.x0) / reach.step,
+          fy = (p[1] - reach.y0) / reach.step;
+    float best = -INFINITY;
+    for (int dj = 0; dj < 2; dj++) {
+        for (int di = 0; di < 2; di++) {
+            float i = floor(fx) + di, j = floor(fy) + dj;
+            if (i >= 0 && j >= 0 && i < reach.nx && j < reach.ny) {
+                best = max(best, reach.at((uint32_t) i, (uint32_t) j));
+            }
+        }
+    }
+    return best;
+}
+
+bool region_has_rest(
+        const zmap &reach, const region &reg, const float z,
+        const float tolerance) {
+    if (reg.outer.empty()) {
+        return false;
+    }
+    Vector2f lo = reg.outer[0], hi = reg.outer[0];
+    for (auto p = reg.outer.begin(); p != reg.outer.end(); p++) {
+        lo = lo.cwiseMin(*p);
+        hi = hi.cwiseMax(*p);
+    }
+    float i0 = floor((lo[0] - reach.x0) / reach.step),
+          i1 = ceil((hi[0] - reach.x0) / reach.step),
+          j0 = floor((lo[1] - reach.y0) / reach.step),
+          j1 = ceil((hi[1] - reach.y0) / reach.step);
+    i0 = max(0.f, i0);
+    j0 = max(0.f, j0);
+    i1 = min((float) reach.nx - 1, i1);
+    j1 = min((float) reach.ny - 1, j1);
+    for (float j = j0; j <= j1; j++) {
+        for (float i = i0; i <= i1; i++) {
+            if (reach.at((uint32_t) i, (uint32_t) j) > z + tolerance) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void trim_pass(
+        const zmap &reach, const float tolerance, const vector<Vector3f> &pass,
+        vector<vector<Vector3f>> &out) {
+    // runs start one sample before the tool first reaches stock and end one
+    // after it leaves. samples between the pass's own points are on a
+    // straight line, so only the ends of runs are kept from them.
+    vector<Vector3f> run;
+    Vector3f last, pending;
+    bool have_last = false, pushed = false;
+    auto visit = [&](const Vector3f &p, const bool vertex) {
+        if (reach_at(reach, p) > p[2] + tolerance) {
+            bool starting = run.empty();
+            if (starting && have_last) {
+                run.push_back(last);
+            }
+            pushed = vertex || starting;
+            if (pushed) {
+                run.push_back(p);
+            }
+            pending = p;
+        } else if (!run.empty()) {
+            if (!pushed) {
+                run.push_back(pending);
+            }
+            run.push_back(p);
+            out.push_back(run);
+            run.clear();
+        }
+        last = p;
+        have_last = true;
+    };
+
+    for (size_t k = 0; k < pass.size(); k++) {
+        if (k > 0) {
+            Vector3f d = pass[k] - pass[k - 1];
+            int samples = (int) ceil(d.norm() / reach.step);
+            for (int s = 1; s < samples; s++) {
+                visit(pass[k - 1] + d * ((float) s / samples), false);
+            }
+        }
+        visit(pass[k], true);
+    }
+    if (!run.empty()) {
+        if (!pushed) {
+            run.push_back(pending);
+        }
+        out.push_back(run);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef __TP_REST_H__
+#define __TP_REST_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "polygon.h"
+#include "stock.h"
+
+using namespace Eigen;
+
+// rest machining: cutting only what an earlier operation left behind, given
+// the stock it left as a z-map.
+
+// the highest stock within r of every column. a tool of radius r centered
+// over a column can only take material off if its tip is below that. this
+// ignores the shape of the tool's bottom, so it's never lower than the real
+// height the tool would touch the stock at. each row is the maximum of the
+// rows within r of it, each through a sliding window as wide as the disc is
+// at that row, found in constant time per column with running maxima over
+// blocks of the window's width.
+void stock_reach(const zmap &stock, const float r, zmap &out);
+
+// true if there's material more than tolerance above z anywhere in reach of
+// the region's bounding box
+bool region_has_rest(
+        const zmap &reach, const region &reg, const float z,
+        const float tolerance);
+
+// splits a pass at height z into the runs where the tool would take off more
+// than tolerance of the remaining stock, sampling it at the spacing of the
+// z-map's columns, and appends those runs to out.
+void trim_pass(
+        const zmap &reach, const float tolerance,
+        const std::vector<Vector3f> &pass,
+        std::vector<std::vector<Vector3f>> &out);
+
+#endif
@@ -0,0 +1,61 @@
+#include "rough.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "flats.h"
+#include "pocket.h"
+
+using std::pair;
+using std::vector;
+
+path rough(
+        const mesh &m, const tooldef td, slicestats &stats,
+        const zmap *rest) {
+    bounds b = m.get_bounds();
+
+    // heights to slice at, each marked with whether it's a floor
+    halfedges h(m);
+    h.reorder(td.mesh_order);
+    vector<flatarea> flats;
+    find_flat_areas(h, td.tolerance, flats);
+    vector<pair<float, bool>> levels;
+    for (auto flat = flats.begin(); flat != flats.end(); flat++) {
+        if (flat->up) {
+            levels.push_back(pair<float, bool>(flat->z, true));
+        }
+    }
+    for (float z = b.max_z - td.stepdown; z > b.min_z; z -= td.stepdown) {
+        levels.push_back(pair<float, bool>(z, false));
+    }
+    levels.push_back(pair<float, bool>(b.min_z, true));
+    std::sort(levels.begin(), levels.end());
+
+    // a stepdown pass that lands within tolerance of a floor is replaced by
+    // the floor
+    vector<float> heights;
+    bool last_floor = false;
+    for (auto l = levels.begin(); l != levels.end(); l++) {
+        if (!heights.empty() && l->first - heights.back() < td.tolerance) {
+            if (l->second && !last_floor) {
+                heights.back() = l->first;
+                last_floor = true;
+            }
+            continue;
+        }
+        heights.push_back(l->first);
+        last_floor = l->second;
+    }
+
+    vector<levelset> levelsets;
+    slice_at(td, m, heights, levelsets, stats);
+    // the first layer is a stepdown below the top of the part, which the
+    // stock still covers
+    return clear_layers(levelsets, td, [](
+                const region &reg, const float z, const tooldef td,
+                vector<vector<Vector3f>> &passes) {
+        pocket_region(
+                reg, z, td.r + td.stock, td.stepover * 2 * td.r,
+                td.tolerance, passes);
+    }, rest, b.max_z + td.z_accuracy);
+}
@@ -0,0 +1,25 @@
+#ifndef __TP_ROUGH_H__
+#define __TP_ROUGH_H__
+
+#include <vector>
+#include <meshparse/mesh.h>
+
+#include "path.h"
+#include "slice.h"
+#include "stats.h"
+#include "tooldef.h"
+
+using namespace meshparse;
+
+// roughs the mesh out in passes td.stepdown apart, from the top down, plus a
+// pass at every floor, the flat areas of the mesh that face up, so that they
+// are cut to their exact height. the mesh is only sliced at those heights,
+// and the tool retracts above its top between passes. every region of every
+// pass is cleared with contour-parallel rings that stay td.stock further from
+// its boundary than the tool radius, leaving that much for finishing. if rest
+// is given, only what's left of that stock is cut.
+path rough(
+        const mesh &m, const tooldef td, slicestats &stats,
+        const zmap *rest);
+
+#endif
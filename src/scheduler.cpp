@@ -0,0 +1,293 @@
+#include "scheduler.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using std::lock_guard;
+using std::mutex;
+using std::ostream;
+using std::unique_lock;
+using std::chrono::steady_clock;
+
+static size_t configured_threads = 0;
+static bool configured_pin = false;
+
+// the slot of the thread running, set by workers when they start. every other
+// thread shares slot 0.
+static thread_local size_t current_slot = 0;
+
+static uint64_t micros_since(const steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            steady_clock::now() - start).count();
+}
+
+schedstats::schedstats() : threads(0), tasks(0), steals(0), idle_us(0) {}
+
+ostream& operator<< (ostream &out, const schedstats &s) {
+    out << "scheduler: " << s.threads << " threads, " << s.tasks << " tasks, "
+        << s.steals << " steals, " << s.idle_us / 1000 << " ms idle";
+    return out;
+}
+
+scheduler::slot::slot() :
+        size(0), victim(0), tasks_run(0), steals(0), idle_us(0) {}
+
+void scheduler::configure(const size_t threads, const bool pin) {
+    configured_threads = threads;
+    configured_pin = pin;
+}
+
+scheduler& scheduler::get() {
+    static scheduler s(configured_threads, configured_pin);
+    return s;
+}
+
+scheduler::scheduler(const size_t threads, const bool pin) :
+        queued(0), sleeping(0), stopping(false), regions(0), region_us(0) {
+    size_t hardware = std::thread::hardware_concurrency();
+    if (hardware == 0) {
+        hardware = 1;
+    }
+    size_t n = threads == 0 ? hardware : threads;
+    for (size_t i = 0; i < n; i++) {
+        slots.push_back(std::unique_ptr<slot>(new slot()));
+        slots[i]->victim = i + 1;
+    }
+    // slot 0 is the thread that starts the work, which is left to run
+    // wherever it was
+    for (size_t i = 1; i < n; i++) {
+        slots[i]->thread = std::thread([this, i]() { work(i); });
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % hardware, &set);
+            pthread_setaffinity_np(
+                    slots[i]->thread.native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+scheduler::~scheduler() {
+    {
+        lock_guard<mutex> l(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto s = slots.begin(); s != slots.end(); s++) {
+        if ((*s)->thread.joinable()) {
+            (*s)->thread.join();
+        }
+    }
+}
+
+size_t scheduler::threads() const {
+    return slots.size();
+}
+
+schedstats scheduler::stats() const {
+    schedstats st;
+    st.threads = slots.size();
+    for (auto s = slots.begin(); s != slots.end(); s++) {
+        st.tasks += (*s)->tasks_run;
+        st.steals += (*s)->steals;
+        st.idle_us += (*s)->idle_us;
+    }
+    return st;
+}
+
+size_t scheduler::self() const {
+    return current_slot < slots.size() ? current_slot : 0;
+}
+
+bool scheduler::local_work() const {
+    return slots[self()]->size.load(std::memory_order_relaxed) > 0;
+}
+
+void scheduler::push(task &t) {
+    slot &s = *slots[self()];
+    {
+        lock_guard<mutex> l(s.lock);
+        s.tasks.push_back(std::move(t));
+        s.size = s.tasks.size();
+    }
+    // a worker going to sleep counts itself before checking queued, and this
+    // counts the task before checking sleeping, so one of them always sees
+    // the other
+    queued++;
+    if (sleeping > 0) {
+        lock_guard<mutex> l(sleep_lock);
+        wake.notify_one();
+    }
+}
+
+bool scheduler::run_one() {
+    size_t me = self();
+    slot &own = *slots[me];
+    task t;
+    bool found = false;
+    if (own.size.load(std::memory_order_relaxed) > 0) {
+        lock_guard<mutex> l(own.lock);
+        if (!own.tasks.empty()) {
+            t = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            own.size = own.tasks.size();
+            found = true;
+        }
+    }
+    size_t n = slots.size(), start = own.victim++;
+    for (size_t i = 0; i < n && !found; i++) {
+        size_t v = (start + i) % n;
+        if (v == me) {
+            continue;
+        }
+        slot &victim = *slots[v];
+        if (victim.size.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        lock_guard<mutex> l(victim.lock);
+        if (!victim.tasks.empty()) {
+            t = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            victim.size = victim.tasks.size();
+            found = true;
+            own.steals++;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    queued--;
+    execute(me, t);
+    return true;
+}
+
+void scheduler::execute(const size_t s, task &t) {
+    task_group *g = t.group;
+    if (!g->cancelled()) {
+        try {
+            t.fn();
+        } catch (...) {
+            {
+                lock_guard<mutex> l(g->error_lock);
+                if (!g->error) {
+                    g->error = std::current_exception();
+                }
+            }
+            g->cancel();
+        }
+    }
+    slots[s]->tasks_run++;
+    // the group may be gone as soon as its count drops, so the task has to
+    // let go of everything it captured first
+    t.fn = nullptr;
+    if (--g->pending == 0) {
+        end_region();
+    }
+}
+
+void scheduler::begin_region() {
+    lock_guard<mutex> l(region_lock);
+    if (regions++ == 0) {
+        region_start = steady_clock::now();
+    }
+}
+
+void scheduler::end_region() {
+    lock_guard<mutex> l(region_lock);
+    if (--regions == 0) {
+        region_us += micros_since(region_start);
+    }
+}
+
+uint64_t scheduler::region_time() {
+    lock_guard<mutex> l(region_lock);
+    return region_us + (regions > 0 ? micros_since(region_start) : 0);
+}
+
+void scheduler::work(const size_t s) {
+    current_slot = s;
+    while (true) {
+        if (run_one()) {
+            continue;
+        }
+        // a worker asleep between parallel stages has nothing it could be
+        // doing, so only the time some group was unfinished counts as idle
+        uint64_t start = region_time();
+        unique_lock<mutex> l(sleep_lock);
+        sleeping++;
+        while (queued == 0 && !stopping) {
+            wake.wait(l);
+        }
+        sleeping--;
+        slots[s]->idle_us += region_time() - start;
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+task_group::task_group() :
+        sched(scheduler::get()), pending(0), stop(false) {}
+
+task_group::~task_group() {
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void task_group::run(std::function<void()> fn) {
+    scheduler::task t;
+    t.fn = std::move(fn);
+    t.group = this;
+    if (pending++ == 0) {
+        sched.begin_region();
+    }
+    sched.push(t);
+}
+
+void task_group::wait() {
+    steady_clock::time_point start;
+    bool idle = false;
+    while (pending > 0) {
+        if (sched.run_one()) {
+            if (idle) {
+                sched.slots[sched.self()]->idle_us += micros_since(start);
+                idle = false;
+            }
+            continue;
+        }
+        // what's left is running on other threads
+        if (!idle) {
+            start = steady_clock::now();
+            idle = true;
+        }
+        std::this_thread::yield();
+    }
+    if (idle) {
+        sched.slots[sched.self()]->idle_us += micros_since(start);
+    }
+    std::exception_ptr e;
+    {
+        lock_guard<mutex> l(error_lock);
+        e = error;
+        error = nullptr;
+    }
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+void task_group::cancel() {
+    stop = true;
+}
+
+bool task_group::cancelled() const {
+    return stop;
+}
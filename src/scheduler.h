@@ -0,0 +1,154 @@
+#ifndef __TP_SCHEDULER_H__
+#define __TP_SCHEDULER_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class task_group;
+
+// counters the scheduler keeps from the moment it starts, printed once a run
+// is done
+class schedstats {
+    public:
+        schedstats();
+
+        friend std::ostream& operator<< (
+                std::ostream &out, const schedstats &s);
+
+        // threads running tasks, counting the one that waits on them
+        size_t threads;
+        // tasks run, and how many of them were taken from another thread's
+        // deque
+        uint64_t tasks;
+        uint64_t steals;
+        // time threads spent with nothing to run while there were tasks
+        // left to finish elsewhere, summed over all of them. the time
+        // between parallel stages doesn't count.
+        uint64_t idle_us;
+};
+
+// a pool of threads shared by every parallel stage, so no stage starts
+// threads of its own and there are never more running than configured.
+// every thread has a deque of tasks: it pushes and pops its own at the back,
+// newest first, and a thread with nothing to do steals from the front of
+// someone else's, taking the oldest and usually biggest piece of work. the
+// thread that started the work is one of them: waiting on a task group runs
+// tasks until the group is done, so groups can be waited on from inside a
+// task.
+class scheduler {
+    public:
+        // sets how many threads run tasks, or one per hardware thread for 0,
+        // and whether every worker is pinned to a core of its own. only has
+        // an effect before the scheduler is first used.
+        static void configure(const size_t threads, const bool pin);
+        // the shared scheduler, started on first use
+        static scheduler& get();
+
+        ~scheduler();
+
+        size_t threads() const;
+        schedstats stats() const;
+
+        // whether the calling thread has tasks waiting in its own deque.
+        // work that can be split only needs to split when it hasn't, since
+        // nobody has stolen the last piece it split off yet.
+        bool local_work() const;
+
+    private:
+        friend class task_group;
+
+        struct task {
+            std::function<void()> fn;
+            task_group *group;
+        };
+
+        // a thread's deque and counters. slot 0 belongs to whichever threads
+        // aren't workers, like the main one.
+        struct slot {
+            slot();
+
+            std::mutex lock;
+            std::deque<task> tasks;
+            std::atomic<size_t> size;
+            std::thread thread;
+            // where stealing starts looking, moved on after every look
+            std::atomic<size_t> victim;
+            std::atomic<uint64_t> tasks_run;
+            std::atomic<uint64_t> steals;
+            std::atomic<uint64_t> idle_us;
+        };
+
+        scheduler(const size_t threads, const bool pin);
+        scheduler(const scheduler &other);
+        scheduler& operator= (const scheduler &other);
+
+        // the calling thread's slot
+        size_t self() const;
+        void push(task &t);
+        // takes a task from the calling thread's own deque, or failing that
+        // steals one, and runs it. returns false if there was nothing to run.
+        bool run_one();
+        void execute(const size_t s, task &t);
+        // a worker's loop, running tasks and sleeping when there are none
+        void work(const size_t s);
+        // note a task group getting its first task or finishing its last
+        void begin_region();
+        void end_region();
+        // microseconds spent with some task group unfinished since the
+        // scheduler started, which is the only time idling counts for
+        uint64_t region_time();
+
+        std::vector<std::unique_ptr<slot>> slots;
+        // tasks in all the deques
+        std::atomic<size_t> queued;
+        std::atomic<size_t> sleeping;
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+        bool stopping;
+        // task groups with tasks not yet finished, when the first of them
+        // got its tasks, and the time spent with any before that
+        std::mutex region_lock;
+        size_t regions;
+        std::chrono::steady_clock::time_point region_start;
+        uint64_t region_us;
+};
+
+// tasks that can be waited on together. cancelling the group skips its tasks
+// that haven't started yet; the first one to throw cancels it too, and wait
+// throws the same exception once the rest are done.
+class task_group {
+    public:
+        task_group();
+        // waits for the tasks still running, since they may use anything
+        // the creator had on its stack
+        ~task_group();
+
+        void run(std::function<void()> fn);
+        void wait();
+        void cancel();
+        bool cancelled() const;
+
+    private:
+        friend class scheduler;
+
+        task_group(const task_group &other);
+        task_group& operator= (const task_group &other);
+
+        scheduler &sched;
+        std::atomic<size_t> pending;
+        std::atomic<bool> stop;
+        std::mutex error_lock;
+        std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <utility>
+
+using std::pair;
+using std::vector;
+
+// fills dist with the squared distance of points first + 1 to last - 1 from
+// the segment from first to last, scaled by the squared length of the
+// segment, so the loop is a straight run of multiply-adds and selects with no
+// division and vectorizes. points whose projection falls past either end are
+// measured from that end, so a spike doubling back along the line isn't
+// mistaken for a point on it. returns the scale to compare the results
+// against.
+float scaled_distances(
+        const vector<float> &xs, const vector<float> &ys,
+        const size_t first, const size_t last, vector<float> &dist) {
+    const float x0 = xs[first], y0 = ys[first];
+    const float dx = xs[last] - x0, dy = ys[last] - y0;
+    const float len2 = dx * dx + dy * dy;
+    const size_t n = last - first - 1;
+    const float *x = &xs[first + 1], *y = &ys[first + 1];
+
+    dist.resize(n);
+    float *d = dist.data();
+    if (len2 == 0) {
+        // closed perimeters start and end on the same point; measure from it
+        for (size_t i = 0; i < n; i++) {
+            float px = x[i] - x0, py = y[i] - y0;
+            d[i] = px * px + py * py;
+        }
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        float px = x[i] - x0, py = y[i] - y0;
+        float qx = px - dx, qy = py - dy;
+        float along = dx * px + dy * py;
+        float c = dx * py - dy * px;
+        float before = (px * px + py * py) * len2;
+        float after = (qx * qx + qy * qy) * len2;
+        d[i] = along < 0 ? before : along > len2 ? after : c * c;
+    }
+    return len2;
+}
+
+void douglas_peucker(
+        const vector<float> &xs, const vector<float> &ys,
+        const float tolerance, vector<bool> &keep) {
+    size_t n = xs.size();
+    keep.assign(n, false);
+    if (n == 0) {
+        return;
+    }
+    keep[0] = true;
+    keep[n - 1] = true;
+
+    // ranges still to be split, handled with an explicit stack rather than
+    // recursion so long perimeters can't blow the call stack. the buffers are
+    // kept for the thread's next call, so they rarely need to grow.
+    static thread_local vector<pair<size_t, size_t>> ranges;
+    static thread_local vector<float> dist;
+    ranges.clear();
+    const float tol2 = tolerance * tolerance;
+    if (n > 2) {
+        ranges.push_back(pair<size_t, size_t>(0, n - 1));
+    }
+    while (!ranges.empty()) {
+        pair<size_t, size_t> r = ranges.back();
+        ranges.pop_back();
+
+        float scale = scaled_distances(xs, ys, r.first, r.second, dist);
+        auto far = std::max_element(dist.begin(), dist.end());
+        if (*far <= tol2 * scale) {
+            continue;
+        }
+
+        size_t split = r.first + 1 + (far - dist.begin());
+        keep[split] = true;
+        if (split - r.first > 1) {
+            ranges.push_back(pair<size_t, size_t>(r.first, split));
+        }
+        if (r.second - split > 1) {
+            ranges.push_back(pair<size_t, size_t>(split, r.second));
+        }
+    }
+}
+
+size_t simplify_perimeters(levelset &ls, const float tolerance) {
+    size_t before = ls.perimeter_verteces.size();
+    // buffers kept for the thread's next layer, so they rarely need to grow
+    static thread_local vector<float> xs, ys;
+    static thread_local vector<bool> keep;
+    static thread_local vector<int64_t> remap;
+    remap.assign(ls.verteces.size(), -1);
+
+    // the kept verteces are moved down over the dropped ones, so everything
+    // is simplified in place, in the layer's own lists
+    uint32_t out = 0;
+    for (size_t p = 0; p < ls.perimeter_count(); p++) {
+        uint32_t first = ls.perimeter_starts[p],
+                 last = ls.perimeter_starts[p + 1];
+        xs.clear();
+        ys.clear();
+        for (uint32_t i = first; i < last; i++) {
+            xs.push_back(ls.verteces[ls.perimeter_verteces[i]][0]);
+            ys.push_back(ls.verteces[ls.perimeter_verteces[i]][1]);
+        }
+        douglas_peucker(xs, ys, tolerance, keep);
+
+        ls.perimeter_starts[p] = out;
+        for (uint32_t i = first; i < last; i++) {
+            if (!keep[i - first]) {
+                continue;
+            }
+            uint32_t v = ls.perimeter_verteces[i];
+            remap[v] = 0;
+            ls.perimeter_verteces[out++] = v;
+        }
+    }
+    if (!ls.perimeter_starts.empty()) {
+        ls.perimeter_starts.back() = out;
+    }
+    ls.perimeter_verteces.shrink(out);
+
+    // the verteces still in use keep their order, so each moves down to a
+    // place that's already been dealt with
+    uint32_t used = 0;
+    for (uint32_t v = 0; v < ls.verteces.size(); v++) {
+        if (remap[v] == -1) {
+            continue;
+        }
+        remap[v] = used;
+        ls.verteces[used++] = ls.verteces[v];
+    }
+    ls.verteces.shrink(used);
+    for (auto v = ls.perimeter_verteces.begin();
+            v != ls.perimeter_verteces.end(); v++) {
+        *v = remap[*v];
+    }
+    return before;
+}
@@ -0,0 +1,22 @@
+#ifndef __TP_SIMPLIFY_H__
+#define __TP_SIMPLIFY_H__
+
+#include <vector>
+#include <stdint.h>
+
+#include "slice.h"
+
+// runs Douglas-Peucker over a single perimeter: keep[i] is set for every
+// point that has to stay so that no dropped point is further than tolerance
+// from the segment of the simplified polyline that replaced it. xs and ys
+// hold the perimeter's coordinates.
+void douglas_peucker(
+        const std::vector<float> &xs, const std::vector<float> &ys,
+        const float tolerance, std::vector<bool> &keep);
+
+// drops perimeter verteces that lie within tolerance of the simplified
+// perimeter and compacts the levelset's vertex list to the verteces still in
+// use. returns the number of perimeter verteces before simplification.
+size_t simplify_perimeters(levelset &ls, const float tolerance);
+
+#endif
@@ -1,131 +1,93 @@
 #include "slice.h"
 
-#include <cstdio>
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <new>
 #include <stdint.h>
 
-#include <Eigen/Sparse>
+#include "arena.h"
+#include "parallel.h"
+#include "predicates.h"
+#include "simplify.h"
+#include "spatial.h"
 
 using namespace Eigen;
 
-using std::cout;
-using std::endl;
 using std::map;
 using std::ostream;
 using std::pair;
 using std::vector;
 
-void debug_print_sparse(const SparseMatrix<uint8_t> &mat) {
-    for (int i = 0; i < mat.cols(); i++) {
-        cout << "\t" << i;
-    }
-    cout << endl;
-    for (int i = 0; i < mat.rows(); i++) {
-        cout << i << ":\t";
-        for (int j = 0; j < mat.cols(); j++) {
-            cout << (int) mat.coeff(i, j) << "\t";
+// whether every vertex of the triangle is on the plane at height z. the
+// triangle crosses no layer there, but the layer just above it is where it
+// would show up as a floor.
+bool triangle_in_plane(const float z, const triangle &t) {
+    for (int i = 0; i < 3; i++) {
+        if (!on_layer_plane(t.v[i][2], z)) {
+            return false;
         }
-        cout << endl;
     }
+    return true;
 }
 
-#define OUT_OF_PLANE (0)
-#define POINT_IN_PLANE (1)
-#define FACE_IN_PLANE (2)
-
-// returns FACE_IN_PLANE if the face is fully in-plane (all verteces lie in the
-// plane). returns POINT_IN_PLANE if the plane and face intersect at a single
-// point. returns OUT_OF_PLANE if neither property holds.
+// returns the line segment across the triangle representing the line of
+// intersection between the xy-plane at height z and the provided triangle.
+// returns a zero-length line segment if triangle does not intersect plane.
 //
-// this function should only be called on faces that either intersect the plane
-// or lie in it.
-int inplane_status(const float z, const face* f) {
-    edge *e0 = f->e;
-    // check for in-plane conditions
-    int verts_inplane = 0;
-    int verts_above = 0;
-    int verts_below = 0;
-
-    do {
-        vertex *v = e0->vert;
-        if (v->loc[2] == z) {
-            verts_inplane++;
-        } else if (v->loc[2] > z) {
-            verts_above++;
-        } else {
-            verts_below++;
-        }
-        e0 = e0->next;
-    } while (e0 != f->e);
-
-    // check for whole-tri-in-plane
-    if (verts_above == 0 && verts_below == 0) {
-        return FACE_IN_PLANE;
-
-    }
-    // check for single-point-in-plane
-    if (verts_inplane == 1 && (verts_above == 0 || verts_below == 0)) {
-        return POINT_IN_PLANE;
-    }
-    return OUT_OF_PLANE;
-}
-
-// returns the line segment across the face representing the line of
-// intersection between the xy-plane at height z and the provided face.
-// returns a zero-length line segment if face does not intersect plane
-lineseg isect_tri_xy_plane(const float z, const face* f) {
+// verteces on the plane count as being below it (see layer_side), so the
+// triangle crosses the plane along the two edges whose ends are on different
+// sides of it, or not at all. an edge lying in the plane comes out of the
+// triangle above it, and a vertex that only touches the plane from above
+// gives a zero-length segment.
+lineseg isect_tri_xy_plane(const float z, const triangle &t) {
     lineseg l;
-
-    if (f->sides() != 3) {
-        // TODO: triangularize!
-        cout << "got a nontriangular mesh and I'm a stupid slicer." << endl;
-        return l;
-    }
+    l.p1 = l.p2 = Vector3f::Zero();
 
     int points_found = 0;
-    edge *e0 = f->e;
-    do {
-        // do this at the start so we can use continue within the loop
-        e0 = e0->next;
-
-        vertex *v = e0->next->vert,
-               *v0 = e0->vert;
-        float v_z = v->loc[2],
-              v0_z = v0->loc[2];
-
-        if (v_z == v0_z) {
-            // check for edge-in-plane condition. since we know the whole
-            // tri /isn't/ in-plane from the check above, we know that this
-            // edge must be our levelset poly line segment
-            if (v_z == z) {
-                l.p1 = v0->loc;
-                l.p2 = v->loc;
-                points_found = 2;
-                break;
-            }
+    // edges from v[1] to v[2], v[2] to v[0] and v[0] to v[1]
+    for (int i = 1; i <= 3; i++) {
+        const Vector3f &v0 = t.v[i % 3], &v = t.v[(i + 1) % 3];
+        if (layer_side(v[2], z) == layer_side(v0[2], z)) {
             continue;
         }
 
-        float n = (v_z - z) / (v_z - v0_z);
-        if (0 <= n && n <= 1) {
-            Vector3f p = v->loc - n * (v->loc - v0->loc);
-            if (points_found == 0) {
-                l.p1 = p;
-                points_found++;
-            } else if (points_found == 1 && p != l.p1) {
-                l.p2 = p;
-                points_found++;
-            }
+        // the two faces on either side of an edge walk it in opposite
+        // directions. interpolating from its lower end either way gives both
+        // of them exactly the same point, so their segments join up. a lower
+        // end on the plane is where the edge crosses it.
+        const Vector3f &lo = v[2] < v0[2] ? v : v0,
+              &hi = v[2] < v0[2] ? v0 : v;
+        Vector3f p = lo;
+        if (lo[2] != z) {
+            p = lo + (z - lo[2]) / (hi[2] - lo[2]) * (hi - lo);
+            p[2] = z;
+        }
+        if (points_found++ == 0) {
+            l.p1 = p;
+        } else {
+            l.p2 = p;
         }
-    } while (e0 != f->e);
+    }
     return l;
 }
 
-// assign faces to layer buckets. this modifies the levelset vector in-place.
+lineseg isect_tri_xy_plane(const float z, const face* f) {
+    triangle t;
+    t.v[0] = f->e->vert->loc;
+    t.v[1] = f->e->next->vert->loc;
+    t.v[2] = f->e->next->next->vert->loc;
+    return isect_tri_xy_plane(z, t);
+}
+
+// assign faces, and the triangles they were split into, to layer buckets.
+// this modifies the levelset vector in-place.
 void bucket_faces(
-        const mesh &m, const bounds &b,
-        const float layer_height, vector<levelset> &layers) {
+        const mesh &m, const vector<triangle> &tris,
+        vector<levelset> &layers) {
+    // the range of heights of every face, then every triangle
+    vector<pair<float, float>> spans;
     for (auto iter = m.faces.begin(); iter != m.faces.end(); iter++) {
         face* f = *iter;
 
@@ -143,54 +105,122 @@ void bucket_faces(
             }
             e = e->next;
         } while (e != f->e);
-
-        // add face to appropriate buckets
-        for (auto ls = layers.begin(); ls != layers.end(); ls++) {
-            if (z_min <= ls->z && ls->z <= z_max) {
-                ls->faces.push_back(f);
-            } else if (ls->z > z_max) {
-                // we're out of our good range, break
-                break;
+        spans.push_back(pair<float, float>(z_min, z_max));
+    }
+    for (auto t = tris.begin(); t != tris.end(); t++) {
+        spans.push_back(pair<float, float>(
+                    std::min(t->v[0][2], std::min(t->v[1][2], t->v[2][2])),
+                    std::max(t->v[0][2], std::max(t->v[1][2], t->v[2][2]))));
+    }
+    size_t face_count = m.faces.size();
+
+    // layers are sorted by height, so the first one a face or triangle
+    // reaches can be found by bisection, and only the layers it actually
+    // spans are visited. the first pass counts what each layer gets, so its
+    // lists are allocated in the store at the right size for the second.
+    vector<size_t> faces(layers.size(), 0), triangles(layers.size(), 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < spans.size(); i++) {
+            auto ls = std::lower_bound(
+                    layers.begin(), layers.end(), spans[i].first,
+                    [](const levelset &l, const float z) { return l.z < z; });
+            for (; ls != layers.end() && ls->z <= spans[i].second; ls++) {
+                size_t layer = ls - layers.begin();
+                if (i < face_count) {
+                    size_t &at = faces[layer];
+                    if (pass == 1) {
+                        ls->faces[at] = m.faces[i];
+                    }
+                    at++;
+                } else {
+                    size_t &at = triangles[layer];
+                    if (pass == 1) {
+                        ls->triangles[at] = i - face_count;
+                    }
+                    at++;
+                }
             }
         }
+        if (pass == 0 && !layers.empty()) {
+            arena &out = layers[0].store->take();
+            for (size_t i = 0; i < layers.size(); i++) {
+                layers[i].faces = layerlist<face*>(out, faces[i]);
+                layers[i].triangles = layerlist<uint32_t>(out, triangles[i]);
+                faces[i] = triangles[i] = 0;
+            }
+            layers[0].store->give(out);
+        }
     }
 }
 
 // generates a list of line segments based on the intersection of the bucketed
-// faces and the xy-plane at height ls.z
-void find_line_segments(levelset &ls) {
-    for (auto iter = ls.faces.begin(); iter != ls.faces.end(); iter++) {
-        face* f = *iter;
-        int inplane = inplane_status(ls.z, f);
-
-        if (inplane == FACE_IN_PLANE) {
-            ls.inplane.push_back(f);
-            continue;
-        } else if (inplane == POINT_IN_PLANE) {
+// triangles and the xy-plane at height ls.z
+void find_line_segments(
+        const levelset &ls, const vector<triangle> &tris,
+        scratch_vector<lineseg> &lines, scratch_vector<uint32_t> &inplane) {
+    // nearly every triangle reaching the layer crosses it
+    lines.reserve(ls.triangles.size());
+    for (auto iter = ls.triangles.begin(); iter != ls.triangles.end(); iter++) {
+        const triangle &t = tris[*iter];
+        if (triangle_in_plane(ls.z, t)) {
+            inplane.push_back(*iter);
             continue;
         }
 
-        lineseg line = isect_tri_xy_plane(ls.z, f);
-        if ((line.p1 - line.p2).norm() == 0) {
-            cout << "warning: face doesn't intersect z = " << ls.z << endl;
-            edge *e = f->e;
-            do {
-                vertex *v = e->vert;
-                printf("  v[%lx]\t%f\t%f\t%f\n", (unsigned long) v,
-                        v->loc[0], v->loc[1], v->loc[2]);
-                e = e->next;
-            } while (e != f->e);
-        } else {
-            ls.lines.push_back(line);
+        // triangles that only touch the plane at a vertex have nothing to add
+        lineseg line = isect_tri_xy_plane(ls.z, t);
+        if (line.p1 != line.p2) {
+            lines.push_back(line);
+        }
+    }
+}
+
+void fix_verteces(levelset &ls, const float resolution, arena &out) {
+    ls.resolution = resolution;
+    ls.fixed = layerlist<Vector2i>(out, ls.verteces.size());
+    for (size_t v = 0; v < ls.verteces.size(); v++) {
+        new (&ls.fixed[v]) Vector2i(
+                lround(ls.verteces[v][0] / resolution),
+                lround(ls.verteces[v][1] / resolution));
+    }
+    // the perimeters only ever get shorter, so each is moved down over the
+    // space the ones before it gave up
+    layerlist<uint32_t> &verts = ls.perimeter_verteces;
+    size_t kept = 0;
+    for (size_t p = 0; p < ls.perimeter_count(); p++) {
+        size_t first = ls.perimeter_starts[p],
+               last = ls.perimeter_starts[p + 1];
+        bool closed = last - first > 1 && verts[first] == verts[last - 1];
+        ls.perimeter_starts[p] = kept;
+        for (size_t i = first; i < last; i++) {
+            uint32_t v = verts[i];
+            if (kept > ls.perimeter_starts[p]
+                    && ls.fixed[v] == ls.fixed[verts[kept - 1]]) {
+                // a closed perimeter has to keep ending where it starts
+                if (closed && i + 1 == last) {
+                    verts[kept - 1] = v;
+                }
+                continue;
+            }
+            verts[kept++] = v;
         }
     }
+    if (!ls.perimeter_starts.empty()) {
+        ls.perimeter_starts.back() = kept;
+    }
+    verts.shrink(kept);
+    ls.verteces = layerlist<Vector3f>();
 }
 
+// positions of a layer's verteces to their ids, in the layer's scratch arena
+typedef map<Vector3f, uint32_t, vector_comparitor,
+        arena_allocator<pair<const Vector3f, uint32_t>>> vertex_ids;
+
 // creates a vertex in the vert_ids map and in the verts list. returns the ID to
 // use for the next vertex (either next_id or next_id + 1)
 int create_vertex(
-        map<Vector3f, uint32_t, vector_comparitor> &vert_ids,
-        Vector3f &loc, vector<Vector3f> &verts, int next_id) {
+        vertex_ids &vert_ids, const Vector3f &loc,
+        scratch_vector<Vector3f> &verts, int next_id) {
     if (vert_ids.find(loc) != vert_ids.end()) {
         return next_id;
     }
@@ -199,110 +229,504 @@ int create_vertex(
     return next_id + 1;
 }
 
+// the verteces each vertex of a layer shares a segment with, in increasing
+// order, all in one list in the layer's scratch arena: a compact stand-in for
+// a sparse adjacency matrix. a pair of verteces joined by two segments is
+// listed twice, and walking along a segment uses it up from both ends.
+class adjacency {
+    public:
+        adjacency(arena &scratch);
+
+        // lists the segments between verteces 0 to n - 1 in edges
+        void build(
+                const uint32_t n,
+                const scratch_vector<pair<uint32_t, uint32_t>> &edges);
+        uint32_t degree(const uint32_t v) const;
+        // whether a and b share a segment
+        bool linked(const uint32_t a, const uint32_t b) const;
+        // whether v has a segment that hasn't been used up
+        bool unused(const uint32_t v) const;
+        // uses up the segment from v to the lowest numbered vertex it still
+        // has one to, and returns that vertex, or -1 if v has none left
+        int64_t take(const uint32_t v);
+
+    private:
+        // the neighbours of v are to[first[v]] up to to[first[v + 1]]
+        scratch_vector<uint32_t> first, to;
+        scratch_vector<uint8_t> used;
+};
+
+adjacency::adjacency(arena &scratch) :
+        first(arena_allocator<uint32_t>(scratch)),
+        to(arena_allocator<uint32_t>(scratch)),
+        used(arena_allocator<uint8_t>(scratch)) {}
+
+void adjacency::build(
+        const uint32_t n,
+        const scratch_vector<pair<uint32_t, uint32_t>> &edges) {
+    first.assign(n + 1, 0);
+    for (auto e = edges.begin(); e != edges.end(); e++) {
+        first[e->first + 1]++;
+        first[e->second + 1]++;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        first[v + 1] += first[v];
+    }
+    to.assign(first[n], 0);
+    used.assign(first[n], 0);
+    scratch_vector<uint32_t> fill(
+            first.begin(), first.end() - 1, first.get_allocator());
+    for (auto e = edges.begin(); e != edges.end(); e++) {
+        to[fill[e->first]++] = e->second;
+        to[fill[e->second]++] = e->first;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        std::sort(to.begin() + first[v], to.begin() + first[v + 1]);
+    }
+}
+
+uint32_t adjacency::degree(const uint32_t v) const {
+    return first[v + 1] - first[v];
+}
+
+bool adjacency::linked(const uint32_t a, const uint32_t b) const {
+    for (uint32_t i = first[a]; i < first[a + 1]; i++) {
+        if (to[i] == b) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool adjacency::unused(const uint32_t v) const {
+    for (uint32_t i = first[v]; i < first[v + 1]; i++) {
+        if (!used[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t adjacency::take(const uint32_t v) {
+    for (uint32_t i = first[v]; i < first[v + 1]; i++) {
+        if (used[i]) {
+            continue;
+        }
+        uint32_t r = to[i];
+        used[i] = 1;
+        for (uint32_t j = first[r]; j < first[r + 1]; j++) {
+            if (to[j] == v && !used[j]) {
+                used[j] = 1;
+                break;
+            }
+        }
+        return r;
+    }
+    return -1;
+}
+
+// joins the ends of open chains in a layer's segments, the verteces only one
+// segment touches, where a hole in the mesh's surface broke a perimeter. ends
+// are bucketed in a grid of gap-sized cells, so each finds its nearest
+// partner in expected constant time, and the ends with the closest partners
+// are joined first. ends joined to each other are added to edges, and the
+// ones left over, which have nothing within gap, to open.
+void close_gaps(
+        const levelset &ls, const scratch_vector<uint32_t> &ends,
+        const adjacency &links, const float gap,
+        scratch_vector<pair<uint32_t, uint32_t>> &edges,
+        scratch_vector<uint32_t> &open, slicestats &stats) {
+    // a closed layer, the usual case, needn't build the grid at all
+    if (ends.empty()) {
+        return;
+    }
+    pointgrid grid(gap);
+    for (auto end = ends.begin(); end != ends.end(); end++) {
+        grid.insert(ls.verteces[*end].head<2>(), *end);
+    }
+
+    scratch_vector<uint8_t> joined(
+            ls.verteces.size(), 0, open.get_allocator());
+    // an end can't join itself, or the other end of its own segment, which
+    // would just double the segment back
+    auto compatible = [&](const uint32_t a, const uint32_t b) {
+        return a != b && !joined[b] && !links.linked(a, b);
+    };
+
+    scratch_vector<pair<float, uint32_t>> order(open.get_allocator());
+    for (auto end = ends.begin(); end != ends.end(); end++) {
+        Vector2f p = ls.verteces[*end].head<2>();
+        uint32_t other;
+        float dist = INFINITY;
+        if (grid.nearest(p, gap, [&](const uint32_t id) {
+                    return compatible(*end, id);
+                }, other)) {
+            dist = (ls.verteces[other].head<2>() - p).norm();
+        }
+        order.push_back(pair<float, uint32_t>(dist, *end));
+    }
+    std::sort(order.begin(), order.end());
+
+    for (auto o = order.begin(); o != order.end(); o++) {
+        uint32_t end = o->second, other = 0;
+        if (joined[end]) {
+            continue;
+        }
+        // the nearest end may have been taken by now, so look again
+        if (!grid.nearest(ls.verteces[end].head<2>(), gap,
+                    [&](const uint32_t id) { return compatible(end, id); },
+                    other)) {
+            open.push_back(end);
+            continue;
+        }
+        joined[end] = joined[other] = 1;
+        edges.push_back(pair<uint32_t, uint32_t>(end, other));
+        stats.gaps_closed++;
+    }
+}
+
+// finds the layer's in-plane triangles under the perimeter verteces where
+// something is wrong. the triangles are filed in a grid by the cells their
+// bounding boxes cover, so each vertex only tests the few triangles near it.
+// the grid is only built for the first such vertex, which most layers never
+// have.
+class inplane_finder {
+    public:
+        inplane_finder(
+                const scratch_vector<uint32_t> &inplane,
+                const vector<triangle> &tris, arena &scratch);
+
+        // reports the in-plane triangles that p lies on, each only once
+        void report_at(const Vector3f &p, slicediag &diag);
+
+    private:
+        void build();
+
+        const scratch_vector<uint32_t> &inplane;
+        const vector<triangle> &tris;
+        // the triangles already reported, by their place in inplane
+        scratch_vector<uint8_t> flagged;
+        std::unique_ptr<segmentgrid> grid;
+        vector<uint32_t> near;
+};
+
+inplane_finder::inplane_finder(
+        const scratch_vector<uint32_t> &inplane,
+        const vector<triangle> &tris, arena &scratch) :
+        inplane(inplane), tris(tris),
+        flagged(arena_allocator<uint8_t>(scratch)) {}
+
+void inplane_finder::build() {
+    // cells about as big as the triangles, so each covers a few cells
+    float size = 0;
+    for (auto i = inplane.begin(); i != inplane.end(); i++) {
+        const triangle &t = tris[*i];
+        Vector3f lo = t.v[0].cwiseMin(t.v[1]).cwiseMin(t.v[2]),
+                 hi = t.v[0].cwiseMax(t.v[1]).cwiseMax(t.v[2]);
+        size += std::max(hi[0] - lo[0], hi[1] - lo[1]);
+    }
+    float cell = size > 0 ? size / inplane.size() : 1;
+    grid.reset(new segmentgrid(cell));
+    flagged.assign(inplane.size(), 0);
+
+    // a line along every row of cells a triangle's bounding box covers, from
+    // one side of the box to the other, files it under every one of them
+    for (size_t i = 0; i < inplane.size(); i++) {
+        const triangle &t = tris[inplane[i]];
+        Vector3f lo = t.v[0].cwiseMin(t.v[1]).cwiseMin(t.v[2]),
+                 hi = t.v[0].cwiseMax(t.v[1]).cwiseMax(t.v[2]);
+        int32_t first = (int32_t) floor(lo[1] / cell),
+                last = (int32_t) floor(hi[1] / cell);
+        for (int32_t row = first; row <= last; row++) {
+            float y = (row + .5f) * cell;
+            grid->insert(Vector2f(lo[0], y), Vector2f(hi[0], y), i);
+        }
+    }
+}
+
+void inplane_finder::report_at(const Vector3f &p, slicediag &diag) {
+    if (inplane.empty()) {
+        return;
+    }
+    if (!grid) {
+        build();
+    }
+    Vector2f pt = p.head<2>();
+    near.clear();
+    grid->query(pt, pt, near);
+    for (auto i = near.begin(); i != near.end(); i++) {
+        if (flagged[*i]) {
+            continue;
+        }
+        const triangle &t = tris[inplane[*i]];
+        Vector2f a = t.v[0].head<2>(), b = t.v[1].head<2>(),
+                 c = t.v[2].head<2>();
+        int sign = orient2d(a, b, c);
+        if (sign == 0) {
+            continue;
+        }
+        if (orient2d(a, b, pt) * sign >= 0 && orient2d(b, c, pt) * sign >= 0
+                && orient2d(c, a, pt) * sign >= 0) {
+            flagged[*i] = 1;
+            diag.report(DIAG_INPLANE_TRIANGLE, (t.v[0] + t.v[1] + t.v[2]) / 3);
+        }
+    }
+}
+
 // converts an unsorted list of line segments to a list of ordered lists of
-// verteces representing paths around the levelset.
-void linesegs_to_vert_list(levelset &ls) {
-    map<Vector3f, uint32_t, vector_comparitor> vert_ids;
+// verteces representing paths around the levelset. chains left open by holes
+// in the mesh are closed where their ends are at most gap apart; the rest are
+// recorded as open perimeters, from one end to the other, and noted in
+// stats.diag along with anywhere the perimeters branch, and the in-plane
+// triangles either happens on. the perimeters and their verteces go in out,
+// one of the layers' store's arenas, and everything else in scratch, which
+// the caller resets.
+void linesegs_to_vert_list(
+        levelset &ls, const scratch_vector<lineseg> &lines,
+        const scratch_vector<uint32_t> &inplane, const vector<triangle> &tris,
+        const float gap, arena &scratch, arena &out, slicestats &stats) {
+    arena_allocator<uint32_t> alloc(scratch);
+    vertex_ids vert_ids(vector_comparitor(), alloc);
+    scratch_vector<Vector3f> verts(alloc);
     int next_id = 0;
 
     // build vert list
-    for (auto iter = ls.lines.begin(); iter != ls.lines.end(); iter++) {
-        next_id = create_vertex(vert_ids, iter->p1, ls.verteces, next_id);
-        next_id = create_vertex(vert_ids, iter->p2, ls.verteces, next_id);
-    }
-    int n = ls.verteces.size();
-
-    // build adjacency
-    // TODO: handle double-edges
-    vector<Triplet<uint8_t>> adjacents;
-    for (auto iter = ls.lines.begin(); iter != ls.lines.end(); iter++) {
-        auto i1 = vert_ids.find(iter->p1);
-        if (i1 == vert_ids.end()) {
-            cout << "warning: after building vert list, vert " <<
-                iter->p1.transpose() << " is missing" << endl;
+    for (auto iter = lines.begin(); iter != lines.end(); iter++) {
+        next_id = create_vertex(vert_ids, iter->p1, verts, next_id);
+        next_id = create_vertex(vert_ids, iter->p2, verts, next_id);
+    }
+    uint32_t n = verts.size();
+    ls.verteces = layerlist<Vector3f>(out, n);
+    std::uninitialized_copy(verts.begin(), verts.end(), ls.verteces.begin());
+
+    // build adjacency. every vertex was just added, so the lookups can't
+    // fail.
+    scratch_vector<pair<uint32_t, uint32_t>> edges(alloc);
+    edges.reserve(lines.size());
+    for (auto iter = lines.begin(); iter != lines.end(); iter++) {
+        edges.push_back(pair<uint32_t, uint32_t>(
+                    vert_ids.find(iter->p1)->second,
+                    vert_ids.find(iter->p2)->second));
+    }
+    adjacency links(scratch);
+    links.build(n, edges);
+
+    // a closed perimeter passes through every vertex an even number of times
+    scratch_vector<uint32_t> ends(alloc), open(alloc);
+    inplane_finder finder(inplane, tris, scratch);
+    for (uint32_t i = 0; i < n; i++) {
+        if (links.degree(i) % 2 == 1) {
+            ends.push_back(i);
         }
-        auto i2 = vert_ids.find(iter->p2);
-        if (i2 == vert_ids.end()) {
-            cout << "warning: after building vert list, vert " <<
-                iter->p2.transpose() << " is missing" << endl;
+        if (links.degree(i) > 2) {
+            stats.diag.report(DIAG_BRANCHING_VERTEX, ls.verteces[i]);
+            finder.report_at(ls.verteces[i], stats.diag);
         }
-        adjacents.push_back(Triplet<uint8_t>(i1->second, i2->second, 1));
-        adjacents.push_back(Triplet<uint8_t>(i2->second, i1->second, 1));
+    }
+    if (gap <= 0) {
+        open = ends;
+    } else if (!ends.empty()) {
+        close_gaps(ls, ends, links, gap, edges, open, stats);
+        links.build(n, edges);
+    }
+    for (auto end = open.begin(); end != open.end(); end++) {
+        stats.diag.report(DIAG_OPEN_END, ls.verteces[*end]);
+        finder.report_at(ls.verteces[*end], stats.diag);
     }
 
-    SparseMatrix<uint8_t> adj(n, n);
-    adj.setFromTriplets(adjacents.begin(), adjacents.end());
-
-    int vert = -1;
-    vector<uint32_t> perimeter;
-    vector<vector<uint32_t>*> perimeters;
-
+    // walk the segments, starting from the lowest numbered vertex with any
+    // left. open chains are walked from one end, so each comes out whole.
+    // segments are only ever used up, so neither search has to look back.
+    scratch_vector<uint32_t> perimeters(alloc), starts(alloc);
+    auto end = open.begin();
+    uint32_t start = 0;
     while (true) {
-        if (vert == -1) {
-            for (vert = 0; vert < adj.cols(); vert++) {
-                for (int i = 0; i < adj.rows(); i++) {
-                    if (adj.coeff(i, vert) > 0) {
-                        goto next_vert;
-                    }
-                }
-            }
-            goto exit;
+        int64_t vert = -1;
+        while (end != open.end() && !links.unused(*end)) {
+            end++;
+        }
+        if (end != open.end()) {
+            vert = *end;
         } else {
-            int next = -1;
-            for (int r = 0; r < adj.rows(); r++) {
-                if (adj.coeff(vert, r) > 0) {
-                    adj.coeffRef(vert, r)--;
-                    adj.coeffRef(r, vert)--;
-                    next = r;
-                    break;
-                }
+            while (start < n && !links.unused(start)) {
+                start++;
+            }
+            if (start == n) {
+                break;
             }
-            vert = next;
+            vert = start;
         }
-next_vert:
-        if (vert != -1) {
-            perimeter.push_back(vert);
-        } else if (perimeter.size() > 0) {
-            ls.perimeters.push_back(perimeter);
-            perimeter.clear();
+
+        starts.push_back(perimeters.size());
+        while (vert != -1) {
+            perimeters.push_back(vert);
+            vert = links.take(vert);
         }
     }
-exit:
-    return;
+    if (!starts.empty()) {
+        starts.push_back(perimeters.size());
+    }
+    ls.perimeter_verteces = layerlist<uint32_t>(out, perimeters.size());
+    std::copy(perimeters.begin(), perimeters.end(),
+            ls.perimeter_verteces.begin());
+    ls.perimeter_starts = layerlist<uint32_t>(out, starts.size());
+    std::copy(starts.begin(), starts.end(), ls.perimeter_starts.begin());
 }
 
-void slice(const tooldef td, const mesh &m, vector<levelset> &levelsets) {
-    levelsets.clear();
-
+void slice(
+        const tooldef td, const mesh &m, vector<levelset> &levelsets,
+        slicestats &stats) {
     bounds b = m.get_bounds();
+    vector<float> heights;
     int level_count = ceil((b.max_z - b.min_z) / td.z_accuracy);
     for (int i = 0; i < level_count; i++) {
+        heights.push_back(b.min_z + i * td.z_accuracy);
+    }
+    heights.push_back(b.max_z);
+    slice_at(td, m, heights, levelsets, stats);
+}
+
+void slice_at(
+        const tooldef td, const mesh &m, const vector<float> &heights,
+        vector<levelset> &levelsets, slicestats &stats) {
+    levelsets.clear();
+    std::shared_ptr<layerstore> store(new layerstore());
+    for (auto z = heights.begin(); z != heights.end(); z++) {
         levelset l;
-        l.z = b.min_z + i * td.z_accuracy;
+        l.z = *z;
+        l.store = store;
         levelsets.push_back(l);
     }
-    levelset l;
-    l.z = b.max_z;
-    levelsets.push_back(l);
 
-    bucket_faces(m, b, td.z_accuracy, levelsets);
+    // faces with more than three sides are split up once, here, so slicing
+    // only ever sees triangles
+    vector<triangle> tris;
+    for (auto f = m.faces.begin(); f != m.faces.end(); f++) {
+        if (!face_triangles(*f, tris)) {
+            stats.diag.report(DIAG_TWISTED_FACE, (*f)->e->vert->loc);
+        }
+    }
+    reorder_triangles(tris, td.mesh_order);
+    for (auto t = tris.begin(); t != tris.end(); t++) {
+        if ((t->v[1] - t->v[0]).cross(t->v[2] - t->v[0]).isZero(0)) {
+            stats.diag.report(DIAG_DEGENERATE_TRIANGLE,
+                    (t->v[0] + t->v[1] + t->v[2]) / 3);
+        }
+    }
+    bucket_faces(m, tris, levelsets);
+
+    // every layer keeps its own stats, so they can be sliced in parallel.
+    // each thread's scratch arena is emptied for every layer it takes on, and
+    // soon holds enough for the busiest of them. what the layer keeps goes in
+    // an arena from the store, which only grows now and then, so slicing a
+    // layer rarely goes to the heap at all.
+    vector<slicestats> layer_stats(levelsets.size());
+    parallel_for(levelsets.size(), [&](size_t i) {
+        static thread_local arena scratch;
+        levelset &ls = levelsets[i];
+        slicestats &s = layer_stats[i];
+        uint64_t allocations = scratch.heap_allocations;
+        scratch.reset();
+        arena &out = store->take();
+        scratch_vector<lineseg> lines(scratch);
+        scratch_vector<uint32_t> inplane(scratch);
+        find_line_segments(ls, tris, lines, inplane);
+        linesegs_to_vert_list(
+                ls, lines, inplane, tris, td.gap, scratch, out, s);
+        s.scratch_blocks = scratch.heap_allocations - allocations;
+        s.scratch_bytes = scratch.capacity;
+        // half the tolerance, leaving the other half for fitting arcs to
+        // the simplified perimeters
+        s.simplify_verteces_in = simplify_perimeters(ls, td.tolerance / 2);
+        if (td.resolution > 0) {
+            fix_verteces(ls, td.resolution, out);
+        }
+        s.simplify_verteces_out += ls.perimeter_verteces.size();
+        store->give(out);
+    });
+    for (auto s = layer_stats.begin(); s != layer_stats.end(); s++) {
+        stats.merge(*s);
+    }
+    stats.output_blocks += store->heap_allocations();
+    stats.output_bytes += store->capacity();
+}
+
+layerstore::layerstore() {}
+
+arena& layerstore::take() {
+    std::lock_guard<std::mutex> l(lock);
+    if (idle.empty()) {
+        arenas.push_back(std::unique_ptr<arena>(new arena()));
+        return *arenas.back();
+    }
+    arena *a = idle.back();
+    idle.pop_back();
+    return *a;
+}
+
+void layerstore::give(arena &a) {
+    std::lock_guard<std::mutex> l(lock);
+    idle.push_back(&a);
+}
 
-    for (auto iter = levelsets.begin(); iter != levelsets.end(); iter++) {
-        find_line_segments(*iter);
-        linesegs_to_vert_list(*iter);
+uint64_t layerstore::heap_allocations() {
+    std::lock_guard<std::mutex> l(lock);
+    uint64_t total = 0;
+    for (auto a = arenas.begin(); a != arenas.end(); a++) {
+        total += (*a)->heap_allocations;
     }
+    return total;
+}
+
+size_t layerstore::capacity() {
+    std::lock_guard<std::mutex> l(lock);
+    size_t total = 0;
+    for (auto a = arenas.begin(); a != arenas.end(); a++) {
+        total += (*a)->capacity;
+    }
+    return total;
 }
 
 lineseg::lineseg() {}
 
 lineseg::lineseg(const lineseg &other) : p1(other.p1), p2(other.p2) {}
 
-levelset::levelset() {}
+levelset::levelset() : resolution(0) {}
 
 levelset::levelset(const levelset &other) :
-        verteces(other.verteces), perimeters(other.perimeters),
-        inplane(other.inplane), z(other.z), faces(other.faces),
-        lines(other.lines) {}
+        verteces(other.verteces), fixed(other.fixed),
+        resolution(other.resolution),
+        perimeter_verteces(other.perimeter_verteces),
+        perimeter_starts(other.perimeter_starts), z(other.z),
+        faces(other.faces), triangles(other.triangles), store(other.store) {}
+
+size_t levelset::vertex_count() const {
+    return fixed.empty() ? verteces.size() : fixed.size();
+}
+
+Vector3f levelset::vertex(const uint32_t i) const {
+    if (fixed.empty()) {
+        return verteces[i];
+    }
+    return Vector3f(fixed[i][0] * resolution, fixed[i][1] * resolution, z);
+}
+
+Vector2f levelset::point(const uint32_t i) const {
+    if (fixed.empty()) {
+        return verteces[i].head<2>();
+    }
+    return fixed[i].cast<float>() * resolution;
+}
+
+size_t levelset::perimeter_count() const {
+    return perimeter_starts.empty() ? 0 : perimeter_starts.size() - 1;
+}
+
+layerlist<uint32_t> levelset::perimeter(const size_t i) const {
+    return layerlist<uint32_t>(
+            perimeter_verteces.begin() + perimeter_starts[i],
+            perimeter_starts[i + 1] - perimeter_starts[i]);
+}
 
 ostream& operator<< (ostream &out, const lineseg &l) {
     out << "(" << l.p1.transpose() << ",\t" << l.p2.transpose() << ")";
@@ -310,8 +734,8 @@ ostream& operator<< (ostream &out, const lineseg &l) {
 }
 
 ostream& operator<< (ostream &out, const levelset &ls) {
-    out << "[verteces = " << ls.verteces.size()
-        << " lines size " << ls.lines.size()
+    out << "[verteces = " << ls.vertex_count()
+        << " perimeters " << ls.perimeter_count()
         << "]";
     return out;
 }
@@ -2,10 +2,15 @@
 #define __TP_SLICE_H__
 
 #include <Eigen/Dense>
+#include <memory>
 #include <meshparse/mesh.h>
+#include <mutex>
 #include <vector>
 
+#include "arena.h"
+#include "stats.h"
 #include "tooldef.h"
+#include "triangulate.h"
 
 using namespace Eigen;
 using namespace meshparse;
@@ -21,6 +26,59 @@ class lineseg {
         Vector3f p2;
 };
 
+// a list of a fixed number of things kept in a slicing job's layerstore.
+// copying one copies where it points, not what's in it.
+template <typename T>
+class layerlist {
+    public:
+        layerlist() : items(NULL), count(0) {}
+        // the count things from items on
+        layerlist(T *items, const size_t count) : items(items), count(count) {}
+        // room for count things, left for the caller to fill in
+        layerlist(arena &a, const size_t count) :
+                items((T*) a.allocate(count * sizeof(T), alignof(T))),
+                count(count) {}
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        T* begin() const { return items; }
+        T* end() const { return items + count; }
+        T& operator[] (const size_t i) const { return items[i]; }
+        T& front() const { return items[0]; }
+        T& back() const { return items[count - 1]; }
+        // keeps the first n things and forgets the rest, which stay in the
+        // store until it goes
+        void shrink(const size_t n) { count = n; }
+
+    private:
+        T *items;
+        size_t count;
+};
+
+// the memory a slicing job's layers keep their lists in, which lasts as long
+// as any of the layers does. every layer being sliced takes an arena to fill
+// and gives it back when it's done, so there are only ever as many arenas as
+// layers sliced at once, and they go to the heap a handful of times however
+// many layers there are.
+class layerstore {
+    public:
+        layerstore();
+
+        arena& take();
+        void give(arena &a);
+        // heap blocks all the arenas have taken, and the bytes they hold
+        uint64_t heap_allocations();
+        size_t capacity();
+
+    private:
+        layerstore(const layerstore &other);
+        layerstore& operator= (const layerstore &other);
+
+        std::mutex lock;
+        std::vector<std::unique_ptr<arena>> arenas;
+        std::vector<arena*> idle;
+};
+
 class levelset {
     public:
         levelset();
@@ -29,28 +87,66 @@ class levelset {
         friend std::ostream& operator<< (std::ostream &out, const levelset &ls);
 
         // verteces on the levelset polygon
-        std::vector<Vector3f> verteces;
-        // list of connected perimeters for the levelset. values are indeces
-        // into the perimeter array
-        std::vector<std::vector<uint32_t>> perimeters;
-        // faces that are entirely in the plane of this levelset
-        std::vector<face*> inplane;
+        layerlist<Vector3f> verteces;
+        // the verteces on a grid instead, when slicing with a resolution: x
+        // and y are whole numbers of resolution from the origin, and z is the
+        // levelset's. verteces is left empty.
+        layerlist<Vector2i> fixed;
+        float resolution;
+        // the connected perimeters of the levelset, one after another, as
+        // indeces into the vertex list. perimeter i runs from
+        // perimeter_verteces[perimeter_starts[i]] up to the start of the next
+        // one; perimeter_starts has one more entry, the end of the last one.
+        layerlist<uint32_t> perimeter_verteces;
+        layerlist<uint32_t> perimeter_starts;
         // the height of this levelset
         float z;
 
         // faces in the original mesh that contribute to this levelset. this is
         // mostly for debug drawing.
-        std::vector<face*> faces;
-        // line segments in levelset polyline.
-        std::vector<lineseg> lines;
+        layerlist<face*> faces;
+        // the mesh's triangles that reach this levelset, as indeces into the
+        // list slice_at splits the faces into, in the order tooldef's
+        // mesh_order put them in
+        layerlist<uint32_t> triangles;
+        // where all the lists above are kept. copies of a levelset share it.
+        std::shared_ptr<layerstore> store;
+
+        // the number of verteces, and each of them, from whichever list holds
+        // them
+        size_t vertex_count() const;
+        Vector3f vertex(const uint32_t i) const;
+        Vector2f point(const uint32_t i) const;
+        size_t perimeter_count() const;
+        layerlist<uint32_t> perimeter(const size_t i) const;
 };
 
-int inplane_status(const float z, const face* f);
+// whether the triangle lies entirely in the xy-plane at height z
+bool triangle_in_plane(const float z, const triangle &t);
+lineseg isect_tri_xy_plane(const float z, const triangle &t);
+// the same for a face of the mesh that's a triangle
 lineseg isect_tri_xy_plane(const float z, const face* f);
+// lists the faces and triangles reaching every layer, in the layers' store
 void bucket_faces(
-        const mesh &m, const bounds &b, const float layer_height,
-        const std::vector<levelset>&);
-void find_line_segments(levelset &ls);
-void slice(const tooldef td, const mesh &m, std::vector<levelset> &out);
+        const mesh &m, const std::vector<triangle> &tris,
+        std::vector<levelset> &layers);
+// collects the segments the layer's triangles cross it along, and the
+// triangles lying in its plane, in the layer's scratch arena
+void find_line_segments(
+        const levelset &ls, const std::vector<triangle> &tris,
+        scratch_vector<lineseg> &lines, scratch_vector<uint32_t> &inplane);
+// moves the verteces of a levelset onto the grid resolution apart, dropping
+// the ones that land on the point before them in a perimeter. the grid
+// points are allocated from out, one of the layers' store's arenas.
+void fix_verteces(levelset &ls, const float resolution, arena &out);
+// slices the mesh into layers td.z_accuracy apart, from its bottom to its top
+void slice(
+        const tooldef td, const mesh &m, std::vector<levelset> &out,
+        slicestats &stats);
+// slices the mesh at the given heights only, which must be sorted from the
+// bottom up. each face is only intersected with the layers it spans.
+void slice_at(
+        const tooldef td, const mesh &m, const std::vector<float> &heights,
+        std::vector<levelset> &out, slicestats &stats);
 
 #endif
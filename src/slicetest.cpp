@@ -1,5 +1,32 @@
+#include <cmath>
+#include <iostream>
+
+#include "arcfit.h"
+#include "boolean.h"
 #include "mesh.h"
+#include "dropcut.h"
+#include "flats.h"
+#include "medial.h"
+#include "offset.h"
+#include "predicates.h"
+#include "rough.h"
+#include "simplify.h"
 #include "slice.h"
+#include "vcarve.h"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// tests that failed so far
+int failures = 0;
+
+void check(const bool ok, const char *what) {
+    cout << (ok ? "ok: " : "FAIL: ") << what << endl;
+    if (!ok) {
+        failures++;
+    }
+}
 
 face* mktri(
         float x1, float y1, float z1,
@@ -40,12 +67,532 @@ face* mktri(
     return f;
 }
 
+// adds a triangle to the mesh, with verteces of its own
+void addtri(mesh &m, const Vector3f &a, const Vector3f &b, const Vector3f &c) {
+    face *f = mktri(a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2]);
+    m.faces.push_back(f);
+    edge *e = f->e;
+    do {
+        m.verteces.push_back(e->vert);
+        e = e->next;
+    } while (e != f->e);
+}
+
+// adds the box from lo to hi, with its faces turned outwards
+void addbox(mesh &m, const Vector3f &lo, const Vector3f &hi) {
+    Vector3f c[8];
+    for (int i = 0; i < 8; i++) {
+        c[i] = Vector3f(
+                i & 1 ? hi[0] : lo[0], i & 2 ? hi[1] : lo[1],
+                i & 4 ? hi[2] : lo[2]);
+    }
+    static const int quads[6][4] = {
+        { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 },
+        { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+    };
+    for (int q = 0; q < 6; q++) {
+        addtri(m, c[quads[q][0]], c[quads[q][1]], c[quads[q][2]]);
+        addtri(m, c[quads[q][0]], c[quads[q][2]], c[quads[q][3]]);
+    }
+}
+
+// finishing a block with vertical walls: between every pair of points of
+// every pass, the tool dropped onto the block mustn't come to rest more
+// than the tolerance above the pass
+void test_drop_finish_walls(const int shape) {
+    mesh m;
+    addbox(m, Vector3f(-1, -1, 0), Vector3f(1, 1, 3));
+    tooldef td;
+    td.shape = shape;
+    td.r = .2;
+    td.corner_r = .05;
+    td.z_accuracy = .5;
+    td.tolerance = .01;
+    td.stepover = .4;
+    path p = drop_finish(m, td);
+
+    bvh tree(m);
+    float worst = 0;
+    for (size_t i = 1; i < p.moves.size(); i++) {
+        if (p.moves[i].type == MOVE_RAPID
+                || p.moves[i - 1].type == MOVE_RAPID) {
+            continue;
+        }
+        Vector3f a = p.moves[i - 1].end, b = p.moves[i].end;
+        for (int k = 0; k <= 16; k++) {
+            Vector3f at = a + (b - a) * (k / 16.f);
+            vector<float> z;
+            drop_line(tree, td, at[1], at[0], 0, 1, 0, z);
+            worst = std::max(worst, z[0] - at[2]);
+        }
+    }
+    check(!p.moves.empty() && worst <= td.tolerance,
+            shape == TOOL_BALL
+            ? "drop finish passes stay above a block's walls with a ball"
+            : "drop finish passes stay above a block's walls with a flat");
+}
+
+// the axis-aligned rectangle from (x0, y0) to (x1, y1), counterclockwise
+polygon rect(const float x0, const float y0, const float x1, const float y1) {
+    polygon p;
+    p.push_back(Vector2f(x0, y0));
+    p.push_back(Vector2f(x1, y0));
+    p.push_back(Vector2f(x1, y1));
+    p.push_back(Vector2f(x0, y1));
+    return p;
+}
+
+// the area of a set of regions, less their holes
+float total_area(const vector<region> &regs) {
+    float area = 0;
+    for (auto r = regs.begin(); r != regs.end(); r++) {
+        area += signed_area(r->outer);
+        for (auto h = r->holes.begin(); h != r->holes.end(); h++) {
+            area += signed_area(*h);
+        }
+    }
+    return area;
+}
+
+// whether regs is count regions with holes holes between them, covering area
+bool regions_are(
+        const vector<region> &regs, const size_t count, const size_t holes,
+        const float area) {
+    size_t h = 0;
+    for (auto r = regs.begin(); r != regs.end(); r++) {
+        h += r->holes.size();
+    }
+    return regs.size() == count && h == holes
+        && fabs(total_area(regs) - area) < 1e-4;
+}
+
+// a and b combined with op, each covering where it winds around nonzero times
+vector<region> combine(
+        const vector<polygon> &a, const vector<polygon> &b, const int op,
+        boolean_scratch &scratch) {
+    vector<region> out;
+    polygon_boolean(a, b, op, FILL_NONZERO, .001, out, scratch);
+    return out;
+}
+
+// every operation on two squares that overlap, share an edge, or only touch
+// at a corner, and on a square with a hole in it. the operands are on the
+// grid, so the areas come out exact.
+void test_boolean() {
+    boolean_scratch scratch;
+    vector<polygon> a, b;
+
+    a.push_back(rect(0, 0, 2, 2));
+    b.push_back(rect(1, 1, 3, 3));
+    check(regions_are(combine(a, b, BOOL_UNION, scratch), 1, 0, 7),
+            "union of overlapping squares");
+    check(regions_are(combine(a, b, BOOL_INTERSECTION, scratch), 1, 0, 1),
+            "intersection of overlapping squares");
+    check(regions_are(combine(a, b, BOOL_DIFFERENCE, scratch), 1, 0, 3),
+            "difference of overlapping squares");
+    check(regions_are(combine(a, b, BOOL_XOR, scratch), 2, 0, 6),
+            "xor of overlapping squares");
+
+    b.clear();
+    b.push_back(rect(2, 0, 4, 2));
+    check(regions_are(combine(a, b, BOOL_UNION, scratch), 1, 0, 8),
+            "union of squares sharing an edge");
+    check(regions_are(combine(a, b, BOOL_INTERSECTION, scratch), 0, 0, 0),
+            "intersection of squares sharing an edge");
+
+    b.clear();
+    b.push_back(rect(2, 2, 4, 4));
+    check(regions_are(combine(a, b, BOOL_UNION, scratch), 2, 0, 8),
+            "union of squares touching at a corner");
+    check(regions_are(combine(a, b, BOOL_XOR, scratch), 2, 0, 8),
+            "xor of squares touching at a corner");
+
+    // a 4 by 4 square with a 2 by 2 hole, and a square over its right half
+    a.clear();
+    a.push_back(rect(0, 0, 4, 4));
+    polygon hole = rect(1, 1, 3, 3);
+    a.push_back(polygon(hole.rbegin(), hole.rend()));
+    b.clear();
+    b.push_back(rect(2, 0, 6, 4));
+    check(regions_are(combine(a, b, BOOL_UNION, scratch), 1, 1, 22),
+            "union with a square with a hole");
+    check(regions_are(combine(a, b, BOOL_INTERSECTION, scratch), 1, 0, 6),
+            "intersection with a square with a hole");
+    check(regions_are(combine(a, b, BOOL_DIFFERENCE, scratch), 1, 0, 6),
+            "difference of a square with a hole");
+    check(regions_are(combine(a, b, BOOL_XOR, scratch), 3, 0, 16),
+            "xor with a square with a hole");
+}
+
+// a square inset by 1 keeps its sharp corners. a hole grows by 1 with its
+// corners rounded off, and a ring whose sides are too thin to survive the
+// inset falls apart into the islands left at its thick ends.
+void test_offset() {
+    region square;
+    square.outer = rect(0, 0, 4, 4);
+    vector<region> out;
+    offset_region(square, 1, .01, out);
+    check(regions_are(out, 1, 0, 4), "offset insets a square");
+
+    region holed;
+    holed.outer = rect(0, 0, 10, 10);
+    polygon hole = rect(4, 4, 6, 6);
+    holed.holes.push_back(polygon(hole.rbegin(), hole.rend()));
+    out.clear();
+    offset_region(holed, 1, .01, out);
+    // 8 by 8 less the hole swept by a unit disc, whose corners are chords
+    // at most .005 inside their arcs
+    float grown = 4 + 8 + M_PI;
+    check(out.size() == 1 && out[0].holes.size() == 1
+            && fabs(total_area(out) - (64 - grown)) < .05,
+            "offset grows a hole with rounded corners");
+
+    region ring;
+    ring.outer = rect(0, 0, 12, 4);
+    hole = rect(3, 1, 9, 3);
+    ring.holes.push_back(polygon(hole.rbegin(), hole.rend()));
+    out.clear();
+    offset_region(ring, .6, .01, out);
+    // each island is the 1.8 by 2.8 end of the ring inset, and the slivers
+    // reaching past it to the arcs around the hole's corners
+    float sliver = .24 - (.2 * sqrt(.2) + .18 * asin(2 / 3.));
+    check(out.size() == 2 && out[0].holes.empty() && out[1].holes.empty()
+            && fabs(total_area(out) - 2 * (1.8 * 2.8 + 2 * sliver)) < .01,
+            "offset splits a ring into islands");
+}
+
+// a point just off a long line through two far away points. the differences
+// taken in double precision lose the point's low bits, so the plain
+// determinant comes out 0, or nonzero for points exactly on the line, and
+// only the exact sum gets them right.
+void test_orient2d() {
+    Vector2f a(ldexpf(5, -30), ldexpf(8, -30)),
+             b(3 * 1048576 - 2, 5 * 1048576 - 2), c = -b;
+    check(orient2d(a, b, c) == 1, "orient2d turns left just off a line");
+    check(orient2d(a, c, b) == -1, "orient2d turns right just off a line");
+
+    a = Vector2f(ldexpf(-3, -30), ldexpf(-5, -30));
+    b = Vector2f(3 * 1048576 - 3, 5 * 1048576 - 1);
+    c = Vector2f(-3 * 1048576 + 3, -5 * 1048576 + 1);
+    check(orient2d(a, b, c) == -1, "orient2d turns right just off a line");
+
+    // all three on the line through the origin and (3, 5)
+    a = Vector2f(ldexpf(3 * 1765, -42), ldexpf(5 * 1765, -42));
+    b = Vector2f(3 * 780267, 5 * 780267);
+    c = Vector2f(-3 * 932927, -5 * 932927);
+    check(orient2d(a, b, c) == 0, "orient2d finds points exactly on a line");
+    a = Vector2f(ldexpf(3 * 2057, -38), ldexpf(5 * 2057, -38));
+    b = Vector2f(3 * 75339, 5 * 75339);
+    c = Vector2f(-3 * 57557, -5 * 57557);
+    check(orient2d(a, b, c) == 0, "orient2d finds points exactly on a line");
+}
+
+// a triangle is only in a layer's plane if all of it is, not if a vertex
+// is just a hair above it
+void test_triangle_in_plane() {
+    triangle t;
+    t.v[0] = Vector3f(0, 0, .3);
+    t.v[1] = Vector3f(1, 0, .3);
+    t.v[2] = Vector3f(0, 1, .3);
+    check(triangle_in_plane(.3, t), "a flat triangle is in its plane");
+    t.v[2][2] = nextafterf(.3, 1);
+    check(!triangle_in_plane(.3, t),
+            "a triangle a hair off flat isn't in the plane");
+    check(!triangle_in_plane(nextafterf(.3, 1), t),
+            "a triangle touching a plane at a vertex isn't in it");
+}
+
+// points on the circle of radius r around (3, 4), from angle from to angle
+// to, step apart
+vector<Vector3f> arc_points(
+        const float r, const float from, const float to, const float step) {
+    vector<Vector3f> points;
+    int n = (int) round(fabs(to - from) / step);
+    for (int i = 0; i <= n; i++) {
+        float t = from + (to - from) * i / n;
+        points.push_back(Vector3f(3 + r * cos(t), 4 + r * sin(t), 1));
+    }
+    return points;
+}
+
+// a sampled quarter circle comes out as a single arc through its points, in
+// the direction it was traced; a straight run comes out as lines; and a
+// whole circle is split into arcs sweeping no more than ARC_MAX_SWEEP.
+void test_fit_arcs() {
+    const float tolerance = .01;
+    vector<Vector3f> points = arc_points(10, 0, M_PI / 2, .05);
+    vector<move> out;
+    fit_arcs(points, tolerance, out);
+    bool ok = out.size() == 1 && out[0].type == MOVE_ARC_CCW
+        && out[0].end == points.back();
+    if (ok) {
+        float r = (points[0] - out[0].center).norm();
+        for (auto p = points.begin(); p != points.end(); p++) {
+            ok = ok && fabs((*p - out[0].center).norm() - r) <= tolerance;
+        }
+    }
+    check(ok, "arc fitting turns a quarter circle into one arc");
+
+    vector<Vector3f> reversed(points.rbegin(), points.rend());
+    out.clear();
+    fit_arcs(reversed, tolerance, out);
+    check(out.size() == 1 && out[0].type == MOVE_ARC_CW,
+            "arc fitting turns a quarter circle traced backwards clockwise");
+
+    vector<Vector3f> line;
+    for (int i = 0; i <= 20; i++) {
+        line.push_back(Vector3f(1 + i * .3, 2 + i * .1, 1));
+    }
+    out.clear();
+    fit_arcs(line, tolerance, out);
+    ok = out.size() == line.size() - 1;
+    for (auto m = out.begin(); m != out.end(); m++) {
+        ok = ok && m->type == MOVE_LINEAR;
+    }
+    check(ok, "arc fitting leaves a straight run as lines");
+
+    points = arc_points(10, 0, 2 * M_PI, .05);
+    float step = 2 * M_PI / (points.size() - 1);
+    out.clear();
+    fit_arcs(points, tolerance, out);
+    // the arcs' ends are points of the circle, so how far each one sweeps
+    // is the number of steps between its ends
+    ok = out.size() > 1;
+    size_t from = 0;
+    for (auto m = out.begin(); m != out.end(); m++) {
+        size_t to = from + 1;
+        while (to < points.size() && points[to] != m->end) {
+            to++;
+        }
+        ok = ok && m->type == MOVE_ARC_CCW && to < points.size()
+            && (to - from) * step <= ARC_MAX_SWEEP;
+        from = to;
+    }
+    check(ok && from == points.size() - 1,
+            "arc fitting splits a whole circle into shorter arcs");
+}
+
+// roughing starts a stepdown below the tip of a pyramid, where the stock is
+// still whole, so the tool has to travel above the tip, not that layer
+void test_rough_rapids() {
+    mesh m;
+    Vector3f tip(0, 0, 3), base[4] = {
+        Vector3f(-1, -1, 0), Vector3f(1, -1, 0),
+        Vector3f(1, 1, 0), Vector3f(-1, 1, 0) };
+    for (int i = 0; i < 4; i++) {
+        addtri(m, base[i], base[(i + 1) % 4], tip);
+    }
+    addtri(m, base[0], base[2], base[1]);
+    addtri(m, base[0], base[3], base[2]);
+    tooldef td;
+    td.shape = TOOL_FLAT;
+    td.r = .2;
+    td.z_accuracy = .5;
+    td.stepdown = 1;
+    td.stock = .05;
+    td.tolerance = .01;
+    td.stepover = .4;
+    td.gap = .1;
+    td.resolution = 0;
+    td.mesh_order = MESH_ORDER_FILE;
+    slicestats stats;
+    path p = rough(m, td, stats, NULL);
+    bool ok = !p.moves.empty();
+    for (auto mv = p.moves.begin(); mv != p.moves.end(); mv++) {
+        ok = ok && (mv->type != MOVE_RAPID || mv->end[2] > 3);
+    }
+    check(ok, "roughing rapids clear the top of the part");
+}
+
+// a square carved into the top of a block: the V-bit comes up out of the
+// surface into the square's corners, so they're cut at the top of the block,
+// and nothing is cut above it
+void test_vcarve_surface() {
+    mesh m;
+    addbox(m, Vector3f(-1, -1, 0), Vector3f(1, 1, 5));
+    tooldef td;
+    td.shape = TOOL_VBIT;
+    td.r = 2;
+    td.angle = M_PI / 6;
+    td.tip_r = 0;
+    td.z_accuracy = .5;
+    td.tolerance = .01;
+    td.gap = .1;
+    td.resolution = 0;
+    td.mesh_order = MESH_ORDER_FILE;
+    vector<levelset> levelsets;
+    slicestats stats;
+    slice(td, m, levelsets, stats);
+    path p = vcarve(m, levelsets, td, stats);
+
+    int corners = 0;
+    bool below = true;
+    for (auto mv = p.moves.begin(); mv != p.moves.end(); mv++) {
+        if (mv->type == MOVE_RAPID) {
+            continue;
+        }
+        below = below && mv->end[2] <= 5 + 1e-4;
+        if (fabs(fabs(mv->end[0]) - 1) < 1e-4
+                && fabs(fabs(mv->end[1]) - 1) < 1e-4
+                && fabs(mv->end[2] - 5) < 1e-4) {
+            corners++;
+        }
+    }
+    check(corners >= 4 && below,
+            "V-carving cuts a square's corners at the surface");
+}
+
+// a wall with nothing either side of it leaves a layer's perimeter open. the
+// in-plane triangle one open end lies on is reported, once, and the ones
+// nowhere near an end aren't.
+void test_inplane_diag() {
+    mesh m;
+    addtri(m, Vector3f(0, -1, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 2));
+    addtri(m, Vector3f(-.5, .25, 1), Vector3f(.5, .25, 1),
+            Vector3f(0, 2, 1));
+    for (int i = 0; i < 50; i++) {
+        addtri(m, Vector3f(5 + i, 0, 1), Vector3f(6 + i, 0, 1),
+                Vector3f(5 + i, 1, 1));
+    }
+    tooldef td;
+    td.tolerance = .01;
+    td.gap = 0;
+    td.resolution = 0;
+    td.mesh_order = MESH_ORDER_FILE;
+    vector<levelset> levelsets;
+    slicestats stats;
+    slice_at(td, m, vector<float>(1, 1), levelsets, stats);
+    check(stats.diag.counts[DIAG_OPEN_END] == 2
+            && stats.diag.counts[DIAG_INPLANE_TRIANGLE] == 1,
+            "only the in-plane triangle under an open end is reported");
+}
+
+// a star with spikes so close together that one edge of it can't be split
+// into the triangulation. the triangles are told inside from outside by
+// their centroids then, so the axis still stays inside the star.
+void test_medial_unconformed() {
+    static const float radii[] = {
+        1, .0234, .0294, 1, .027, .021, .0258, .0288, .0218, .0352, .035, 1,
+        .0362, 1, 1, 1, 1, .0242, 1, 1, .025, 1, 1, .0252, 1, 1, .0228, 1, 1,
+        .025, 1, .0308, 1, .0258, .0262, .0286,
+    };
+    const int n = sizeof(radii) / sizeof(radii[0]);
+    region reg;
+    for (int i = 0; i < n; i++) {
+        float a = 2 * M_PI * i / n;
+        reg.outer.push_back(Vector2f(radii[i] * cos(a), radii[i] * sin(a)));
+    }
+    vector<medial_branch> branches;
+    size_t unconformed = medial_axis(reg, .05, branches);
+    bool inside = !branches.empty();
+    for (auto br = branches.begin(); br != branches.end(); br++) {
+        for (auto p = br->points.begin(); p != br->points.end(); p++) {
+            float edge = INFINITY;
+            for (int i = 0; i < n; i++) {
+                edge = std::min(edge, point_segment_distance2(
+                            *p, reg.outer[i], reg.outer[(i + 1) % n]));
+            }
+            inside = inside
+                && (point_in_polygon(*p, reg.outer) || edge < 1e-8);
+        }
+    }
+    check(unconformed > 0 && inside,
+            "a medial axis missing a boundary edge stays inside the region");
+}
+
+// the index of the vertex at p, added if there isn't one there yet
+uint32_t vertex_at(vector<Vector3f> &positions, const Vector3f &p) {
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (positions[i] == p) {
+            return i;
+        }
+    }
+    positions.push_back(p);
+    return positions.size() - 1;
+}
+
+// adds the quad a b c d, counterclockwise from above, as two triangles
+void addquad(
+        vector<Vector3f> &positions, vector<uint32_t> &indices,
+        const Vector3f &a, const Vector3f &b, const Vector3f &c,
+        const Vector3f &d) {
+    uint32_t v[4] = {
+        vertex_at(positions, a), vertex_at(positions, b),
+        vertex_at(positions, c), vertex_at(positions, d) };
+    uint32_t tris[6] = { v[0], v[1], v[2], v[0], v[2], v[3] };
+    indices.insert(indices.end(), tris, tris + 6);
+}
+
+// a ramp of facets too small to rise more than the tolerance isn't flat,
+// floors either side of a multiple of the tolerance are one area, and two
+// squares touching at a corner are one area of two regions
+void test_flat_areas() {
+    vector<Vector3f> positions;
+    vector<uint32_t> indices;
+    float slope = tan(42 * M_PI / 180);
+    for (int i = 0; i < 20; i++) {
+        float x0 = i * .01, x1 = x0 + .01;
+        addquad(positions, indices,
+                Vector3f(x0, 0, x0 * slope), Vector3f(x1, 0, x1 * slope),
+                Vector3f(x1, .01, x1 * slope), Vector3f(x0, .01, x0 * slope));
+    }
+    vector<flatarea> flats;
+    find_flat_areas(halfedges(positions, indices), .01, flats);
+    check(flats.empty(), "a finely tessellated ramp has no flat areas");
+
+    positions.clear();
+    indices.clear();
+    addquad(positions, indices, Vector3f(0, 0, .0099), Vector3f(1, 0, .0099),
+            Vector3f(1, 1, .0099), Vector3f(0, 1, .0099));
+    addquad(positions, indices, Vector3f(2, 0, .0101), Vector3f(3, 0, .0101),
+            Vector3f(3, 1, .0101), Vector3f(2, 1, .0101));
+    find_flat_areas(halfedges(positions, indices), .01, flats);
+    check(flats.size() == 1 && flats[0].up
+            && regions_are(flats[0].regions, 2, 0, 2),
+            "floors either side of a tolerance step are one area");
+
+    positions.clear();
+    indices.clear();
+    addquad(positions, indices, Vector3f(0, 0, 0), Vector3f(1, 0, 0),
+            Vector3f(1, 1, 0), Vector3f(0, 1, 0));
+    addquad(positions, indices, Vector3f(1, 1, 0), Vector3f(2, 1, 0),
+            Vector3f(2, 2, 0), Vector3f(1, 2, 0));
+    find_flat_areas(halfedges(positions, indices), .01, flats);
+    check(flats.size() == 1 && regions_are(flats[0].regions, 2, 0, 2),
+            "squares touching at a corner are separate regions");
+}
+
+// a spike running on past the end of a straight run and doubling back along
+// it lies on the run's line, but far from the run itself, so it has to stay
+void test_simplify_spike() {
+    vector<float> xs = { 0, 5, 4, 3 }, ys = { 0, 0, 0, 0 };
+    vector<bool> keep;
+    douglas_peucker(xs, ys, .01, keep);
+    check(keep[1], "simplification keeps a spike doubling back along a line");
+    check(!keep[2], "simplification drops a point on the way back");
+}
+
 int main(int argc, char* argv[]) {
     face *tri = mktri(
             9.807850, -1.950900, 0.000000,
             9.807850, -1.950900, -5.000000,
             9.871900, -1.300600, -6.666667);
     lineseg l = isect_tri_xy_plane(-5, tri);
-    std::cout << "found lineseg:" << std::endl << l << std::endl;
-    std::cout << "length: " << (l.p1 - l.p2).norm() << std::endl;
+    cout << "found lineseg:" << endl << l << endl;
+    cout << "length: " << (l.p1 - l.p2).norm() << endl;
+
+    test_drop_finish_walls(TOOL_FLAT);
+    test_drop_finish_walls(TOOL_BALL);
+    test_simplify_spike();
+    test_boolean();
+    test_offset();
+    test_orient2d();
+    test_triangle_in_plane();
+    test_fit_arcs();
+    test_rough_rapids();
+    test_flat_areas();
+    test_vcarve_surface();
+    test_inplane_diag();
+    test_medial_unconformed();
+    return failures > 0 ? 1 : 0;
 }
@@ -0,0 +1,62 @@
+#include "spatial.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::max;
+using std::min;
+using std::vector;
+
+uint64_t cell_key(const int32_t x, const int32_t y) {
+    return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+}
+
+pointgrid::pointgrid(const float cell_size) :
+        cell_size(cell_size), min_x(INT32_MAX), max_x(INT32_MIN),
+        min_y(INT32_MAX), max_y(INT32_MIN) {}
+
+int32_t pointgrid::cell_of(const float v) const {
+    return (int32_t) floor(v / cell_size);
+}
+
+void pointgrid::insert(const Vector2f &p, const uint32_t id) {
+    int32_t x = cell_of(p[0]), y = cell_of(p[1]);
+    entry e;
+    e.p = p;
+    e.id = id;
+    cells[cell_key(x, y)].push_back(e);
+    min_x = min(min_x, x);
+    max_x = max(max_x, x);
+    min_y = min(min_y, y);
+    max_y = max(max_y, y);
+}
+
+segmentgrid::segmentgrid(const float cell_size) :
+        cell_size(cell_size), query_id(0) {}
+
+void segmentgrid::insert(
+        const Vector2f &a, const Vector2f &b, const uint32_t id) {
+    walk(a, b, [&](const int32_t x, const int32_t y) {
+        cells[cell_key(x, y)].push_back(id);
+    });
+    if (id >= seen.size()) {
+        seen.resize(id + 1, 0);
+    }
+}
+
+void segmentgrid::query(
+        const Vector2f &a, const Vector2f &b, vector<uint32_t> &out) {
+    query_id++;
+    walk(a, b, [&](const int32_t x, const int32_t y) {
+        auto cell = cells.find(cell_key(x, y));
+        if (cell == cells.end()) {
+            return;
+        }
+        for (auto id = cell->second.begin(); id != cell->second.end(); id++) {
+            if (seen[*id] != query_id) {
+                seen[*id] = query_id;
+                out.push_back(*id);
+            }
+        }
+    });
+}
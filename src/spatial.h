@@ -0,0 +1,159 @@
+#ifndef __TP_SPATIAL_H__
+#define __TP_SPATIAL_H__
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+// uniform grids over the xy-plane, bucketing items by the square cells they
+// touch. cells are hashed, so only occupied cells cost memory and lookups are
+// expected constant time.
+
+// hash key for the cell at integer coordinates (x, y)
+uint64_t cell_key(const int32_t x, const int32_t y);
+
+// points with an id each, for nearest neighbour queries.
+class pointgrid {
+    public:
+        pointgrid(const float cell_size);
+
+        void insert(const Vector2f &p, const uint32_t id);
+        // finds the closest point to p for which accept(id) returns true and
+        // that is at most max_dist away. returns false if there is none.
+        template <typename F>
+        bool nearest(
+                const Vector2f &p, const float max_dist, F accept,
+                uint32_t &id) const;
+
+    private:
+        struct entry {
+            Vector2f p;
+            uint32_t id;
+        };
+
+        int32_t cell_of(const float v) const;
+
+        float cell_size;
+        std::unordered_map<uint64_t, std::vector<entry>> cells;
+        // bounds of the occupied cells, so searches know when to stop
+        int32_t min_x, max_x, min_y, max_y;
+};
+
+// line segments with an id each, for finding the segments near another one.
+// segments are only filed under the cells they actually pass through, so long
+// diagonal segments don't fill up the whole box around them.
+class segmentgrid {
+    public:
+        segmentgrid(const float cell_size);
+
+        void insert(const Vector2f &a, const Vector2f &b, const uint32_t id);
+        // appends the id of every segment sharing a cell with the segment from
+        // a to b to out, each id once.
+        void query(
+                const Vector2f &a, const Vector2f &b,
+                std::vector<uint32_t> &out);
+
+    private:
+        // calls visit(x, y) for every cell the segment from a to b passes
+        // through, walking from one cell to the next along the segment
+        template <typename F>
+        void walk(const Vector2f &a, const Vector2f &b, F visit) const;
+
+        float cell_size;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+        // stamp per segment id of the last query that returned it
+        std::vector<uint32_t> seen;
+        uint32_t query_id;
+};
+
+template <typename F>
+bool pointgrid::nearest(
+        const Vector2f &p, const float max_dist, F accept,
+        uint32_t &id) const {
+    if (cells.empty()) {
+        return false;
+    }
+    int32_t cx = cell_of(p[0]), cy = cell_of(p[1]);
+    float best = max_dist * max_dist;
+    bool found = false;
+
+    auto visit = [&](const int32_t x, const int32_t y) {
+        auto cell = cells.find(cell_key(x, y));
+        if (cell == cells.end()) {
+            return;
+        }
+        for (auto e = cell->second.begin(); e != cell->second.end(); e++) {
+            float dist = (e->p - p).squaredNorm();
+            if (dist <= best && accept(e->id)) {
+                best = dist;
+                id = e->id;
+                found = true;
+            }
+        }
+    };
+
+    // search square rings of cells around p. anything in ring k is at least
+    // k - 1 cells away, so we can stop once that's further than the best
+    // point so far, or once the ring is past every occupied cell.
+    visit(cx, cy);
+    for (int32_t ring = 1; ; ring++) {
+        float ring_dist = (ring - 1) * cell_size;
+        if (ring_dist * ring_dist > best) {
+            break;
+        }
+        if (cx - ring < min_x && cx + ring > max_x
+                && cy - ring < min_y && cy + ring > max_y) {
+            break;
+        }
+        for (int32_t x = cx - ring; x <= cx + ring; x++) {
+            visit(x, cy - ring);
+            visit(x, cy + ring);
+        }
+        for (int32_t y = cy - ring + 1; y < cy + ring; y++) {
+            visit(cx - ring, y);
+            visit(cx + ring, y);
+        }
+    }
+    return found;
+}
+
+template <typename F>
+void segmentgrid::walk(const Vector2f &a, const Vector2f &b, F visit) const {
+    int32_t x = (int32_t) floor(a[0] / cell_size),
+            y = (int32_t) floor(a[1] / cell_size);
+    const int32_t end_x = (int32_t) floor(b[0] / cell_size),
+                  end_y = (int32_t) floor(b[1] / cell_size);
+    const int32_t step_x = end_x > x ? 1 : -1, step_y = end_y > y ? 1 : -1;
+
+    // how far along the segment, from 0 to 1, the next cell boundary in
+    // either direction is, and how far apart those boundaries are
+    Vector2d d = (b - a).cast<double>();
+    double next_x = INFINITY, next_y = INFINITY,
+           delta_x = INFINITY, delta_y = INFINITY;
+    if (d[0] != 0) {
+        delta_x = cell_size / fabs(d[0]);
+        next_x = ((x + (step_x > 0)) * (double) cell_size - a[0]) / d[0];
+    }
+    if (d[1] != 0) {
+        delta_y = cell_size / fabs(d[1]);
+        next_y = ((y + (step_y > 0)) * (double) cell_size - a[1]) / d[1];
+    }
+
+    visit(x, y);
+    while (x != end_x || y != end_y) {
+        if ((next_x < next_y && x != end_x) || y == end_y) {
+            x += step_x;
+            next_x += delta_x;
+        } else {
+            y += step_y;
+            next_y += delta_y;
+        }
+        visit(x, y);
+    }
+}
+
+#endif
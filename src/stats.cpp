@@ -0,0 +1,92 @@
+#include "stats.h"
+
+#include <algorithm>
+
+using std::ostream;
+
+// what each kind of diagnostic is called in the report
+static const char *diag_names[DIAG_KINDS] = {
+    "degenerate triangles",
+    "twisted faces",
+    "triangles in a layer's plane",
+    "branching perimeter verteces",
+    "open perimeter ends",
+    "region edges left out of a medial axis",
+};
+
+slicediag::slicediag() {
+    for (int i = 0; i < DIAG_KINDS; i++) {
+        counts[i] = 0;
+    }
+}
+
+void slicediag::report(const int kind, const Vector3f &where) {
+    counts[kind]++;
+    if (samples[kind].size() < DIAG_SAMPLES) {
+        samples[kind].push_back(where);
+    }
+}
+
+void slicediag::merge(const slicediag &other) {
+    for (int i = 0; i < DIAG_KINDS; i++) {
+        counts[i] += other.counts[i];
+        for (auto s = other.samples[i].begin();
+                s != other.samples[i].end()
+                && samples[i].size() < DIAG_SAMPLES; s++) {
+            samples[i].push_back(*s);
+        }
+    }
+}
+
+ostream& operator<< (ostream &out, const slicediag &d) {
+    out << "diagnostics:";
+    bool any = false;
+    for (int i = 0; i < DIAG_KINDS; i++) {
+        if (d.counts[i] == 0) {
+            continue;
+        }
+        any = true;
+        out << std::endl << "    " << diag_names[i] << ": " << d.counts[i];
+        for (auto s = d.samples[i].begin(); s != d.samples[i].end(); s++) {
+            out << std::endl << "        at " << s->transpose();
+        }
+        if (d.counts[i] > d.samples[i].size()) {
+            out << std::endl << "        ...";
+        }
+    }
+    if (!any) {
+        out << " none";
+    }
+    return out;
+}
+
+slicestats::slicestats() :
+        simplify_verteces_in(0), simplify_verteces_out(0), gaps_closed(0),
+        scratch_blocks(0), scratch_bytes(0), output_blocks(0),
+        output_bytes(0) {}
+
+void slicestats::merge(const slicestats &other) {
+    simplify_verteces_in += other.simplify_verteces_in;
+    simplify_verteces_out += other.simplify_verteces_out;
+    gaps_closed += other.gaps_closed;
+    scratch_blocks += other.scratch_blocks;
+    scratch_bytes = std::max(scratch_bytes, other.scratch_bytes);
+    output_blocks += other.output_blocks;
+    output_bytes += other.output_bytes;
+    diag.merge(other.diag);
+}
+
+ostream& operator<< (ostream &out, const slicestats &s) {
+    out << "simplification: " << s.simplify_verteces_in << " -> "
+        << s.simplify_verteces_out << " verteces";
+    if (s.simplify_verteces_in > 0) {
+        out << " (" << 100. * s.simplify_verteces_out / s.simplify_verteces_in
+            << "%)";
+    }
+    out << ", " << s.gaps_closed << " gaps closed" << std::endl
+        << "scratch: " << s.scratch_blocks << " arena blocks, "
+        << s.scratch_bytes / 1024 << " KiB per thread" << std::endl
+        << "output: " << s.output_blocks << " arena blocks, "
+        << s.output_bytes / 1024 << " KiB" << std::endl << s.diag;
+    return out;
+}
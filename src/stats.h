@@ -0,0 +1,84 @@
+#ifndef __TP_STATS_H__
+#define __TP_STATS_H__
+
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+
+using namespace Eigen;
+
+// kinds of trouble with a mesh that slicing, and the operations run on its
+// layers, work around
+// triangles with no area
+#define DIAG_DEGENERATE_TRIANGLE (0)
+// faces that twist over themselves, or have fewer than three sides, so they
+// can't be split into triangles cleanly
+#define DIAG_TWISTED_FACE (1)
+// triangles lying flat in a layer's plane that a perimeter branches or
+// breaks off on. flat floors cut exactly at a layer's height are fine by
+// themselves, since the layer is sliced just above them.
+#define DIAG_INPLANE_TRIANGLE (2)
+// perimeter verteces more than two segments meet at, where the surface isn't
+// manifold
+#define DIAG_BRANCHING_VERTEX (3)
+// perimeter ends left open, with no other end close enough to join
+#define DIAG_OPEN_END (4)
+// edges of a region's boundary that its medial axis's triangulation still
+// didn't have after splitting them, where the region is so thin or so finely
+// detailed that V-carving may have cut it a little off
+#define DIAG_MEDIAL_EDGE (5)
+#define DIAG_KINDS (6)
+
+// most examples of each kind kept for the report
+#define DIAG_SAMPLES (8)
+
+// counts of each kind of mesh trouble, with where the first few happened.
+// every layer gets its own, so slicing layers in parallel never shares one,
+// and they're merged in order of height once the layers are done.
+class slicediag {
+    public:
+        slicediag();
+
+        // counts one case of kind, keeping where it happened as an example if
+        // there's still room for one
+        void report(const int kind, const Vector3f &where);
+        // adds other's counts to these, and its examples while there's room
+        void merge(const slicediag &other);
+
+        friend std::ostream& operator<< (std::ostream &out, const slicediag &d);
+
+        uint64_t counts[DIAG_KINDS];
+        std::vector<Vector3f> samples[DIAG_KINDS];
+};
+
+// counters collected over a whole slicing job, printed once it's done.
+class slicestats {
+    public:
+        slicestats();
+
+        // adds the counters of other, such as a single layer's, to these
+        void merge(const slicestats &other);
+
+        friend std::ostream& operator<< (
+                std::ostream &out, const slicestats &s);
+
+        // perimeter verteces before and after simplification
+        uint64_t simplify_verteces_in;
+        uint64_t simplify_verteces_out;
+        // joins bridging holes in the mesh's surface that left perimeters
+        // open. the ends that couldn't be joined are in diag.
+        uint64_t gaps_closed;
+        // blocks slicing's scratch arenas took from the heap, and the most
+        // memory any one of them held
+        uint64_t scratch_blocks;
+        uint64_t scratch_bytes;
+        // the same for the arenas the layers' own lists are kept in, and all
+        // the memory they hold between them
+        uint64_t output_blocks;
+        uint64_t output_bytes;
+
+        slicediag diag;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "stock.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "bvh.h"
+#include "cutter.h"
+#include "dropcut.h"
+#include "parallel.h"
+#include "polygon.h"
+
+using std::endl;
+using std::max;
+using std::min;
+using std::ostream;
+using std::vector;
+
+// rows of the z-map cut together by one thread
+#define BAND_ROWS (16)
+
+// a straight piece of the path
+struct sweep {
+    Vector3f a, b;
+    bool rapid;
+};
+
+zmap::zmap() : x0(0), y0(0), step(1), nx(0), ny(0), top(0), bottom(0) {}
+
+zmap::zmap(const bounds &b, const float margin, const float step)
+        : x0(b.min_x - margin), y0(b.min_y - margin), step(step),
+        top(b.max_z), bottom(b.min_z) {
+    nx = (uint32_t) ceil((b.max_x + margin - x0) / step) + 1;
+    ny = (uint32_t) ceil((b.max_y + margin - y0) / step) + 1;
+    z.assign((size_t) nx * ny, top);
+}
+
+// splits the path into straight sweeps, with arcs broken into chords that
+// stay within tolerance of them. the first move starts where it ends.
+void path_sweeps(const path &p, const float tolerance, vector<sweep> &out) {
+    if (p.moves.empty()) {
+        return;
+    }
+    Vector3f at = p.moves[0].end;
+    for (auto m = p.moves.begin(); m != p.moves.end(); m++) {
+        if (m->type != MOVE_ARC_CW && m->type != MOVE_ARC_CCW) {
+            sweep s = { at, m->end, m->type == MOVE_RAPID };
+            out.push_back(s);
+            at = m->end;
+            continue;
+        }
+
+        Vector2f from(at[0] - m->center[0], at[1] - m->center[1]);
+        Vector2f to(m->end[0] - m->center[0], m->end[1] - m->center[1]);
+        float radius = from.norm();
+        float start = atan2(from[1], from[0]);
+        float angle = atan2(to[1], to[0]) - start;
+        if (m->type == MOVE_ARC_CCW) {
+            while (angle <= 0) {
+                angle += 2 * M_PI;
+            }
+        } else {
+            while (angle >= 0) {
+                angle -= 2 * M_PI;
+            }
+        }
+        // the sagitta of a chord spanning an angle a is r (1 - cos(a / 2))
+        float max_angle = radius > tolerance / 2
+            ? 2 * acos(1 - tolerance / radius) : M_PI;
+        int chords = max(1, (int) ceil(fabs(angle) / max_angle));
+        for (int k = 1; k <= chords; k++) {
+            float f = (float) k / chords, a = start + f * angle;
+            Vector3f next = k == chords ? m->end : Vector3f(
+                    m->center[0] + radius * cos(a),
+                    m->center[1] + radius * sin(a),
+                    at[2] + f * (m->end[2] - at[2]));
+            sweep s = { k == 1 ? at : out.back().b, next, false };
+            out.push_back(s);
+        }
+        at = m->end;
+    }
+}
+
+// cuts the rows [row0, row1) of the stock with a single sweep. returns
+// whether any column was lowered.
+template <typename S>
+bool cut_sweep(
+        const S &shape, const sweep &s, zmap &stock, const uint32_t row0,
+        const uint32_t row1) {
+    float r = shape.r;
+    Vector2f a(s.a[0], s.a[1]), b(s.b[0], s.b[1]), ab = b - a;
+    float len2 = ab.squaredNorm();
+    float lo_y = min(a[1], b[1]) - r, hi_y = max(a[1], b[1]) + r;
+    float first_row = ceil((lo_y - stock.y0) / stock.step),
+          last_row = floor((hi_y - stock.y0) / stock.step);
+    if (last_row < 0) {
+        return false;
+    }
+    uint32_t j0 = (uint32_t) max((float) row0, first_row);
+    uint32_t j1 = min(row1, (uint32_t) last_row + 1);
+
+    bool cut = false;
+    for (uint32_t j = j0; j < j1; j++) {
+        float y = stock.y(j);
+        span sp;
+        if (!capsule_span(a, b, y, r, sp)) {
+            continue;
+        }
+        float first = ceil((sp.lo - stock.x0) / stock.step),
+              end = floor((sp.hi - stock.x0) / stock.step) + 1;
+        first = max(0.f, first);
+        end = min((float) stock.nx, end);
+        if (first >= end) {
+            continue;
+        }
+        uint32_t i0 = (uint32_t) first, i1 = (uint32_t) end;
+        float *row = &stock.z[(size_t) j * stock.nx];
+
+        if (s.a[2] == s.b[2]) {
+            // the tool stays level, so the lowest it gets over a column is
+            // its profile at the column's distance from the segment
+            float z = s.a[2], cy = y - a[1];
+            for (uint32_t i = i0; i < i1; i++) {
+                float cx = stock.x(i) - a[0];
+                float t = len2 > 0 ? (cx * ab[0] + cy * ab[1]) / len2 : 0;
+                t = min(1.f, max(0.f, t));
+                float dx = cx - t * ab[0], dy = cy - t * ab[1];
+                float d = min(r, (float) sqrt(dx * dx + dy * dy));
+                float bottom = z + shape.height(d);
+                cut |= bottom < row[i];
+                row[i] = min(row[i], bottom);
+            }
+            continue;
+        }
+        for (uint32_t i = i0; i < i1; i++) {
+            float bottom = sweep_segment(
+                    shape, s.a, s.b, Vector2f(stock.x(i), y));
+            cut |= bottom < row[i];
+            row[i] = min(row[i], bottom);
+        }
+    }
+    return cut;
+}
+
+template <typename S>
+uint64_t cut_sweeps(const S &shape, const vector<sweep> &sweeps, zmap &stock) {
+    size_t bands = (stock.ny + BAND_ROWS - 1) / BAND_ROWS;
+    auto band_range = [&](const sweep &s, size_t &first, size_t &last) {
+        float lo = min(s.a[1], s.b[1]) - shape.r - stock.y0;
+        float hi = max(s.a[1], s.b[1]) + shape.r - stock.y0;
+        first = (size_t) max(0.f, lo / stock.step) / BAND_ROWS;
+        last = min(bands, (size_t) max(0.f, hi / stock.step) / BAND_ROWS + 1);
+    };
+
+    // counting sort of the sweeps into every band they pass over
+    vector<size_t> starts(bands + 1, 0);
+    size_t first, last;
+    for (auto s = sweeps.begin(); s != sweeps.end(); s++) {
+        band_range(*s, first, last);
+        for (size_t band = first; band < last; band++) {
+            starts[band + 1]++;
+        }
+    }
+    for (size_t band = 0; band < bands; band++) {
+        starts[band + 1] += starts[band];
+    }
+    vector<size_t> members(starts[bands]), fill(starts.begin(), starts.end());
+    for (size_t i = 0; i < sweeps.size(); i++) {
+        band_range(sweeps[i], first, last);
+        for (size_t band = first; band < last; band++) {
+            members[fill[band]++] = i;
+        }
+    }
+
+    // sweeps whose tool went through stock, per band; a rapid can show up in
+    // more than one
+    vector<vector<size_t>> rapid_cuts(bands);
+    parallel_for(bands, [&](size_t band) {
+        uint32_t row0 = band * BAND_ROWS;
+        uint32_t row1 = min(stock.ny, (uint32_t) (row0 + BAND_ROWS));
+        for (size_t k = starts[band]; k < starts[band + 1]; k++) {
+            const sweep &s = sweeps[members[k]];
+            if (cut_sweep(shape, s, stock, row0, row1) && s.rapid) {
+                rapid_cuts[band].push_back(members[k]);
+            }
+        }
+    });
+
+    vector<size_t> all;
+    for (auto rc = rapid_cuts.begin(); rc != rapid_cuts.end(); rc++) {
+        all.insert(all.end(), rc->begin(), rc->end());
+    }
+    std::sort(all.begin(), all.end());
+    return std::unique(all.begin(), all.end()) - all.begin();
+}
+
+uint64_t cut_path(const path &p, const tooldef &td, zmap &stock) {
+    vector<sweep> sweeps;
+    path_sweeps(p, td.tolerance, sweeps);
+    switch (td.shape) {
+        case TOOL_BALL:
+            return cut_sweeps(ballcutter(td), sweeps, stock);
+        case TOOL_BULL:
+            return cut_sweeps(bullcutter(td), sweeps, stock);
+        case TOOL_VBIT:
+            return cut_sweeps(vcutter(td), sweeps, stock);
+        case TOOL_TAPERED_BALL:
+            return cut_sweeps(taperedcutter(td), sweeps, stock);
+        default:
+            return cut_sweeps(flatcutter(td), sweeps, stock);
+    }
+}
+
+void compare_stock(
+        const zmap &stock, const mesh &m, const float tolerance,
+        deviation &out) {
+    bvh tree(m);
+
+    // the mesh's height over every column is where a tool with no width comes
+    // to rest when dropped on it
+    tooldef probe;
+    probe.shape = TOOL_FLAT;
+    probe.r = 0;
+
+    vector<deviation> rows(stock.ny);
+    parallel_for(stock.ny, [&](size_t j) {
+        vector<float> part;
+        drop_line(
+                tree, probe, stock.y(j), stock.x0, stock.step, stock.nx,
+                -INFINITY, part);
+        deviation &d = rows[j];
+        for (uint32_t i = 0; i < stock.nx; i++) {
+            float z = stock.at(i, j);
+            d.removed_volume += stock.top - z;
+            if (part[i] == -INFINITY) {
+                continue;
+            }
+            d.columns++;
+            float diff = z - part[i];
+            if (diff < -tolerance) {
+                d.gouged++;
+                d.max_gouge = max(d.max_gouge, -diff);
+            } else if (diff > tolerance) {
+                d.leftover++;
+                d.max_leftover = max(d.max_leftover, diff);
+            }
+            d.leftover_volume += max(0.f, diff);
+        }
+    });
+
+    float area = stock.step * stock.step;
+    for (auto d = rows.begin(); d != rows.end(); d++) {
+        out.columns += d->columns;
+        out.gouged += d->gouged;
+        out.max_gouge = max(out.max_gouge, d->max_gouge);
+        out.leftover += d->leftover;
+        out.max_leftover = max(out.max_leftover, d->max_leftover);
+        out.removed_volume += d->removed_volume * area;
+        out.leftover_volume += d->leftover_volume * area;
+    }
+}
+
+void verify_path(
+        const path &p, const mesh &m, const tooldef &td, const float step,
+        deviation &out) {
+    zmap stock(m.get_bounds(), td.r + step, step);
+    out.rapid_cuts += cut_path(p, td, stock);
+    compare_stock(stock, m, td.tolerance, out);
+}
+
+deviation::deviation() :
+        columns(0), gouged(0), max_gouge(0), leftover(0), max_leftover(0),
+        removed_volume(0), leftover_volume(0), rapid_cuts(0) {}
+
+ostream& operator<< (ostream &out, const deviation &d) {
+    out << "removed " << d.removed_volume << ", left over part "
+        << d.leftover_volume << endl;
+    out << "columns over part: " << d.columns << ", gouged " << d.gouged
+        << " (max " << d.max_gouge << "), left over " << d.leftover
+        << " (max " << d.max_leftover << ")" << endl;
+    out << "rapids through stock: " << d.rapid_cuts;
+    return out;
+}
@@ -0,0 +1,94 @@
+#ifndef __TP_STOCK_H__
+#define __TP_STOCK_H__
+
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+#include <meshparse/mesh.h>
+
+#include "path.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+using namespace meshparse;
+
+// the stock as a z-map: a square grid of vertical columns of material, or
+// dexels, each of which only keeps the height of its top. that can't model
+// undercuts, but nothing a three-axis machine does makes them.
+class zmap {
+    public:
+        zmap();
+        // a block of stock covering the given bounds, with columns step apart
+        // and margin extra on every side in x and y
+        zmap(const bounds &b, const float margin, const float step);
+
+        float x(const uint32_t i) const { return x0 + i * step; }
+        float y(const uint32_t j) const { return y0 + j * step; }
+        float &at(const uint32_t i, const uint32_t j) {
+            return z[(size_t) j * nx + i];
+        }
+        float at(const uint32_t i, const uint32_t j) const {
+            return z[(size_t) j * nx + i];
+        }
+
+        // center of the first column, and the spacing of the columns
+        float x0, y0, step;
+        uint32_t nx, ny;
+        // the heights the stock started out between
+        float top, bottom;
+        // height of every column, row by row along x
+        std::vector<float> z;
+};
+
+// how the simulated stock compares to the part. only columns over the part
+// are counted, since the stock around it is never meant to be machined to any
+// particular height.
+class deviation {
+    public:
+        deviation();
+
+        friend std::ostream& operator<< (std::ostream &out, const deviation &d);
+
+        // columns over the part
+        uint64_t columns;
+        // columns cut below the part by more than the tolerance, and the
+        // deepest of those cuts
+        uint64_t gouged;
+        float max_gouge;
+        // columns left more than the tolerance above the part, and the most
+        // material left on any of them
+        uint64_t leftover;
+        float max_leftover;
+        // volume of material taken away, and left over the part
+        double removed_volume;
+        double leftover_volume;
+        // rapid moves that went through the stock
+        uint64_t rapid_cuts;
+};
+
+// sweeps the tool along every move of the path, taking away the material it
+// passes through. arcs are split into chords within td.tolerance. returns the
+// number of rapid moves that cut into the stock.
+//
+// the stock only ever gets lower, so the moves can be applied in any order.
+// the rows of the z-map are split into bands, and the moves are sorted into
+// the bands they pass over with a counting sort, so each band can be cut
+// independently, in parallel, by only the moves that touch it. within a row,
+// a horizontal move lowers a contiguous run of columns to the tool's profile
+// in a tight loop; other moves use the swept-cutter test for every column.
+uint64_t cut_path(const path &p, const tooldef &td, zmap &stock);
+
+// compares the stock to the highest point of the mesh above every column.
+// rapid_cuts is left alone.
+void compare_stock(
+        const zmap &stock, const mesh &m, const float tolerance,
+        deviation &out);
+
+// simulates the path on a block of stock around the mesh, with columns spaced
+// step apart, and compares the result to the mesh
+void verify_path(
+        const path &p, const mesh &m, const tooldef &td, const float step,
+        deviation &out);
+
+#endif
@@ -0,0 +1,291 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cutter.h"
+#include "scheduler.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// microbenchmarks for the contact tests of every shape of tool, each run
+// against the same random triangles around the origin, and for slicing a
+// sphere with its faces in every order slicing can keep them in
+
+#define TRIANGLES (4096)
+#define DROPS (200000)
+#define PUSHES (50000)
+
+// rings and segments around the sliced sphere, and its layers
+#define SPHERE_RINGS (300)
+#define SPHERE_SEGMENTS (600)
+#define SPHERE_LAYERS (2000)
+
+// heap allocations made so far anywhere in the program, counted by the
+// replacement operator new below. delete is kept out of line, or gcc sees
+// the free it's inlined into meet memory from new and warns.
+static std::atomic<uint64_t> heap_allocations(0);
+
+void *operator new(size_t size) {
+    heap_allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+double seconds_since(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename S>
+void bench(const char *name, const S &shape, const vector<triangle> &tris) {
+    // sums of the results keep the calls from being optimized away
+    double sum = 0;
+    size_t hits = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < DROPS; i++) {
+        const triangle &t = tris[i % tris.size()];
+        Vector2f c(
+                (t.v[0][0] + t.v[1][0] + t.v[2][0]) / 3 + (i % 7) * .05 - .15,
+                (t.v[0][1] + t.v[1][1] + t.v[2][1]) / 3 + (i % 5) * .05 - .1);
+        float z = drop_triangle(shape, t, c);
+        if (z > -INFINITY) {
+            sum += z;
+            hits++;
+        }
+    }
+    double drop_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < PUSHES; i++) {
+        const triangle &t = tris[i % tris.size()];
+        int axis = i % 2;
+        float at = (t.v[0][1 - axis] + t.v[1][1 - axis]) / 2;
+        float z = (t.v[0][2] + t.v[1][2] + t.v[2][2]) / 3 - .1;
+        float lo, hi;
+        if (push_triangle(shape, t, axis, at, z, lo, hi)) {
+            sum += hi - lo;
+            hits++;
+        }
+    }
+    double push_time = seconds_since(start);
+
+    cout << name << ": drop " << drop_time / DROPS * 1e9 << " ns, push "
+        << push_time / PUSHES * 1e9 << " ns (" << hits << " hits, checksum "
+        << sum << ")" << endl;
+}
+
+// counts the cache misses of every thread of the process while it's running,
+// if the kernel lets it. a counter only follows the thread it was opened on
+// and threads started after it, so the scheduler's workers, which live from
+// the first parallel stage on, get a counter each, found by listing the
+// process's threads once the scheduler is up.
+class cachecounter {
+    public:
+        cachecounter() : failed(false) {}
+
+        void start() {
+            scheduler::get();
+#ifdef __linux__
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            failed = false;
+            DIR *tasks = opendir("/proc/self/task");
+            if (tasks == NULL) {
+                failed = true;
+                return;
+            }
+            struct dirent *d;
+            while ((d = readdir(tasks)) != NULL) {
+                if (d->d_name[0] == '.') {
+                    continue;
+                }
+                int fd = syscall(
+                        __NR_perf_event_open, &attr, atoi(d->d_name), -1, -1,
+                        0);
+                if (fd < 0) {
+                    failed = true;
+                    continue;
+                }
+                fds.push_back(fd);
+            }
+            closedir(tasks);
+            for (auto fd = fds.begin(); fd != fds.end(); fd++) {
+                ioctl(*fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(*fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // the misses since start summed over all threads, or -1 if any of
+        // them couldn't be counted
+        int64_t stop() {
+            int64_t total = -1;
+#ifdef __linux__
+            for (auto fd = fds.begin(); fd != fds.end(); fd++) {
+                ioctl(*fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+            total = failed || fds.empty() ? -1 : 0;
+            for (auto fd = fds.begin(); fd != fds.end(); fd++) {
+                int64_t misses;
+                if (read(*fd, &misses, sizeof(misses)) != sizeof(misses)) {
+                    total = -1;
+                } else if (total >= 0) {
+                    total += misses;
+                }
+                close(*fd);
+            }
+            fds.clear();
+#endif
+            return total;
+        }
+
+    private:
+        vector<int> fds;
+        bool failed;
+};
+
+// a sphere of radius 10 made of quads split into triangles, with its faces
+// shuffled the way they might be in a file from some other program
+void make_sphere(std::mt19937 &rng, mesh &m) {
+    vector<vertex*> grid;
+    for (int i = 0; i <= SPHERE_RINGS; i++) {
+        float polar = M_PI * i / SPHERE_RINGS;
+        for (int j = 0; j < SPHERE_SEGMENTS; j++) {
+            float around = 2 * M_PI * j / SPHERE_SEGMENTS;
+            vertex *v = new vertex();
+            v->loc = 10 * Vector3f(sin(polar) * cos(around),
+                    sin(polar) * sin(around), cos(polar));
+            grid.push_back(v);
+            m.verteces.push_back(v);
+        }
+    }
+    auto add = [&](vertex *a, vertex *b, vertex *c) {
+        face *f = new face();
+        edge *e[3] = { new edge(), new edge(), new edge() };
+        vertex *v[3] = { a, b, c };
+        for (int k = 0; k < 3; k++) {
+            e[k]->vert = v[k];
+            e[k]->next = e[(k + 1) % 3];
+            e[k]->f = f;
+        }
+        f->e = e[0];
+        m.faces.push_back(f);
+    };
+    for (int i = 0; i < SPHERE_RINGS; i++) {
+        for (int j = 0; j < SPHERE_SEGMENTS; j++) {
+            int k = (j + 1) % SPHERE_SEGMENTS;
+            vertex *a = grid[i * SPHERE_SEGMENTS + j],
+                   *b = grid[i * SPHERE_SEGMENTS + k],
+                   *c = grid[(i + 1) * SPHERE_SEGMENTS + j],
+                   *d = grid[(i + 1) * SPHERE_SEGMENTS + k];
+            add(a, c, d);
+            add(a, d, b);
+        }
+    }
+    std::shuffle(m.faces.begin(), m.faces.end(), rng);
+}
+
+void bench_slice(const char *name, const mesh &m, tooldef td) {
+    vector<float> heights;
+    for (int i = 0; i < SPHERE_LAYERS; i++) {
+        heights.push_back(-10 + 20. * (i + .5) / SPHERE_LAYERS);
+    }
+    vector<levelset> levelsets;
+    slicestats stats;
+    cachecounter misses;
+    misses.start();
+    uint64_t allocations = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    slice_at(td, m, heights, levelsets, stats);
+    double time = seconds_since(start);
+    allocations = heap_allocations - allocations;
+    int64_t count = misses.stop();
+
+    size_t verts = 0;
+    for (auto ls = levelsets.begin(); ls != levelsets.end(); ls++) {
+        verts += ls->vertex_count();
+    }
+    cout << "slice, " << name << " order: " << time * 1e3 << " ms, "
+        << allocations << " heap allocations ("
+        << (double) allocations / SPHERE_LAYERS << " per layer), ";
+    if (count < 0) {
+        cout << "cache misses not available";
+    } else {
+        cout << count << " cache misses";
+    }
+    cout << " (" << verts << " verteces)" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(-1, 1), off(-.3, .3);
+    vector<triangle> tris(TRIANGLES);
+    for (auto t = tris.begin(); t != tris.end(); t++) {
+        Vector3f center(pos(rng), pos(rng), pos(rng));
+        for (int i = 0; i < 3; i++) {
+            t->v[i] = center + Vector3f(off(rng), off(rng), off(rng));
+        }
+    }
+
+    tooldef td;
+    td.r = .2;
+    td.corner_r = .05;
+    td.angle = M_PI / 4;
+    td.tip_r = 0;
+    td.z_accuracy = .5;
+    td.tolerance = .01;
+    td.stepover = .4;
+
+    bench("flat", flatcutter(td), tris);
+    bench("ball", ballcutter(td), tris);
+    bench("bull", bullcutter(td), tris);
+    bench("vbit", vcutter(td), tris);
+    td.angle = M_PI / 18;
+    td.tip_r = .05;
+    bench("taper", taperedcutter(td), tris);
+
+    mesh m;
+    make_sphere(rng, m);
+    td.gap = .1;
+    td.resolution = 0;
+    td.mesh_order = MESH_ORDER_FILE;
+    bench_slice("file", m, td);
+    td.mesh_order = MESH_ORDER_Z;
+    bench_slice("z", m, td);
+    td.mesh_order = MESH_ORDER_MORTON;
+    bench_slice("morton", m, td);
+    cout << scheduler::get().stats() << endl;
+}
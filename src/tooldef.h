@@ -1,12 +1,79 @@
 #ifndef __TP_TOOLDEF_H__
 #define __TP_TOOLDEF_H__
 
+// shapes of tool
+#define TOOL_FLAT (0)
+#define TOOL_BALL (1)
+#define TOOL_BULL (2)
+#define TOOL_VBIT (3)
+#define TOOL_TAPERED_BALL (4)
+
+// orders the mesh's triangles can be laid out in memory while it's worked on:
+// as the file had them, by height, or along a Morton curve through space
+#define MESH_ORDER_FILE (0)
+#define MESH_ORDER_Z (1)
+#define MESH_ORDER_MORTON (2)
+
 typedef struct {
-    // radius in model units
+    // one of the TOOL_ shapes above
+    int shape;
+
+    // radius in model units. for V-bits and tapered ball end mills this is
+    // the radius of the shank, where the tapered part of the tool ends.
     float r;
 
+    // radius of the rounded edge at the tip of a bull nose
+    float corner_r;
+
+    // angle between the tool's axis and its side, in radians, for V-bits and
+    // tapered ball end mills
+    float angle;
+
+    // radius of the flat at the tip of a V-bit (0 for a pointed V, anything
+    // larger for a chamfer mill), or of the ball at the tip of a tapered ball
+    // end mill
+    float tip_r;
+
     // steps between layers
     float z_accuracy;
+
+    // depth of each pass when roughing, usually much more than z_accuracy
+    float stepdown;
+
+    // material left on the walls by roughing passes, in model units, for a
+    // finishing pass to take off
+    float stock;
+
+    // distance between neighbouring passes when clearing an area, as a
+    // fraction of the tool diameter
+    float stepover;
+
+    // speed of cutting moves, in model units per minute
+    float feed;
+
+    // seconds adaptive clearing may spend finding its way through a single
+    // region before it stops refining the tool's heading at every step
+    float adaptive_time;
+
+    // maximum distance, in model units, that generated paths may deviate from
+    // the sliced perimeters when they are simplified or fitted with arcs.
+    // where both happen one after the other, each gets half of it.
+    float tolerance;
+
+    // widest hole in the model's surface, in model units, that slicing bridges
+    // with a straight line to close a layer's perimeters
+    float gap;
+
+    // spacing of the integer grid the layers' perimeters are stored on, in
+    // model units, or 0 to keep them as floats. the grid has to be coarse
+    // enough for every point of the model to be a 32-bit number of steps
+    // from the origin.
+    float resolution;
+
+    // one of the MESH_ORDER_ orders above. sorting the triangles by height
+    // keeps each layer's close together in memory, so slicing streams
+    // through them instead of jumping all over the mesh.
+    int mesh_order;
 } tooldef;
 
 #endif
@@ -0,0 +1,198 @@
+#include "triangulate.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "predicates.h"
+
+using std::pair;
+using std::vector;
+
+// whether p is inside the triangle a b c or on its boundary, for a triangle
+// that turns the way sign says
+bool in_ear(
+        const Vector2f &a, const Vector2f &b, const Vector2f &c,
+        const Vector2f &p, const int sign) {
+    return orient2d(a, b, p) * sign >= 0 && orient2d(b, c, p) * sign >= 0
+        && orient2d(c, a, p) * sign >= 0;
+}
+
+bool split_polygon(const vector<Vector3f> &loc, vector<uint32_t> &corners) {
+    size_t n = loc.size();
+    if (n < 3) {
+        return false;
+    }
+    auto emit = [&](const size_t a, const size_t b, const size_t c) {
+        corners.push_back(a);
+        corners.push_back(b);
+        corners.push_back(c);
+    };
+    if (n == 3) {
+        emit(0, 1, 2);
+        return true;
+    }
+
+    // Newell's normal, which is right for faces that aren't quite flat, and
+    // the face projected along whichever axis it's closest to. the two axes
+    // kept are in the order that makes the projection turn the way the
+    // normal's component along the dropped one says.
+    Vector3f normal = Vector3f::Zero();
+    for (size_t i = 0; i < n; i++) {
+        normal += loc[i].cross(loc[(i + 1) % n]);
+    }
+    int axis;
+    normal.cwiseAbs().maxCoeff(&axis);
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    int sign = normal[axis] < 0 ? -1 : 1;
+    // scratch kept from one face to the next, so splitting a whole mesh
+    // doesn't go to the heap for every face
+    static thread_local vector<Vector2f> flat;
+    flat.clear();
+    for (size_t i = 0; i < n; i++) {
+        flat.push_back(Vector2f(loc[i][u], loc[i][v]));
+    }
+
+    bool convex = true;
+    for (size_t i = 0; i < n && convex; i++) {
+        convex = orient2d(flat[(i + n - 1) % n], flat[i], flat[(i + 1) % n])
+            * sign >= 0;
+    }
+    if (convex) {
+        for (size_t i = 1; i + 1 < n; i++) {
+            emit(0, i, i + 1);
+        }
+        return true;
+    }
+
+    // clip ears, corners that turn the right way with no other corner in
+    // them, until only one triangle is left. a face that twists over itself
+    // may have no ear at all, and then a corner is clipped anyway so this
+    // always finishes.
+    bool clean = true;
+    static thread_local vector<size_t> left;
+    left.clear();
+    for (size_t i = 0; i < n; i++) {
+        left.push_back(i);
+    }
+    while (left.size() > 3) {
+        size_t m = left.size(), clip = m;
+        for (size_t i = 0; i < m; i++) {
+            size_t a = left[(i + m - 1) % m], b = left[i],
+                   c = left[(i + 1) % m];
+            if (orient2d(flat[a], flat[b], flat[c]) * sign <= 0) {
+                continue;
+            }
+            bool ear = true;
+            for (auto p = left.begin(); p != left.end() && ear; p++) {
+                if (*p != a && *p != b && *p != c
+                        && flat[*p] != flat[a] && flat[*p] != flat[b]
+                        && flat[*p] != flat[c]) {
+                    ear = !in_ear(flat[a], flat[b], flat[c], flat[*p], sign);
+                }
+            }
+            if (ear) {
+                clip = i;
+                break;
+            }
+        }
+        if (clip == m) {
+            clean = false;
+            clip = 0;
+        }
+        emit(left[(clip + m - 1) % m], left[clip], left[(clip + 1) % m]);
+        left.erase(left.begin() + clip);
+    }
+    emit(left[0], left[1], left[2]);
+    return clean;
+}
+
+bool face_triangles(const face *f, vector<triangle> &out) {
+    edge *e = f->e;
+    if (e->next->next->next == e) {
+        triangle t;
+        t.v[0] = e->vert->loc;
+        t.v[1] = e->next->vert->loc;
+        t.v[2] = e->next->next->vert->loc;
+        out.push_back(t);
+        return true;
+    }
+
+    static thread_local vector<Vector3f> loc;
+    static thread_local vector<uint32_t> corners;
+    loc.clear();
+    corners.clear();
+    do {
+        loc.push_back(e->vert->loc);
+        e = e->next;
+    } while (e != f->e);
+
+    bool clean = split_polygon(loc, corners);
+    for (size_t i = 0; i < corners.size(); i += 3) {
+        triangle t;
+        t.v[0] = loc[corners[i]];
+        t.v[1] = loc[corners[i + 1]];
+        t.v[2] = loc[corners[i + 2]];
+        out.push_back(t);
+    }
+    return clean;
+}
+
+void mesh_triangles(const mesh &m, vector<triangle> &out) {
+    for (auto f = m.faces.begin(); f != m.faces.end(); f++) {
+        face_triangles(*f, out);
+    }
+}
+
+// spreads the low 21 bits of v out to every third bit
+uint64_t spread_bits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+uint64_t morton_code(
+        const Vector3f &p, const Vector3f &lo, const Vector3f &hi) {
+    uint64_t code = 0;
+    for (int i = 0; i < 3; i++) {
+        float extent = hi[i] - lo[i];
+        float t = extent > 0 ? (p[i] - lo[i]) / extent : 0;
+        t = std::min(std::max(t, 0.f), 1.f);
+        code |= spread_bits((uint64_t) (t * 0x1fffff)) << i;
+    }
+    return code;
+}
+
+void reorder_triangles(vector<triangle> &tris, const int order) {
+    if (order == MESH_ORDER_Z) {
+        std::stable_sort(tris.begin(), tris.end(),
+                [](const triangle &a, const triangle &b) {
+                    return std::min(a.v[0][2], std::min(a.v[1][2], a.v[2][2]))
+                        < std::min(b.v[0][2], std::min(b.v[1][2], b.v[2][2]));
+                });
+    } else if (order == MESH_ORDER_MORTON && !tris.empty()) {
+        Vector3f lo = tris[0].v[0], hi = tris[0].v[0];
+        for (auto t = tris.begin(); t != tris.end(); t++) {
+            for (int i = 0; i < 3; i++) {
+                lo = lo.cwiseMin(t->v[i]);
+                hi = hi.cwiseMax(t->v[i]);
+            }
+        }
+        vector<pair<uint64_t, uint32_t>> codes;
+        for (uint32_t i = 0; i < tris.size(); i++) {
+            const triangle &t = tris[i];
+            codes.push_back(pair<uint64_t, uint32_t>(morton_code(
+                            (t.v[0] + t.v[1] + t.v[2]) / 3, lo, hi), i));
+        }
+        std::sort(codes.begin(), codes.end());
+        vector<triangle> sorted;
+        sorted.reserve(tris.size());
+        for (auto c = codes.begin(); c != codes.end(); c++) {
+            sorted.push_back(tris[c->second]);
+        }
+        tris.swap(sorted);
+    }
+}
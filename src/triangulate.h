@@ -0,0 +1,47 @@
+#ifndef __TP_TRIANGULATE_H__
+#define __TP_TRIANGULATE_H__
+
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+#include <meshparse/mesh.h>
+
+#include "tooldef.h"
+
+using namespace Eigen;
+using namespace meshparse;
+
+// a triangle of the mesh, with its verteces copied out so contact tests and
+// slicing don't have to chase edge pointers
+class triangle {
+    public:
+        Vector3f v[3];
+};
+
+// splits the polygon with corners loc, in order, into triangles with the same
+// winding, appending the indeces into loc of each triangle's corners to
+// corners. convex polygons are fanned out from their first corner; concave
+// ones are cut up by ear clipping, in the plane the polygon is closest to
+// lying flat in, so no triangle sticks out of it. returns false if it
+// couldn't be split cleanly, because it has fewer than three corners or
+// twists over itself so that it has no ear left to clip.
+bool split_polygon(
+        const std::vector<Vector3f> &loc, std::vector<uint32_t> &corners);
+
+// splits a face into triangles the same way, appending them to out. returns
+// false if the face couldn't be split cleanly.
+bool face_triangles(const face *f, std::vector<triangle> &out);
+
+// splits every face of the mesh into triangles, in the order of the faces.
+void mesh_triangles(const mesh &m, std::vector<triangle> &out);
+
+// the Morton code of p in the box from lo to hi: the bits of where it is along
+// each axis, 21 of them each, interleaved, so points close together mostly
+// get codes close together
+uint64_t morton_code(const Vector3f &p, const Vector3f &lo, const Vector3f &hi);
+
+// sorts triangles into one of the MESH_ORDER_ orders: by their lowest point,
+// or by the Morton code of their centers. MESH_ORDER_FILE leaves them be.
+void reorder_triangles(std::vector<triangle> &tris, const int order);
+
+#endif
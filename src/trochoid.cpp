@@ -0,0 +1,508 @@
+#include "trochoid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "grid.h"
+#include "parallel.h"
+#include "simplify.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// cells of the grid across the tool's radius
+#define CELLS_PER_RADIUS (8)
+// most cells the grid may have along either side
+#define MAX_GRID_CELLS (4096)
+// channels up to this many tool diameters wide are slotted
+#define SLOT_DIAMETERS (2)
+
+// the eight neighbours of a cell, clockwise from the one above it
+static const int ring_di[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int ring_dj[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+// the same neighbours, the four beside the cell before the four diagonal
+static const int sides_first[8] = { 0, 2, 4, 6, 1, 3, 5, 7 };
+
+uint32_t neighbour(const uint32_t k, const uint32_t nx, const int n) {
+    return (uint32_t) ((int64_t) k + (int64_t) ring_dj[n] * nx + ring_di[n]);
+}
+
+// thins the set cells of img, listed in cells, down to lines one cell wide
+// without breaking or shortening them, with Zhang and Suen's two alternating
+// passes. cells on the edge of the grid must not be set. cells is left
+// listing the cells still set.
+void thin(vector<uint8_t> &img, const uint32_t nx, vector<uint32_t> &cells) {
+    vector<uint32_t> removed;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int pass = 0; pass < 2; pass++) {
+            removed.clear();
+            for (auto c = cells.begin(); c != cells.end(); c++) {
+                int p[8], count = 0, rises = 0;
+                for (int n = 0; n < 8; n++) {
+                    p[n] = img[neighbour(*c, nx, n)];
+                    count += p[n];
+                }
+                for (int n = 0; n < 8; n++) {
+                    rises += !p[n] && p[(n + 1) % 8];
+                }
+                if (count < 2 || count > 6 || rises != 1) {
+                    continue;
+                }
+                // the first pass peels cells off the bottom and right of
+                // lines, the second off the top and left
+                bool keep = pass == 0
+                    ? (p[0] && p[2] && p[4]) || (p[2] && p[4] && p[6])
+                    : (p[0] && p[2] && p[6]) || (p[0] && p[4] && p[6]);
+                if (!keep) {
+                    removed.push_back(*c);
+                }
+            }
+            for (auto c = removed.begin(); c != removed.end(); c++) {
+                img[*c] = 0;
+            }
+            if (!removed.empty()) {
+                changed = true;
+                cells.erase(std::remove_if(cells.begin(), cells.end(),
+                            [&](uint32_t c) { return img[c] == 0; }),
+                        cells.end());
+            }
+        }
+    }
+}
+
+// how many separate pieces the set neighbours of a cell fall into, counting
+// cells that touch at a corner as connected (Hilditch's crossing number)
+int crossings(const int p[8]) {
+    int x = 0;
+    for (int n = 0; n < 8; n += 2) {
+        x += !p[n] && (p[n + 1] || p[(n + 2) % 8]);
+    }
+    return x;
+}
+
+// removes the cells zhang and suen leave on the inside of some diagonal
+// steps: ones whose neighbours stay connected without them, and that aren't
+// the end of a line
+void remove_steps(
+        vector<uint8_t> &img, const uint32_t nx, vector<uint32_t> &cells) {
+    for (auto c = cells.begin(); c != cells.end(); c++) {
+        int p[8], count = 0;
+        for (int n = 0; n < 8; n++) {
+            p[n] = img[neighbour(*c, nx, n)];
+            count += p[n];
+        }
+        if (count >= 2 && crossings(p) == 1) {
+            img[*c] = 0;
+        }
+    }
+    cells.erase(std::remove_if(cells.begin(), cells.end(),
+                [&](uint32_t c) { return img[c] == 0; }),
+            cells.end());
+}
+
+// a line of cells traced from a thinned image, and how many of its ends are
+// loose rather than at a junction or joined back onto itself
+struct chain {
+    vector<uint32_t> cells;
+    int loose_ends;
+};
+
+// extends a chain from its last cell along the line, preferring the cells
+// beside each cell over the ones diagonal from it, until it gets to a
+// junction, a loose end, or a cell that's already traced
+void walk_chain(
+        const vector<uint8_t> &img, const uint32_t nx,
+        const vector<uint8_t> &junction, vector<uint8_t> &visited,
+        chain &ch) {
+    while (true) {
+        uint32_t cur = ch.cells.back();
+        size_t size = ch.cells.size();
+        visited[cur] = 1;
+        uint32_t next = NO_CELL, stop = NO_CELL;
+        for (int m = 0; m < 8; m++) {
+            uint32_t nb = neighbour(cur, nx, sides_first[m]);
+            if (!img[nb] || (size > 1 && nb == ch.cells[size - 2])) {
+                continue;
+            }
+            // the junction the chain started from isn't where it ends
+            // unless it's gone round a loop to get back there
+            bool start = nb == ch.cells[0] && junction[nb] && size < 4;
+            if (junction[nb] && !start && stop == NO_CELL) {
+                stop = nb;
+            } else if (!junction[nb] && !visited[nb] && next == NO_CELL) {
+                next = nb;
+            } else if (visited[nb] && !junction[nb] && stop == NO_CELL
+                    && (size >= 4 || nb != ch.cells[0])) {
+                stop = nb;
+            }
+        }
+        if (stop != NO_CELL && (next == NO_CELL || junction[stop])) {
+            ch.cells.push_back(stop);
+            return;
+        }
+        if (next == NO_CELL) {
+            ch.loose_ends++;
+            return;
+        }
+        ch.cells.push_back(next);
+    }
+}
+
+// traces every line of a thinned image into chains running between
+// junctions, where three or more lines meet, and loose ends. lines out of
+// junctions are traced first, then lines with no junctions on them, then
+// closed loops.
+void trace_chains(
+        const vector<uint8_t> &img, const uint32_t nx,
+        const vector<uint32_t> &cells, vector<uint8_t> &junction,
+        vector<chain> &out) {
+    vector<uint8_t> visited(img.size(), 0);
+    vector<uint32_t> ends;
+    junction.assign(img.size(), 0);
+    for (auto c = cells.begin(); c != cells.end(); c++) {
+        int degree = 0;
+        for (int n = 0; n < 8; n++) {
+            degree += img[neighbour(*c, nx, n)];
+        }
+        junction[*c] = degree >= 3;
+        if (degree <= 1) {
+            ends.push_back(*c);
+        }
+    }
+
+    chain ch;
+    for (auto c = cells.begin(); c != cells.end(); c++) {
+        if (!junction[*c]) {
+            continue;
+        }
+        visited[*c] = 1;
+        for (int n = 0; n < 8; n++) {
+            uint32_t nb = neighbour(*c, nx, n);
+            if (img[nb] && !junction[nb] && !visited[nb]) {
+                ch.cells.assign(1, *c);
+                ch.cells.push_back(nb);
+                ch.loose_ends = 0;
+                walk_chain(img, nx, junction, visited, ch);
+                out.push_back(ch);
+            }
+        }
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        const vector<uint32_t> &starts = pass == 0 ? ends : cells;
+        for (auto c = starts.begin(); c != starts.end(); c++) {
+            if (visited[*c]) {
+                continue;
+            }
+            ch.cells.assign(1, *c);
+            ch.loose_ends = pass == 0 ? 1 : 0;
+            walk_chain(img, nx, junction, visited, ch);
+            out.push_back(ch);
+        }
+    }
+}
+
+// joins chains end to end at every group of touching junction cells where
+// only two chains are left, so a line that spurs were pruned off of is cut in
+// one go
+void join_chains(
+        const vector<uint8_t> &junction, const uint32_t nx,
+        vector<chain> &chains) {
+    // every junction cell belongs to the group of the first cell of it found
+    std::unordered_map<uint32_t, uint32_t> group;
+    for (auto ch = chains.begin(); ch != chains.end(); ch++) {
+        uint32_t ends[2] = { ch->cells.front(), ch->cells.back() };
+        for (int e = 0; e < 2; e++) {
+            if (!junction[ends[e]] || group.count(ends[e])) {
+                continue;
+            }
+            vector<uint32_t> stack(1, ends[e]);
+            group[ends[e]] = ends[e];
+            while (!stack.empty()) {
+                uint32_t c = stack.back();
+                stack.pop_back();
+                for (int n = 0; n < 8; n++) {
+                    uint32_t nb = neighbour(c, nx, n);
+                    if (junction[nb] && !group.count(nb)) {
+                        group[nb] = ends[e];
+                        stack.push_back(nb);
+                    }
+                }
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        // the chain ends at every group; the low bit is set for the back
+        std::unordered_map<uint32_t, vector<size_t>> at;
+        for (size_t i = 0; i < chains.size(); i++) {
+            if (chains[i].cells.size() < 2) {
+                continue;
+            }
+            uint32_t front = chains[i].cells.front();
+            uint32_t back = chains[i].cells.back();
+            if (junction[front]) {
+                at[group[front]].push_back(2 * i);
+            }
+            if (junction[back]) {
+                at[group[back]].push_back(2 * i + 1);
+            }
+        }
+        for (auto g = at.begin(); g != at.end() && !changed; g++) {
+            if (g->second.size() != 2 || g->second[0] / 2 == g->second[1] / 2) {
+                continue;
+            }
+            chain &a = chains[g->second[0] / 2], &b = chains[g->second[1] / 2];
+            if (g->second[0] % 2 == 0) {
+                std::reverse(a.cells.begin(), a.cells.end());
+            }
+            if (g->second[1] % 2 == 1) {
+                std::reverse(b.cells.begin(), b.cells.end());
+            }
+            size_t skip = a.cells.back() == b.cells.front() ? 1 : 0;
+            a.cells.insert(
+                    a.cells.end(), b.cells.begin() + skip, b.cells.end());
+            a.loose_ends += b.loose_ends;
+            b.cells.clear();
+            changed = true;
+        }
+    }
+}
+
+// the least distance from the segment from p to q to any edge of the region
+float segment_clearance(
+        const region &reg, const Vector2f &p, const Vector2f &q) {
+    float best = INFINITY;
+    vector<const polygon *> loops(1, &reg.outer);
+    for (auto h = reg.holes.begin(); h != reg.holes.end(); h++) {
+        loops.push_back(&*h);
+    }
+    for (auto l = loops.begin(); l != loops.end(); l++) {
+        const polygon &poly = **l;
+        for (size_t i = 0, k = poly.size() - 1; i < poly.size(); k = i++) {
+            best = min(best, segment_distance2(p, q, poly[k], poly[i]));
+        }
+    }
+    return sqrt(best);
+}
+
+void find_slots(
+        const region &reg, const float r, const float max_width,
+        const float tolerance, vector<slot> &out) {
+    if (reg.outer.empty() || max_width <= 2 * r) {
+        return;
+    }
+    cellgrid g(reg, r / CELLS_PER_RADIUS, MAX_GRID_CELLS);
+    float cell = g.cell;
+    bitgrid inside(g.nx, g.ny), outside(g.nx, g.ny);
+    rasterize_region(reg, g, inside);
+    for (uint32_t j = 0; j < g.ny; j++) {
+        for (uint32_t i = 0; i < g.nx; i++) {
+            if (!inside.get(i, j)) {
+                outside.set(i, j);
+            }
+        }
+    }
+    vector<float> clear2;
+    vector<uint32_t> nearest;
+    distance_transform(outside, clear2, nearest);
+
+    // the cells the tool center may be at, give or take a cell; the room
+    // around the centerlines is measured exactly at the end
+    float fits = (r + tolerance) / cell;
+    // the corners of a channel have room for a circle wider than the channel
+    // (by 17% at right angles), so only what's a quarter wider than max_width
+    // counts as wide
+    float wide = 1.25f * max_width / 2 / cell;
+    bitgrid wide_cells(g.nx, g.ny);
+    bool any_wide = false;
+    for (uint32_t j = 0; j < g.ny; j++) {
+        for (uint32_t i = 0; i < g.nx; i++) {
+            if (clear2[(size_t) j * g.nx + i] > wide * wide) {
+                wide_cells.set(i, j);
+                any_wide = true;
+            }
+        }
+    }
+    // the tool center can get to within (max_width / 2 - r) of the walls of
+    // anything wider while staying in the wide part, and to within that much
+    // of both walls of its corners
+    vector<float> wide2;
+    if (any_wide) {
+        distance_transform(wide_cells, wide2, nearest);
+    }
+    float near_wide = (wide - fits) * (float) M_SQRT2 + 1;
+
+    vector<uint8_t> img((size_t) g.nx * g.ny, 0), junction;
+    vector<uint32_t> cells;
+    for (uint32_t k = 0; k < img.size(); k++) {
+        if (clear2[k] >= fits * fits
+                && (!any_wide || wide2[k] > near_wide * near_wide)) {
+            img[k] = 1;
+            cells.push_back(k);
+        }
+    }
+    thin(img, g.nx, cells);
+    remove_steps(img, g.nx, cells);
+    vector<chain> chains;
+    trace_chains(img, g.nx, cells, junction, chains);
+
+    // a spur off a line that doesn't reach further than the channel is wide
+    // is only a bump in the wall
+    for (auto ch = chains.begin(); ch != chains.end(); ch++) {
+        float length = 0, widest = 0;
+        for (size_t k = 0; k < ch->cells.size(); k++) {
+            widest = max(widest, (float) sqrt(clear2[ch->cells[k]]) * cell);
+            if (k > 0) {
+                length += (g.center(ch->cells[k])
+                        - g.center(ch->cells[k - 1])).norm();
+            }
+        }
+        if (ch->loose_ends == 1 && length < widest) {
+            ch->cells.clear();
+        }
+    }
+    join_chains(junction, g.nx, chains);
+
+    // the centerlines are smoothed to within half a cell, and the room
+    // around them measured exactly against the region's edges. they're split
+    // wherever the tool doesn't fit after all.
+    vector<float> xs, ys;
+    vector<bool> keep;
+    vector<Vector2f> line;
+    for (auto ch = chains.begin(); ch != chains.end(); ch++) {
+        if (ch->cells.empty()) {
+            continue;
+        }
+        xs.clear();
+        ys.clear();
+        for (auto c = ch->cells.begin(); c != ch->cells.end(); c++) {
+            Vector2f p = g.center(*c);
+            xs.push_back(p[0]);
+            ys.push_back(p[1]);
+        }
+        douglas_peucker(xs, ys, cell / 2, keep);
+        line.clear();
+        for (size_t k = 0; k < xs.size(); k++) {
+            if (keep[k]) {
+                line.push_back(Vector2f(xs[k], ys[k]));
+            }
+        }
+
+        bool open = false;
+        for (size_t k = 0; k < line.size(); k++) {
+            size_t next = min(k + 1, line.size() - 1);
+            if (k == next && k > 0) {
+                break;
+            }
+            float room = segment_clearance(reg, line[k], line[next])
+                - r - tolerance;
+            if (room < 0) {
+                open = false;
+                continue;
+            }
+            if (!open) {
+                out.push_back(slot());
+                out.back().centerline.push_back(line[k]);
+                out.back().room.push_back(room);
+                open = true;
+            }
+            slot &s = out.back();
+            s.room.back() = min(s.room.back(), room);
+            if (k != next) {
+                s.centerline.push_back(line[next]);
+                s.room.push_back(room);
+            }
+        }
+    }
+}
+
+void trochoid_moves(
+        const slot &s, const float z, const float stepover,
+        vector<move> &out) {
+    if (s.centerline.empty() || stepover <= 0) {
+        return;
+    }
+    vector<float> along(1, 0);
+    for (size_t k = 1; k < s.centerline.size(); k++) {
+        along.push_back(
+                along.back() + (s.centerline[k] - s.centerline[k - 1]).norm());
+    }
+    float length = along.back();
+    int loops = (int) ceil(length / stepover);
+
+    size_t seg = 0;
+    for (int l = 0; l <= loops; l++) {
+        float at = min(length, l * stepover);
+        while (seg + 2 < s.centerline.size() && along[seg + 1] < at) {
+            seg++;
+        }
+        Vector2f c = s.centerline[seg], t(1, 0);
+        float rho = s.room[seg];
+        if (s.centerline.size() > 1) {
+            const Vector2f &a = s.centerline[seg], &b = s.centerline[seg + 1];
+            float span = along[seg + 1] - along[seg];
+            float f = span > 0 ? (at - along[seg]) / span : 0;
+            c = a + f * (b - a);
+            if (span > 0) {
+                t = (b - a) / span;
+            }
+            rho = min(rho, s.room[seg + 1]);
+        }
+
+        if (rho <= 0) {
+            out.push_back(move(MOVE_LINEAR, Vector3f(c[0], c[1], z)));
+            continue;
+        }
+        // start on the right of the loop's middle, so going round
+        // counterclockwise heads forwards first
+        Vector2f n(-t[1], t[0]);
+        Vector2f right = c - rho * n, left = c + rho * n;
+        out.push_back(move(MOVE_LINEAR, Vector3f(right[0], right[1], z)));
+        Vector3f center(c[0], c[1], z);
+        out.push_back(move(MOVE_ARC_CCW, Vector3f(left[0], left[1], z)));
+        out.back().center = center;
+        out.push_back(move(MOVE_ARC_CCW, Vector3f(right[0], right[1], z)));
+        out.back().center = center;
+    }
+}
+
+path slot_clear(const vector<levelset> &levelsets, const tooldef td) {
+    path p;
+    if (levelsets.empty()) {
+        return p;
+    }
+    vector<vector<vector<move>>> layer_slots(levelsets.size());
+    parallel_for(levelsets.size(), [&](size_t i) {
+        vector<polygon> loops;
+        vector<region> regions;
+        vector<slot> slots;
+        perimeter_polygons(levelsets[i], loops);
+        find_regions(loops, regions);
+        for (auto reg = regions.begin(); reg != regions.end(); reg++) {
+            find_slots(
+                    *reg, td.r, SLOT_DIAMETERS * 2 * td.r, td.tolerance,
+                    slots);
+        }
+        for (auto s = slots.begin(); s != slots.end(); s++) {
+            layer_slots[i].push_back(vector<move>());
+            trochoid_moves(
+                    *s, levelsets[i].z, td.stepover * 2 * td.r,
+                    layer_slots[i].back());
+        }
+    });
+
+    float safe_z = levelsets.back().z + td.z_accuracy;
+    for (auto ls = layer_slots.rbegin(); ls != layer_slots.rend(); ls++) {
+        for (auto moves = ls->begin(); moves != ls->end(); moves++) {
+            append_moves(p, *moves, safe_z);
+        }
+    }
+    return p;
+}
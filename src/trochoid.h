@@ -0,0 +1,56 @@
+#ifndef __TP_TROCHOID_H__
+#define __TP_TROCHOID_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "path.h"
+#include "polygon.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// trochoidal slotting: channels only a little wider than the tool bury it
+// along its whole leading half when cut with straight passes. instead, the
+// tool runs down them in overlapping loops, each one a circle around a point
+// that moves along the middle of the channel by stepover per loop, so it only
+// ever takes a thin crescent off the front.
+
+// a channel of a region narrow enough to slot: the path for the middle of
+// the loops, and for every point of it, the radius the loops can have there
+// without the tool leaving the region
+class slot {
+    public:
+        std::vector<Vector2f> centerline;
+        std::vector<float> room;
+};
+
+// finds the channels of a region that a tool of radius r fits into but that
+// are at most max_width wide. the region is rasterized, the cells the tool
+// center may be at are found with a distance transform, and those within
+// reach of anywhere wider than max_width are dropped. what's left is thinned
+// down to lines one cell wide, which are traced into centerlines and
+// smoothed. short spurs the thinning leaves at bumps in the walls are
+// dropped. the room around the centerlines is measured exactly against the
+// region's edges, and they're split wherever the tool doesn't fit.
+void find_slots(
+        const region &reg, const float r, const float max_width,
+        const float tolerance, std::vector<slot> &out);
+
+// appends the moves cutting a slot at height z: a linear move to the start
+// of the first loop, then every loop as two counterclockwise half circles,
+// keeping the walls on the tool's right, with a linear move from each loop
+// to the next. loops are stepover apart along the centerline; where the
+// slot has no room for loops at all, the tool just follows the centerline.
+void trochoid_moves(
+        const slot &s, const float z, const float stepover,
+        std::vector<move> &out);
+
+// cuts the narrow channels of every layer, up to twice the tool's diameter
+// wide, with trochoidal loops td.stepover of the tool's diameter apart,
+// working from the top layer down. anything wider is left for the clearing
+// operations.
+path slot_clear(const std::vector<levelset> &levelsets, const tooldef td);
+
+#endif
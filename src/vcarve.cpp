@@ -0,0 +1,122 @@
+#include "vcarve.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.h"
+#include "polygon.h"
+#include "simplify.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+// drops the points of a pass that are within tolerance of the rest of it,
+// both seen from above and in the depth along it
+void simplify_pass(const float tolerance, vector<Vector3f> &pass) {
+    vector<float> xs, ys, along, zs;
+    vector<bool> flat, deep;
+    for (size_t k = 0; k < pass.size(); k++) {
+        xs.push_back(pass[k][0]);
+        ys.push_back(pass[k][1]);
+        zs.push_back(pass[k][2]);
+        along.push_back(k == 0 ? 0 : along.back() + Vector2f(
+                    xs[k] - xs[k - 1], ys[k] - ys[k - 1]).norm());
+    }
+    douglas_peucker(xs, ys, tolerance, flat);
+    douglas_peucker(along, zs, tolerance, deep);
+    size_t kept = 0;
+    for (size_t k = 0; k < pass.size(); k++) {
+        if (flat[k] || deep[k]) {
+            pass[kept++] = pass[k];
+        }
+    }
+    pass.resize(kept);
+}
+
+void vcarve_passes(
+        const vector<medial_branch> &branches, const float z,
+        const tooldef td, vector<vector<Vector3f>> &passes) {
+    // the depth at which the V-bit is as wide as the clearance, up to where
+    // the cone meets the shank
+    float slope = tan(td.angle);
+    float deepest = max(0.f, td.r - td.tip_r) / slope;
+    auto depth = [&](const float clearance) {
+        return min(deepest, max(0.f, clearance - td.tip_r) / slope);
+    };
+
+    size_t first = passes.size();
+    for (auto br = branches.begin(); br != branches.end(); br++) {
+        size_t n = br->points.size();
+        if (n == 0) {
+            continue;
+        }
+        // carries on from the last pass if the branch starts or ends there
+        bool reversed = false, joined = false;
+        if (passes.size() > first) {
+            const Vector3f &last = passes.back().back();
+            Vector2f at(last[0], last[1]);
+            joined = br->points.front() == at || br->points.back() == at;
+            reversed = br->points.front() != at;
+        }
+        if (!joined) {
+            passes.push_back(vector<Vector3f>());
+        }
+        vector<Vector3f> &pass = passes.back();
+        for (size_t k = joined ? 1 : 0; k < n; k++) {
+            size_t i = reversed ? n - 1 - k : k;
+            const Vector2f &p = br->points[i];
+            pass.push_back(
+                    Vector3f(p[0], p[1], z - depth(br->clearance[i])));
+        }
+    }
+    // the errors in the plane and in depth add up
+    for (size_t i = first; i < passes.size(); i++) {
+        simplify_pass(td.tolerance / 2, passes[i]);
+    }
+}
+
+path vcarve(
+        const mesh &m, const vector<levelset> &levelsets, const tooldef td,
+        slicestats &stats) {
+    path p;
+    // a layer at the very top of the model is above all of it, so the
+    // artwork is the highest layer with anything in it
+    auto top_at = levelsets.rbegin();
+    while (top_at != levelsets.rend() && top_at->perimeter_count() == 0) {
+        top_at++;
+    }
+    if (top_at == levelsets.rend()) {
+        return p;
+    }
+    vector<polygon> loops;
+    vector<region> regions;
+    perimeter_polygons(*top_at, loops);
+    find_regions(loops, regions);
+
+    // that layer is up to td.z_accuracy below the surface the artwork is
+    // carved into, the top of the mesh
+    float surface = m.get_bounds().max_z;
+
+    vector<vector<vector<Vector3f>>> region_passes(regions.size());
+    vector<size_t> unconformed(regions.size(), 0);
+    parallel_for(regions.size(), [&](size_t i) {
+        vector<medial_branch> branches;
+        unconformed[i] = medial_axis(regions[i], td.tolerance, branches);
+        vcarve_passes(branches, surface, td, region_passes[i]);
+    });
+    for (size_t i = 0; i < regions.size(); i++) {
+        Vector3f at(regions[i].outer[0][0], regions[i].outer[0][1], surface);
+        for (size_t k = 0; k < unconformed[i]; k++) {
+            stats.diag.report(DIAG_MEDIAL_EDGE, at);
+        }
+    }
+
+    float safe_z = surface + td.z_accuracy;
+    for (auto rp = region_passes.begin(); rp != region_passes.end(); rp++) {
+        for (auto pass = rp->begin(); pass != rp->end(); pass++) {
+            append_polyline(p, *pass, safe_z);
+        }
+    }
+    return p;
+}
@@ -0,0 +1,39 @@
+#ifndef __TP_VCARVE_H__
+#define __TP_VCARVE_H__
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "medial.h"
+#include "path.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace Eigen;
+
+// V-carving: a V-bit run down the medial axis of an outline, sunk at every
+// point just deep enough that its cone touches the walls, cuts a groove whose
+// sides meet the outline exactly and whose bottom follows the middle of it.
+// narrow parts of the outline are cut shallow and wide ones deep, and sharp
+// corners come out sharp as the tool rises into them.
+
+// the passes carving down from height z along the branches of a medial axis.
+// where the outline is wider than the V-bit, the tool stays at its full depth
+// along the middle and the rest is left for a clearing operation. passes are
+// simplified to within half of td.tolerance in the plane and in depth, and
+// branches that carry on from where the last one ended are cut in the same
+// pass.
+void vcarve_passes(
+        const std::vector<medial_branch> &branches, const float z,
+        const tooldef td, std::vector<std::vector<Vector3f>> &passes);
+
+// carves the regions of the highest layer that has any into the top of the
+// mesh with a V-bit, treating them as the outlines of the artwork. the medial
+// axis of every region is found in parallel, with the boundary sampled every
+// td.tolerance; edges it leaves out are noted in stats.diag, at the first
+// corner of their region.
+path vcarve(
+        const mesh &m, const std::vector<levelset> &levelsets,
+        const tooldef td, slicestats &stats);
+
+#endif
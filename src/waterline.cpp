@@ -0,0 +1,272 @@
+#include "waterline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include "bvh.h"
+#include "cutter.h"
+#include "parallel.h"
+#include "polygon.h"
+#include "simplify.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+#define NO_CROSSING (UINT32_MAX)
+
+// the square grid of fibers shared by every level. x-fiber j runs along
+// y = y0 + j * step and y-fiber i along x = x0 + i * step.
+struct fibergrid {
+    float x0, y0, step;
+    uint32_t nx, ny;
+
+    float x(const uint32_t i) const { return x0 + i * step; }
+    float y(const uint32_t j) const { return y0 + j * step; }
+};
+
+// pushes the tool along a single fiber at height z and collects the merged,
+// sorted intervals where it would cut into the mesh.
+template <typename S>
+void push_fiber(
+        const bvh &tree, const fibergrid &g, const int axis,
+        const uint32_t index, const float z, const S &shape,
+        vector<span> &out) {
+    float at = axis == 0 ? g.y(index) : g.x(index);
+    Vector3f lo, hi;
+    if (axis == 0) {
+        lo = Vector3f(g.x(0), at - shape.r, z);
+        hi = Vector3f(g.x(g.nx - 1), at + shape.r, INFINITY);
+    } else {
+        lo = Vector3f(at - shape.r, g.y(0), z);
+        hi = Vector3f(at + shape.r, g.y(g.ny - 1), INFINITY);
+    }
+
+    vector<span> hits;
+    tree.query(lo, hi, [&](const triangle &t) {
+        span s;
+        if (push_triangle(shape, t, axis, at, z, s.lo, s.hi)) {
+            hits.push_back(s);
+        }
+    });
+    std::sort(hits.begin(), hits.end(),
+            [](const span &a, const span &b) { return a.lo < b.lo; });
+    for (auto s = hits.begin(); s != hits.end(); s++) {
+        if (!out.empty() && s->lo <= out.back().hi) {
+            out.back().hi = max(out.back().hi, s->hi);
+        } else {
+            out.push_back(*s);
+        }
+    }
+}
+
+// pushes the tool along every fiber of every level, in parallel. fibers are
+// stored level by level, x-fibers first.
+template <typename S>
+void push_fibers(
+        const bvh &tree, const fibergrid &g, const vector<levelset> &levelsets,
+        const S &shape, vector<vector<span>> &fibers) {
+    size_t per_level = g.nx + g.ny;
+    fibers.resize(levelsets.size() * per_level);
+    parallel_for(fibers.size(), [&](size_t f) {
+        size_t level = f / per_level, index = f % per_level;
+        float z = levelsets[level].z;
+        if (index < g.ny) {
+            push_fiber(tree, g, 0, index, z, shape, fibers[f]);
+        } else {
+            push_fiber(tree, g, 1, index - g.ny, z, shape, fibers[f]);
+        }
+    });
+}
+
+// for each grid point along a fiber, whether the tool is blocked there, and
+// for each grid edge along it where that changes, the position of the change.
+// blocked and crossing are indexed by grid point along the fiber, starting at
+// offset and spaced stride apart.
+void fiber_states(
+        const vector<span> &fiber, const float start, const float step,
+        const uint32_t count, const size_t offset, const size_t stride,
+        vector<bool> &blocked, vector<float> &crossing) {
+    size_t s = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        float p = start + i * step;
+        while (s < fiber.size() && fiber[s].hi < p) {
+            s++;
+        }
+        blocked[offset + i * stride] = s < fiber.size() && fiber[s].lo <= p;
+    }
+    for (auto s = fiber.begin(); s != fiber.end(); s++) {
+        float ends[2] = { s->lo, s->hi };
+        for (int e = 0; e < 2; e++) {
+            float cell = floor((ends[e] - start) / step);
+            if (cell < 0 || cell >= count - 1) {
+                continue;
+            }
+            float &c = crossing[offset + (size_t) cell * stride];
+            if (std::isnan(c)) {
+                c = ends[e];
+            }
+        }
+    }
+}
+
+// traces the loops through the crossings of one level, with the blocked side
+// on their left.
+void trace_loops(
+        const fibergrid &g, const vector<span> *x_fibers,
+        const vector<span> *y_fibers, const float tolerance,
+        vector<polygon> &out) {
+    size_t points = (size_t) g.nx * g.ny;
+    vector<bool> blocked(points);
+    // crossings on the edge from each grid point to the next one in x and in y
+    vector<float> x_cross(points, NAN), y_cross(points, NAN);
+    vector<bool> unused(points);
+    for (uint32_t j = 0; j < g.ny; j++) {
+        fiber_states(
+                x_fibers[j], g.x0, g.step, g.nx, (size_t) j * g.nx, 1,
+                blocked, x_cross);
+    }
+    for (uint32_t i = 0; i < g.nx; i++) {
+        fiber_states(
+                y_fibers[i], g.y0, g.step, g.ny, i, g.nx, unused, y_cross);
+    }
+
+    // grid edges are numbered twice the index of their first point, plus one
+    // for edges along y. within each cell, a loop leaves through an edge where
+    // the corners go from blocked to free counterclockwise, and comes in
+    // through the next edge where they go back. saddle cells are taken to be
+    // blocked in the middle, so the tool stays clear of both sides.
+    vector<uint32_t> next(2 * points, NO_CROSSING);
+    for (uint32_t j = 0; j + 1 < g.ny; j++) {
+        for (uint32_t i = 0; i + 1 < g.nx; i++) {
+            size_t p = (size_t) j * g.nx + i;
+            size_t corners[4] = { p, p + 1, p + 1 + g.nx, p + g.nx };
+            uint32_t edges[4] = {
+                (uint32_t) (2 * p), (uint32_t) (2 * (p + 1) + 1),
+                (uint32_t) (2 * (p + g.nx)), (uint32_t) (2 * p + 1) };
+            for (int k = 0; k < 4; k++) {
+                if (!blocked[corners[k]] || blocked[corners[(k + 1) % 4]]) {
+                    continue;
+                }
+                for (int l = 1; l < 4; l++) {
+                    int e = (k + l) % 4;
+                    if (!blocked[corners[e]]
+                            && blocked[corners[(e + 1) % 4]]) {
+                        next[edges[k]] = edges[e];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    auto crossing_point = [&](const uint32_t edge) {
+        size_t p = edge / 2;
+        uint32_t i = p % g.nx, j = p / g.nx;
+        if (edge % 2 == 0) {
+            float c = x_cross[p];
+            return Vector2f(std::isnan(c) ? g.x(i) + g.step / 2 : c, g.y(j));
+        }
+        float c = y_cross[p];
+        return Vector2f(g.x(i), std::isnan(c) ? g.y(j) + g.step / 2 : c);
+    };
+
+    vector<float> xs, ys;
+    vector<bool> keep;
+    for (uint32_t start = 0; start < next.size(); start++) {
+        if (next[start] == NO_CROSSING) {
+            continue;
+        }
+        xs.clear();
+        ys.clear();
+        uint32_t e = start;
+        while (next[e] != NO_CROSSING) {
+            Vector2f p = crossing_point(e);
+            xs.push_back(p[0]);
+            ys.push_back(p[1]);
+            uint32_t n = next[e];
+            next[e] = NO_CROSSING;
+            e = n;
+        }
+        if (e != start || xs.size() < 3) {
+            continue;
+        }
+        xs.push_back(xs[0]);
+        ys.push_back(ys[0]);
+        douglas_peucker(xs, ys, tolerance, keep);
+        polygon loop;
+        for (size_t k = 0; k + 1 < xs.size(); k++) {
+            if (keep[k]) {
+                loop.push_back(Vector2f(xs[k], ys[k]));
+            }
+        }
+        if (loop.size() >= 3) {
+            out.push_back(loop);
+        }
+    }
+}
+
+path waterline(
+        const mesh &m, const vector<levelset> &levelsets, const tooldef td) {
+    path p;
+    if (levelsets.empty()) {
+        return p;
+    }
+    bvh tree(m);
+    bounds b = m.get_bounds();
+
+    // fibers are close enough together that the loop around a sharp convex
+    // corner, an arc of radius r, is traced to within tolerance
+    fibergrid g;
+    g.step = min(td.r, (float) sqrt(8 * td.r * td.tolerance));
+    float margin = td.r + g.step;
+    g.x0 = b.min_x - margin;
+    g.y0 = b.min_y - margin;
+    g.nx = (uint32_t) ceil((b.max_x + margin - g.x0) / g.step) + 1;
+    g.ny = (uint32_t) ceil((b.max_y + margin - g.y0) / g.step) + 1;
+
+    size_t per_level = g.nx + g.ny;
+    vector<vector<span>> fibers;
+    switch (td.shape) {
+        case TOOL_BALL:
+            push_fibers(tree, g, levelsets, ballcutter(td), fibers);
+            break;
+        case TOOL_BULL:
+            push_fibers(tree, g, levelsets, bullcutter(td), fibers);
+            break;
+        case TOOL_VBIT:
+            push_fibers(tree, g, levelsets, vcutter(td), fibers);
+            break;
+        case TOOL_TAPERED_BALL:
+            push_fibers(tree, g, levelsets, taperedcutter(td), fibers);
+            break;
+        default:
+            push_fibers(tree, g, levelsets, flatcutter(td), fibers);
+            break;
+    }
+
+    vector<vector<polygon>> level_loops(levelsets.size());
+    parallel_for(levelsets.size(), [&](size_t level) {
+        const vector<span> *x_fibers = &fibers[level * per_level];
+        trace_loops(
+                g, x_fibers, x_fibers + g.ny, td.tolerance,
+                level_loops[level]);
+    });
+
+    float safe_z = levelsets.back().z + td.z_accuracy;
+    vector<Vector3f> pass;
+    for (size_t level = levelsets.size(); level-- > 0;) {
+        float z = levelsets[level].z;
+        auto &loops = level_loops[level];
+        for (auto loop = loops.begin(); loop != loops.end(); loop++) {
+            pass.clear();
+            for (size_t k = 0; k <= loop->size(); k++) {
+                const Vector2f &pt = (*loop)[k % loop->size()];
+                pass.push_back(Vector3f(pt[0], pt[1], z));
+            }
+            append_polyline(p, pass, safe_z);
+        }
+    }
+    return p;
+}
@@ -0,0 +1,30 @@
+#ifndef __TP_WATERLINE_H__
+#define __TP_WATERLINE_H__
+
+#include <vector>
+#include <meshparse/mesh.h>
+
+#include "path.h"
+#include "slice.h"
+#include "tooldef.h"
+
+using namespace meshparse;
+
+// runs the tool around the mesh at the height of every layer, from the top
+// layer down, along the loops where the tool's tip touches the mesh without
+// cutting into it anywhere. unlike the layer perimeters, these account for
+// the parts of the mesh above and below the layer, so the tool neither gouges
+// overhangs nor cuts into slopes.
+//
+// the loops are found by pushing the tool along fibers parallel to the x- and
+// y-axes on a square grid, with a bvh over the mesh to find the triangles
+// each fiber can hit. the ends of the intervals where the tool would cut into
+// the mesh are exact contact points on the grid lines, and the loops are
+// traced through them cell by cell, as in marching squares, then simplified
+// to within td.tolerance. every fiber of every layer is computed in parallel,
+// and then the loops of every layer.
+path waterline(
+        const mesh &m, const std::vector<levelset> &levelsets,
+        const tooldef td);
+
+#endif